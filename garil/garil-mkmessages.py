@@ -0,0 +1,422 @@
+#!/usr/bin/env python3
+# GARIL - Android RIL client library
+# Copyright (C) 2016 You-Sheng Yang
+#
+# This library is free software; you can redistribute it and/or
+# modify it under the terms of the GNU Lesser General Public
+# License as published by the Free Software Foundation; either
+# version 2 of the License, or (at your option) any later version.
+#
+# This library is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+# Lesser General Public License for more details.
+#
+# You should have received a copy of the GNU Lesser General Public
+# License along with this library. If not, see <http://www.gnu.org/licenses/>.
+
+"""Compile a RIL message schema into parcel encoders and decoders.
+
+Usage: garil-mkmessages.py --output FILE.h|FILE.c SCHEMA
+
+See garilmessages.schema for the schema syntax. Consecutive int32 fields are
+grouped into blocks that are bounds checked and read or written at once with
+garil_parcel_read_int32_struct() and garil_parcel_write_int32_struct(). Their
+struct layout is asserted at compile time so that each block can be copied,
+or byte-swapped on big-endian hosts, straight into the struct members.
+"""
+
+import argparse
+import os
+import re
+import sys
+
+LICENSE = """\
+/* GARIL - Android RIL client library
+ * Copyright (C) 2016 You-Sheng Yang
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* Generated by garil-mkmessages.py from {schema}. Do not edit. */
+"""
+
+C_TYPES = {
+    'int32': 'gint32 ',
+    'string16': 'gchar *',
+}
+
+
+class Field:
+    def __init__(self, type_, name, doc):
+        self.type = type_
+        self.name = name
+        self.doc = doc
+
+
+class Message:
+    def __init__(self, name, doc):
+        self.name = name
+        self.doc = doc
+        self.fields = []
+
+    @property
+    def type_name(self):
+        return 'Garil' + self.name
+
+    @property
+    def func_prefix(self):
+        return 'garil_' + re.sub(r'(?<!^)(?=[A-Z])', '_', self.name).lower()
+
+    @property
+    def has_strings(self):
+        return any(f.type == 'string16' for f in self.fields)
+
+    @property
+    def is_fixed(self):
+        """Whether the message is made of int32 fields only."""
+        return all(f.type == 'int32' for f in self.fields)
+
+    def blocks(self):
+        """Yield lists of consecutive int32 fields and single other fields."""
+        block = []
+        for field in self.fields:
+            if field.type == 'int32':
+                block.append(field)
+                continue
+            if block:
+                yield block
+                block = []
+            yield [field]
+        if block:
+            yield block
+
+
+def error(path, lineno, msg):
+    sys.exit('%s:%d: error: %s' % (path, lineno, msg))
+
+
+def parse(path):
+    messages = []
+    message = None
+    doc = []
+
+    with open(path, encoding='utf-8') as f:
+        for lineno, line in enumerate(f, 1):
+            line = line.strip()
+            if line.startswith('##'):
+                doc.append(line[2:].strip())
+                continue
+            if not line or line.startswith('#'):
+                doc = []
+                continue
+
+            if message is None:
+                m = re.fullmatch(r'message\s+([A-Z][A-Za-z0-9]*)\s*\{', line)
+                if m is None:
+                    error(path, lineno, 'expected message declaration')
+                if any(msg.name == m.group(1) for msg in messages):
+                    error(path, lineno, 'duplicate message %s' % m.group(1))
+                message = Message(m.group(1), ' '.join(doc))
+            elif line == '}':
+                if not message.fields:
+                    error(path, lineno, 'empty message %s' % message.name)
+                messages.append(message)
+                message = None
+            else:
+                m = re.fullmatch(r'(\w+)\s+([a-z][a-z0-9_]*)\s*;', line)
+                if m is None:
+                    error(path, lineno, 'expected field declaration')
+                if m.group(1) not in C_TYPES:
+                    error(path, lineno, 'unknown type %s' % m.group(1))
+                if any(f.name == m.group(2) for f in message.fields):
+                    error(path, lineno, 'duplicate field %s' % m.group(2))
+                message.fields.append(Field(m.group(1), m.group(2),
+                                            ' '.join(doc)))
+            doc = []
+
+    if message is not None:
+        error(path, lineno, 'unterminated message %s' % message.name)
+
+    return messages
+
+
+def wrap_doc(text, first, indent=None, width=80):
+    """Wrap @text into comment lines, the first one starting with @first."""
+    if indent is None:
+        indent = ' *   ' if first.startswith(' * @') else ' * '
+    lines = []
+    line = first
+    for word in text.split():
+        candidate = line + word if line in (first, indent) else \
+            line + ' ' + word
+        if len(candidate) > width and line not in (first, indent):
+            lines.append(line)
+            line = indent + word
+        else:
+            line = candidate
+    lines.append(line)
+    return '\n'.join(lines)
+
+
+def prototype(ret, name, params, end=';'):
+    """Format a declaration with parameters aligned GNU style."""
+    head = '%s%s (' % (ret, name)
+    width = max(len(t) for t, _ in params)
+    stars = max(len(n) - len(n.lstrip('*')) for _, n in params)
+    out = []
+    for i, (type_, pname) in enumerate(params):
+        nstars = len(pname) - len(pname.lstrip('*'))
+        arg = type_.ljust(width) + ' ' + ' ' * (stars - nstars) + pname
+        out.append((head if i == 0 else ' ' * len(head)) + arg)
+    return ',\n'.join(out) + ')' + end
+
+
+def read_params(msg):
+    return [('GarilParcel', '*parcel'), (msg.type_name, '*msg')]
+
+
+def write_params(msg):
+    return [('GarilParcel', '*parcel'), ('const ' + msg.type_name, '*msg')]
+
+
+def generate_header(messages, schema):
+    out = [LICENSE.format(schema=schema), """\
+#pragma once
+
+#if !defined (__GARIL_GARIL_H_INSIDE__) && !defined (LIBGARIL_COMPILATION)
+#error "Only <garil/garil.h> can be included directly."
+#endif
+
+#include <glib.h>
+
+#include <garil/garilparcel.h>
+
+G_BEGIN_DECLS
+"""]
+
+    for msg in messages:
+        out.append('typedef struct _%s %s;' % (msg.type_name, msg.type_name))
+        out.append('')
+        out.append('struct _%s\n{' % msg.type_name)
+        for field in msg.fields:
+            out.append('  %s%s;' % (C_TYPES[field.type], field.name))
+        out.append('};')
+        out.append('')
+        out.append(prototype('gboolean ', msg.func_prefix + '_read',
+                             read_params(msg)))
+        out.append(prototype('void ', msg.func_prefix + '_write',
+                             write_params(msg)))
+        if msg.has_strings:
+            out.append('void %s_clear (%s *msg);' % (msg.func_prefix,
+                                                    msg.type_name))
+        out.append('')
+
+    out.append('G_END_DECLS')
+    return '\n'.join(out) + '\n'
+
+
+def generate_reader_body(out, msg):
+    out.append('  if (garil_parcel_is_malformed (parcel))')
+    out.append('    return FALSE;')
+    out.append('')
+    if msg.has_strings:
+        out.append('  memset (msg, 0, sizeof (*msg));')
+        out.append('')
+    for block in msg.blocks():
+        if block[0].type == 'int32':
+            out.append('  if (!garil_parcel_read_int32_struct (parcel, '
+                       '&msg->%s, %d))' % (block[0].name, len(block)))
+            out.append('    goto fail;')
+        else:
+            field = block[0]
+            out.append('  msg->%s = garil_parcel_read_string16 (parcel);'
+                       % field.name)
+            out.append('  if (garil_parcel_is_malformed (parcel))')
+            out.append('    goto fail;')
+        out.append('')
+    out.append('  return TRUE;')
+    out.append('')
+    out.append('fail:')
+    if msg.has_strings:
+        out.append('  %s_clear (msg);' % msg.func_prefix)
+    out.append('  return FALSE;')
+    out.append('}')
+    out.append('')
+
+
+def generate_source(messages, schema):
+    out = [LICENSE.format(schema=schema), """\
+#if defined (HAVE_CONFIG_H)
+#include "config.h"
+#endif
+
+#include <string.h>
+
+#include "garil/garilmessages.h"
+
+/**
+ * SECTION:garilmessages
+ * @title: Messages
+ * @short_description: Encoders and decoders of RIL message layouts.
+ *
+ * Structures and functions in this section are generated from
+ * garilmessages.schema. Each message can be read out of or written into a
+ * #GarilParcel in one call, with one bounds check for every run of
+ * consecutive #gint32 fields rather than one per field.
+ */
+"""]
+
+    for msg in messages:
+        # Structure documentation.
+        out.append('/**')
+        out.append(' * %s:' % msg.type_name)
+        for field in msg.fields:
+            out.append(wrap_doc(field.doc or 'A field.',
+                                ' * @%s: ' % field.name))
+        out.append(' *')
+        out.append(wrap_doc(msg.doc or 'A RIL message.', ' * '))
+        out.append(' */')
+        out.append('')
+
+        # Each int32 block must be contiguous in the struct to be copied at
+        # once.
+        for block in msg.blocks():
+            if block[0].type != 'int32' or len(block) == 1:
+                continue
+            out.append('G_STATIC_ASSERT (G_STRUCT_OFFSET (%s, %s) =='
+                       % (msg.type_name, block[-1].name))
+            out.append('                 G_STRUCT_OFFSET (%s, %s) +'
+                       % (msg.type_name, block[0].name))
+            out.append('                 %d * sizeof (gint32));'
+                       % (len(block) - 1))
+        if msg.is_fixed:
+            out.append('G_STATIC_ASSERT (sizeof (%s) == %d * sizeof (gint32));'
+                       % (msg.type_name, len(msg.fields)))
+        out.append('')
+
+        # Reader.
+        out.append('/**')
+        out.append(' * %s_read:' % msg.func_prefix)
+        out.append(' * @parcel: (not nullable): A #GarilParcel.')
+        out.append(' * @msg: (out caller-allocates) (not nullable): A #%s.'
+                   % msg.type_name)
+        out.append(' *')
+        out.append(wrap_doc('Read a #%s out of the parcel. Do nothing if the '
+                            'parcel has been marked malformed.'
+                            % msg.type_name, ' * '))
+        if msg.has_strings:
+            out.append(' *')
+            out.append(wrap_doc('On success, strings in @msg should be freed '
+                                'with %s_clear().' % msg.func_prefix, ' * '))
+        out.append(' *')
+        out.append(' * Returns: %TRUE if @msg was filled in; %FALSE otherwise.')
+        out.append(' */')
+        out.append('gboolean')
+        out.append(prototype('', msg.func_prefix + '_read', read_params(msg),
+                             end=''))
+        out.append('{')
+        out.append('  g_return_val_if_fail ((parcel != NULL) && '
+                   '(msg != NULL), FALSE);')
+        out.append('')
+        if msg.is_fixed:
+            # The whole message is one block: a single bounds check and copy.
+            out.append('  return garil_parcel_read_int32_struct (parcel, msg, '
+                       '%d);' % len(msg.fields))
+            out.append('}')
+            out.append('')
+        else:
+            generate_reader_body(out, msg)
+
+        # Writer.
+        out.append('/**')
+        out.append(' * %s_write:' % msg.func_prefix)
+        out.append(' * @parcel: (not nullable): A #GarilParcel.')
+        out.append(' * @msg: (not nullable): A #%s.' % msg.type_name)
+        out.append(' *')
+        out.append(wrap_doc('Write a #%s into the parcel. Do nothing if the '
+                            'parcel has been marked malformed.'
+                            % msg.type_name, ' * '))
+        out.append(' */')
+        out.append('void')
+        out.append(prototype('', msg.func_prefix + '_write',
+                             write_params(msg), end=''))
+        out.append('{')
+        out.append('  g_return_if_fail ((parcel != NULL) && (msg != NULL));')
+        out.append('')
+        if msg.is_fixed:
+            out.append('  garil_parcel_write_int32_struct (parcel, msg, %d);'
+                       % len(msg.fields))
+        else:
+            out.append('  if (garil_parcel_is_malformed (parcel))')
+            out.append('    return;')
+            out.append('')
+            for block in msg.blocks():
+                if block[0].type == 'int32':
+                    out.append('  garil_parcel_write_int32_struct (parcel, '
+                               '&msg->%s, %d);' % (block[0].name, len(block)))
+                else:
+                    out.append('  garil_parcel_write_string16 (parcel, '
+                               'msg->%s);' % block[0].name)
+        out.append('}')
+        out.append('')
+
+        # Clear.
+        if msg.has_strings:
+            out.append('/**')
+            out.append(' * %s_clear:' % msg.func_prefix)
+            out.append(' * @msg: (not nullable): A #%s.' % msg.type_name)
+            out.append(' *')
+            out.append(' * Free the strings in @msg and reset them to %NULL.')
+            out.append(' */')
+            out.append('void')
+            out.append('%s_clear (%s *msg)' % (msg.func_prefix,
+                                              msg.type_name))
+            out.append('{')
+            out.append('  g_return_if_fail (msg != NULL);')
+            out.append('')
+            for field in msg.fields:
+                if field.type == 'string16':
+                    out.append('  g_free (msg->%s);' % field.name)
+                    out.append('  msg->%s = NULL;' % field.name)
+            out.append('}')
+            out.append('')
+
+    return '\n'.join(out)
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        description='Compile a RIL message schema into C code.')
+    parser.add_argument('--output', required=True,
+                        help='output file, either a .h or a .c file')
+    parser.add_argument('schema', help='schema file')
+    args = parser.parse_args()
+
+    messages = parse(args.schema)
+    schema = os.path.basename(args.schema)
+
+    if args.output.endswith('.h'):
+        content = generate_header(messages, schema)
+    elif args.output.endswith('.c'):
+        content = generate_source(messages, schema)
+    else:
+        sys.exit('error: unknown output type for %s' % args.output)
+
+    with open(args.output, 'w', encoding='utf-8') as f:
+        f.write(content)
+
+
+if __name__ == '__main__':
+    main()
@@ -22,7 +22,9 @@
 #include <garil/garilclient.h>
 #include <garil/garilconnection.h>
 #include <garil/garilenumtypes.h>
+#include <garil/garilmessages.h>
 #include <garil/garilparcel.h>
+#include <garil/garilparcelpool.h>
 #include <garil/garilversion.h>
 
 #undef __GARIL_GARIL_H_INSIDE__
@@ -0,0 +1,50 @@
+/* GARIL - Android RIL client library
+ * Copyright (C) 2016 You-Sheng Yang
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+gsize _garil_utf16_narrow_ascii (const gunichar2 *src,
+                                 gsize            len,
+                                 gchar           *dst);
+
+gssize _garil_utf16_to_utf8_len (const gunichar2 *src,
+                                 gsize            len);
+gsize _garil_utf16_to_utf8_encode (const gunichar2 *src,
+                                   gsize            len,
+                                   gchar           *dst);
+gchar *_garil_utf16_to_utf8 (const gunichar2 *src,
+                             gsize            len);
+
+gsize _garil_utf8_widen_ascii (const gchar *src,
+                               gsize        len,
+                               gunichar2   *dst);
+
+gssize _garil_utf8_to_utf16_len (const gchar *src,
+                                 gsize        len);
+gsize _garil_utf8_to_utf16_encode (const gchar *src,
+                                   gsize        len,
+                                   gunichar2   *dst);
+
+void _garil_int32_swap_copy (gint32       *dst,
+                             const gint32 *src,
+                             gsize         len);
+
+G_END_DECLS
@@ -0,0 +1,544 @@
+/* GARIL - Android RIL client library
+ * Copyright (C) 2016 You-Sheng Yang
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#if defined (HAVE_CONFIG_H)
+#include "config.h"
+#endif
+
+#include <string.h>
+
+#include <glib.h>
+
+#if defined (__GNUC__) && (defined (__x86_64__) || defined (__i386__))
+#define HAVE_X86_SIMD 1
+#include <immintrin.h>
+#elif defined (__GNUC__) && defined (__aarch64__)
+#define HAVE_NEON 1
+#include <arm_neon.h>
+#elif defined (__GNUC__) && defined (__VSX__) && \
+      (G_BYTE_ORDER == G_BIG_ENDIAN)
+#define HAVE_VSX 1
+#include <altivec.h>
+#endif
+
+#include "garil/garilcodec-private.h"
+
+/* Transcoding helpers for the string functions of GarilParcel.
+ *
+ * Strings in RIL parcels are mostly ASCII, so the hot paths narrow runs of
+ * non-NUL ASCII UTF-16 code units, or widen runs of ASCII bytes, in bulk. The
+ * bulk implementations are picked once at runtime from the best ones the CPU
+ * supports. Everything else follows the validation rules of g_utf16_to_utf8()
+ * and g_utf8_to_utf16() respectively. Input may be unaligned.
+ *
+ * Parcel integers are little-endian, so big-endian hosts also need a bulk
+ * byte swap, done 128 bits at a time with NEON or VSX where available and 64
+ * bits at a time otherwise. */
+
+#define IS_HIGH_SURROGATE(c) (((c) >= 0xd800) && ((c) < 0xdc00))
+#define IS_LOW_SURROGATE(c) (((c) >= 0xdc00) && ((c) < 0xe000))
+
+typedef gsize (*NarrowFunc) (const gunichar2 *src,
+                             gsize            len,
+                             gchar           *dst);
+typedef gsize (*WidenFunc) (const gchar *src,
+                            gsize        len,
+                            gunichar2   *dst);
+
+typedef struct {
+  NarrowFunc narrow;
+  WidenFunc widen;
+} Impl;
+
+/* TRUE if the four code units in @word are all non-NUL ASCII. */
+static inline gboolean
+is_ascii_word (guint64 word)
+{
+  return ((word & G_GUINT64_CONSTANT (0xff80ff80ff80ff80)) == 0) &&
+         (((word - G_GUINT64_CONSTANT (0x0001000100010001)) & ~word &
+           G_GUINT64_CONSTANT (0x8000800080008000)) == 0);
+}
+
+static gsize
+narrow_generic (const gunichar2 *src,
+                gsize            len,
+                gchar           *dst)
+{
+  gsize i = 0;
+
+  for (; (i + 4) <= len; i += 4) {
+    guint64 word;
+    memcpy (&word, src + i, sizeof (word));
+    if (!is_ascii_word (word))
+      break;
+
+    dst[i] = src[i];
+    dst[i + 1] = src[i + 1];
+    dst[i + 2] = src[i + 2];
+    dst[i + 3] = src[i + 3];
+  }
+
+  for (; i < len; i++) {
+    const gunichar2 c = src[i];
+    if (!c || (c >= 0x80))
+      break;
+    dst[i] = c;
+  }
+
+  return i;
+}
+
+static gsize
+widen_generic (const gchar *src,
+               gsize        len,
+               gunichar2   *dst)
+{
+  gsize i = 0;
+
+  for (; (i + 8) <= len; i += 8) {
+    guint64 word;
+    memcpy (&word, src + i, sizeof (word));
+    if (word & G_GUINT64_CONSTANT (0x8080808080808080))
+      break;
+
+    for (guint j = 0; j < 8; j++)
+      dst[i + j] = src[i + j];
+  }
+
+  for (; (i < len) && !(src[i] & 0x80); i++)
+    dst[i] = src[i];
+
+  return i;
+}
+
+static const Impl impl_generic = { narrow_generic, widen_generic };
+
+#if defined (HAVE_X86_SIMD)
+
+__attribute__ ((target ("sse2")))
+static gsize
+narrow_sse2 (const gunichar2 *src,
+             gsize            len,
+             gchar           *dst)
+{
+  const __m128i non_ascii = _mm_set1_epi16 ((gint16) 0xff80);
+  const __m128i zero = _mm_setzero_si128 ();
+  gsize i = 0;
+
+  for (; (i + 16) <= len; i += 16) {
+    const __m128i a = _mm_loadu_si128 ((const __m128i *) (src + i));
+    const __m128i b = _mm_loadu_si128 ((const __m128i *) (src + i + 8));
+
+    const __m128i high = _mm_and_si128 (_mm_or_si128 (a, b), non_ascii);
+    if (_mm_movemask_epi8 (_mm_cmpeq_epi8 (high, zero)) != 0xffff)
+      break;
+
+    /* Exact for ASCII values, so NUL survives packing. */
+    const __m128i packed = _mm_packus_epi16 (a, b);
+    if (_mm_movemask_epi8 (_mm_cmpeq_epi8 (packed, zero)) != 0)
+      break;
+
+    _mm_storeu_si128 ((__m128i *) (dst + i), packed);
+  }
+
+  return i + narrow_generic (src + i, len - i, dst + i);
+}
+
+__attribute__ ((target ("avx2")))
+static gsize
+narrow_avx2 (const gunichar2 *src,
+             gsize            len,
+             gchar           *dst)
+{
+  const __m256i non_ascii = _mm256_set1_epi16 ((gint16) 0xff80);
+  const __m256i zero = _mm256_setzero_si256 ();
+  gsize i = 0;
+
+  for (; (i + 32) <= len; i += 32) {
+    const __m256i a = _mm256_loadu_si256 ((const __m256i *) (src + i));
+    const __m256i b = _mm256_loadu_si256 ((const __m256i *) (src + i + 16));
+
+    if (!_mm256_testz_si256 (_mm256_or_si256 (a, b), non_ascii))
+      break;
+
+    /* Packing works per 128-bit lane, so restore the order afterwards. */
+    const __m256i packed =
+      _mm256_permute4x64_epi64 (_mm256_packus_epi16 (a, b),
+                                _MM_SHUFFLE (3, 1, 2, 0));
+    if (_mm256_movemask_epi8 (_mm256_cmpeq_epi8 (packed, zero)) != 0)
+      break;
+
+    _mm256_storeu_si256 ((__m256i *) (dst + i), packed);
+  }
+
+  return i + narrow_sse2 (src + i, len - i, dst + i);
+}
+
+__attribute__ ((target ("sse2")))
+static gsize
+widen_sse2 (const gchar *src,
+            gsize        len,
+            gunichar2   *dst)
+{
+  const __m128i zero = _mm_setzero_si128 ();
+  gsize i = 0;
+
+  for (; (i + 16) <= len; i += 16) {
+    const __m128i v = _mm_loadu_si128 ((const __m128i *) (src + i));
+    if (_mm_movemask_epi8 (v) != 0)
+      break;
+
+    _mm_storeu_si128 ((__m128i *) (dst + i), _mm_unpacklo_epi8 (v, zero));
+    _mm_storeu_si128 ((__m128i *) (dst + i + 8), _mm_unpackhi_epi8 (v, zero));
+  }
+
+  return i + widen_generic (src + i, len - i, dst + i);
+}
+
+__attribute__ ((target ("avx2")))
+static gsize
+widen_avx2 (const gchar *src,
+            gsize        len,
+            gunichar2   *dst)
+{
+  gsize i = 0;
+
+  for (; (i + 32) <= len; i += 32) {
+    const __m256i v = _mm256_loadu_si256 ((const __m256i *) (src + i));
+    if (_mm256_movemask_epi8 (v) != 0)
+      break;
+
+    _mm256_storeu_si256 ((__m256i *) (dst + i),
+                         _mm256_cvtepu8_epi16 (_mm256_castsi256_si128 (v)));
+    _mm256_storeu_si256 ((__m256i *) (dst + i + 16),
+                         _mm256_cvtepu8_epi16 (_mm256_extracti128_si256 (v, 1)));
+  }
+
+  return i + widen_sse2 (src + i, len - i, dst + i);
+}
+
+static const Impl impl_sse2 = { narrow_sse2, widen_sse2 };
+static const Impl impl_avx2 = { narrow_avx2, widen_avx2 };
+
+#elif defined (HAVE_NEON)
+
+static gsize
+narrow_neon (const gunichar2 *src,
+             gsize            len,
+             gchar           *dst)
+{
+  gsize i = 0;
+
+  for (; (i + 16) <= len; i += 16) {
+    const uint16x8_t a = vld1q_u16 ((const uint16_t *) (src + i));
+    const uint16x8_t b = vld1q_u16 ((const uint16_t *) (src + i + 8));
+
+    if ((vmaxvq_u16 (vorrq_u16 (a, b)) >= 0x80) ||
+        (vminvq_u16 (vminq_u16 (a, b)) == 0))
+      break;
+
+    vst1q_u8 ((uint8_t *) (dst + i),
+              vcombine_u8 (vmovn_u16 (a), vmovn_u16 (b)));
+  }
+
+  return i + narrow_generic (src + i, len - i, dst + i);
+}
+
+static gsize
+widen_neon (const gchar *src,
+            gsize        len,
+            gunichar2   *dst)
+{
+  gsize i = 0;
+
+  for (; (i + 16) <= len; i += 16) {
+    const uint8x16_t v = vld1q_u8 ((const uint8_t *) (src + i));
+    if (vmaxvq_u8 (v) >= 0x80)
+      break;
+
+    vst1q_u16 ((uint16_t *) (dst + i), vmovl_u8 (vget_low_u8 (v)));
+    vst1q_u16 ((uint16_t *) (dst + i + 8), vmovl_u8 (vget_high_u8 (v)));
+  }
+
+  return i + widen_generic (src + i, len - i, dst + i);
+}
+
+static const Impl impl_neon = { narrow_neon, widen_neon };
+
+#endif
+
+static const Impl*
+get_impl (void)
+{
+  static gsize impl = 0;
+
+  if (g_once_init_enter (&impl)) {
+    const Impl *selected = &impl_generic;
+
+#if defined (HAVE_X86_SIMD)
+    __builtin_cpu_init ();
+    if (__builtin_cpu_supports ("avx2"))
+      selected = &impl_avx2;
+    else if (__builtin_cpu_supports ("sse2"))
+      selected = &impl_sse2;
+#elif defined (HAVE_NEON)
+    selected = &impl_neon;
+#endif
+
+    g_once_init_leave (&impl, (gsize) selected);
+  }
+
+  return (const Impl *) impl;
+}
+
+/* Narrow the leading non-NUL ASCII code units of @src into @dst, which must
+ * have room for @len bytes. Returns the number of code units narrowed. */
+gsize
+_garil_utf16_narrow_ascii (const gunichar2 *src,
+                           gsize            len,
+                           gchar           *dst)
+{
+  return get_impl ()->narrow (src, len, dst);
+}
+
+/* Widen the leading ASCII bytes of @src into @dst, which must have room for
+ * @len code units. Returns the number of bytes widened. */
+gsize
+_garil_utf8_widen_ascii (const gchar *src,
+                         gsize        len,
+                         gunichar2   *dst)
+{
+  return get_impl ()->widen (src, len, dst);
+}
+
+/* Length in bytes of the UTF-8 encoding of @src, up to @len code units or the
+ * first NUL, or -1 if it is not valid UTF-16. */
+gssize
+_garil_utf16_to_utf8_len (const gunichar2 *src,
+                          gsize            len)
+{
+  gsize n = 0;
+  gsize i = 0;
+
+  while (i < len) {
+    if ((i + 4) <= len) {
+      guint64 word;
+      memcpy (&word, src + i, sizeof (word));
+      if (is_ascii_word (word)) {
+        i += 4;
+        n += 4;
+        continue;
+      }
+    }
+
+    const gunichar2 c = src[i++];
+    if (!c)
+      break;
+
+    if (c < 0x80)
+      n += 1;
+    else if (c < 0x800)
+      n += 2;
+    else if (IS_HIGH_SURROGATE (c)) {
+      if ((i == len) || !IS_LOW_SURROGATE (src[i]))
+        return -1;
+      i++;
+      n += 4;
+    } else if (IS_LOW_SURROGATE (c))
+      return -1;
+    else
+      n += 3;
+  }
+
+  return n;
+}
+
+/* Encode @src, which must have been validated with _garil_utf16_to_utf8_len(),
+ * into @dst. No NUL terminator is written. Returns the number of bytes
+ * written. */
+gsize
+_garil_utf16_to_utf8_encode (const gunichar2 *src,
+                             gsize            len,
+                             gchar           *dst)
+{
+  gchar *p = dst;
+  gsize i = 0;
+
+  while (i < len) {
+    gunichar c = src[i];
+    if (!c)
+      break;
+
+    if (c < 0x80) {
+      const gsize n = _garil_utf16_narrow_ascii (src + i, len - i, p);
+      i += n;
+      p += n;
+      continue;
+    }
+
+    i++;
+    if (c < 0x800) {
+      *p++ = 0xc0 | (c >> 6);
+      *p++ = 0x80 | (c & 0x3f);
+    } else if (IS_HIGH_SURROGATE (c)) {
+      c = 0x10000 + ((c - 0xd800) << 10) + (src[i++] - 0xdc00);
+      *p++ = 0xf0 | (c >> 18);
+      *p++ = 0x80 | ((c >> 12) & 0x3f);
+      *p++ = 0x80 | ((c >> 6) & 0x3f);
+      *p++ = 0x80 | (c & 0x3f);
+    } else {
+      *p++ = 0xe0 | (c >> 12);
+      *p++ = 0x80 | ((c >> 6) & 0x3f);
+      *p++ = 0x80 | (c & 0x3f);
+    }
+  }
+
+  return p - dst;
+}
+
+/* Drop-in replacement for g_utf16_to_utf8 (src, len, NULL, NULL, NULL). ASCII
+ * strings are converted in a single pass with a single allocation. */
+gchar*
+_garil_utf16_to_utf8 (const gunichar2 *src,
+                      gsize            len)
+{
+  gchar *dst = g_malloc (len + 1);
+
+  gsize n = _garil_utf16_narrow_ascii (src, len, dst);
+  if ((n < len) && src[n]) {
+    const gssize rest = _garil_utf16_to_utf8_len (src + n, len - n);
+    if (rest < 0) {
+      g_free (dst);
+      return NULL;
+    }
+
+    dst = g_realloc (dst, n + rest + 1);
+    n += _garil_utf16_to_utf8_encode (src + n, len - n, dst + n);
+  }
+
+  dst[n] = '\0';
+  return dst;
+}
+
+/* Number of UTF-16 code units needed for the @len bytes of @src, which must
+ * not contain NUL, or -1 if it is not valid UTF-8. */
+gssize
+_garil_utf8_to_utf16_len (const gchar *src,
+                          gsize        len)
+{
+  gsize n = 0;
+  gsize i = 0;
+
+  while (i < len) {
+    if ((i + 8) <= len) {
+      guint64 word;
+      memcpy (&word, src + i, sizeof (word));
+      if (!(word & G_GUINT64_CONSTANT (0x8080808080808080))) {
+        i += 8;
+        n += 8;
+        continue;
+      }
+    }
+
+    if (!(src[i] & 0x80)) {
+      i++;
+      n++;
+      continue;
+    }
+
+    const gunichar c = g_utf8_get_char_validated (src + i, len - i);
+    if ((c == (gunichar) -1) || (c == (gunichar) -2))
+      return -1;
+
+    n += (c < 0x10000) ? 1 : 2;
+    i += g_utf8_skip[*(const guchar *) (src + i)];
+  }
+
+  return n;
+}
+
+/* Encode the @len bytes of @src, which must have been validated with
+ * _garil_utf8_to_utf16_len(), into @dst. No NUL terminator is written.
+ * Returns the number of code units written. */
+gsize
+_garil_utf8_to_utf16_encode (const gchar *src,
+                             gsize        len,
+                             gunichar2   *dst)
+{
+  gunichar2 *p = dst;
+  gsize i = 0;
+
+  while (i < len) {
+    if (!(src[i] & 0x80)) {
+      const gsize n = _garil_utf8_widen_ascii (src + i, len - i, p);
+      i += n;
+      p += n;
+      continue;
+    }
+
+    const gunichar c = g_utf8_get_char (src + i);
+    i += g_utf8_skip[*(const guchar *) (src + i)];
+
+    if (c < 0x10000)
+      *p++ = c;
+    else {
+      *p++ = 0xd800 + ((c - 0x10000) >> 10);
+      *p++ = 0xdc00 + ((c - 0x10000) & 0x3ff);
+    }
+  }
+
+  return p - dst;
+}
+
+/* Copy @len 32-bit integers from @src to @dst, reversing the byte order of
+ * each. The buffers may be unaligned but must not overlap. */
+void
+_garil_int32_swap_copy (gint32       *dst,
+                        const gint32 *src,
+                        gsize         len)
+{
+  gsize i = 0;
+
+#if defined (HAVE_NEON)
+  for (; (i + 4) <= len; i += 4) {
+    const uint8x16_t v = vld1q_u8 ((const uint8_t *) (src + i));
+    vst1q_u8 ((uint8_t *) (dst + i), vrev32q_u8 (v));
+  }
+#elif defined (HAVE_VSX)
+  const __vector unsigned char mask = {
+    3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12
+  };
+  for (; (i + 4) <= len; i += 4) {
+    const __vector unsigned char v =
+      vec_xl (0, (const unsigned char *) (src + i));
+    vec_xst (vec_perm (v, v, mask), 0, (unsigned char *) (dst + i));
+  }
+#endif
+
+  for (; (i + 2) <= len; i += 2) {
+    guint64 word;
+    memcpy (&word, src + i, sizeof (word));
+    word = ((word & G_GUINT64_CONSTANT (0x00ff00ff00ff00ff)) << 8) |
+           ((word >> 8) & G_GUINT64_CONSTANT (0x00ff00ff00ff00ff));
+    word = ((word & G_GUINT64_CONSTANT (0x0000ffff0000ffff)) << 16) |
+           ((word >> 16) & G_GUINT64_CONSTANT (0x0000ffff0000ffff));
+    memcpy (dst + i, &word, sizeof (word));
+  }
+
+  if (i < len)
+    dst[i] = GUINT32_SWAP_LE_BE (src[i]);
+}
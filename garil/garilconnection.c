@@ -19,61 +19,1629 @@
 #include "config.h"
 #endif
 
+#include <string.h>
+
 #include "garil/garilconnection.h"
 #include "garil/garilenumtypes.h"
+#include "garil/garilframe-private.h"
+#include "garil/garilparcel-private.h"
+#include "garil/garilpending-private.h"
+#include "garil/garilspscqueue-private.h"
+#include "garil/gariltimerwheel-private.h"
+
+/**
+ * SECTION:garilconnection
+ * @title: RIL Connections
+ * @short_description: Raw RIL connection API
+ *
+ * GarilConnection wraps raw RIL traffic with GIO asynchronous APIs.
+ *
+ * Once initialized, a connection keeps reading from its stream in the
+ * thread-default main context of the thread it was created in. RIL frames, a
+ * big-endian 32-bit length followed by a parcel, are decoded incrementally,
+ * and as many frames as were received are handled per wakeup.
+ *
+ * With %GARIL_CONNECTION_FLAGS_DELAY_MESSAGE_PROCESSING, frames received
+ * before garil_connection_start_message_processing() are kept undecoded and
+ * handled in one batch once it's called. Reading stops while
+ * #GarilConnection:max-delayed-frames frames or
+ * #GarilConnection:max-delayed-bytes bytes are kept, so that a late start
+ * leaves the rest in the socket instead of in memory.
+ *
+ * Data is received into a few large, recycled buffers, and decoded parcels
+ * are views into them. For socket connections, the socket is read directly
+ * with recvmsg() until it would block, so a burst of unsolicited responses
+ * takes a handful of system calls rather than one per frame.
+ *
+ * With %GARIL_CONNECTION_FLAGS_IO_THREAD, all of that happens in a private
+ * thread running its own main context instead. Decoded frames are handed to
+ * the main context of the connection through a lock-free queue, which is
+ * woken once per batch of frames rather than once per frame, and frames to
+ * send travel the other way the same way. The socket keeps being drained
+ * while the main context is busy.
+ *
+ * Requests sent with garil_connection_send_request() are matched to their
+ * solicited responses by serial number through a table indexed by serial, so
+ * completing a response costs the same however many requests are in flight.
+ * At most #GarilConnection:max-in-flight requests are sent ahead of their
+ * responses. Further ones wait in one queue per #GarilRequestPriority, and
+ * the most urgent is sent first whenever a response frees a slot. Waiting
+ * requests are promoted one priority level for every 250 ms they waited, so
+ * that a steady stream of urgent requests never starves the others.
+ *
+ * Requests not answered within #GarilConnection:request-timeout fail with
+ * %G_IO_ERROR_TIMED_OUT. Their deadlines are kept in a hierarchical timer
+ * wheel, so a single timeout source serves all of them, and arming or
+ * disarming one takes constant time however many are in flight.
+ *
+ * Unsolicited responses are delivered to the callbacks subscribed to their
+ * code with garil_connection_unsolicited_subscribe(). Subscribers are found
+ * through a table indexed by code, and a response nobody subscribed to is
+ * dropped as soon as its code is read. Floods of responses with a code can
+ * be coalesced with garil_connection_set_unsolicited_policy(); responses
+ * superseded or only counted are dropped the same way.
+ */
+
+/* Upper bound of socket reads per wakeup, to keep other sources in the main
+ * context running during floods. */
+#define MAX_RECEIVES_PER_WAKEUP 16
+
+/* Upper bound of frames written with a single system call. */
+#define MAX_FRAMES_PER_WRITE 64
+
+/* Defaults of GarilConnection:max-delayed-frames and max-delayed-bytes. */
+#define DEFAULT_MAX_DELAYED_FRAMES 1024
+#define DEFAULT_MAX_DELAYED_BYTES (1024 * 1024)
+
+/* Upper bound of GarilConnection:coalescing-window. */
+#define MAX_COALESCING_WINDOW G_USEC_PER_SEC
+
+/* Waiting requests are promoted one priority level per interval. */
+#define AGING_INTERVAL (G_USEC_PER_SEC / 4)
+
+#define N_PRIORITIES (GARIL_REQUEST_PRIORITY_LOW + 1)
+
+/* RIL_UNSOL_RESPONSE_BASE, the smallest unsolicited response code. */
+#define UNSOLICITED_BASE 1000
+/* Number of unsolicited response codes that can be subscribed to. */
+#define N_UNSOLICITED_CODES 65536
+
+typedef struct _Transport Transport;
+typedef struct _OutFrame OutFrame;
+typedef struct _Request Request;
+typedef struct _Subscription Subscription;
+typedef struct _Subscribers Subscribers;
+typedef struct _Coalescer Coalescer;
+
+/* RIL response types */
+enum
+{
+  RESPONSE_SOLICITED = 0,
+  RESPONSE_UNSOLICITED = 1,
+};
+
+/**
+ * GarilConnection:
+ *
+ * An opaque structure.
+ */
+struct _GarilConnection {
+  /*< private >*/
+  GObject parent_instance;
+
+  volatile gint atom_flags;
+
+  GMutex init_lock;
+  GCond init_cond;
+  GSList *init_tasks;
+  GError *init_error;
+  GIOStream *stream;
+  GSocketAddress *address;
+  GarilConnectionFlags flags;
+  guint max_delayed_frames;
+  guint max_delayed_bytes;
+
+  volatile gint coalescing_window;
+
+  GMainContext *context;
+  Transport *transport;
+
+  /* Requests awaiting a response, and requests waiting to be sent because
+   * max_in_flight were already. Owned by the main context. */
+  GarilPendingTable *pending;
+  GQueue waiting[N_PRIORITIES];
+  guint n_waiting;
+  guint max_in_flight;
+
+  /* Deadlines of requests, and the source waking up for the next one. */
+  GarilTimerWheel *timers;
+  GSource *timeout_source;
+  guint request_timeout;
+
+  /* Subscribers by unsolicited response code - UNSOLICITED_BASE, grown to
+   * fit the largest code subscribed to, and subscriptions by ID. Owned by
+   * the main context. */
+  Subscribers *unsolicited;
+  guint n_unsolicited;
+  GHashTable *subscriptions;
+  guint last_subscription_id;
+  /* Nesting depth of unsolicited response dispatches, and the number of
+   * subscriptions removed meanwhile and still linked. */
+  guint dispatch_depth;
+  guint n_dead_subscriptions;
+  /* Number of responses the dispatch in progress stands for. */
+  guint dispatch_count;
+
+  /* Ends of coalescing windows, and the source waking up for the next one.
+   * Created with the first coalescing policy. */
+  GarilTimerWheel *deliveries;
+  GSource *delivery_source;
+};
+
+/* A frame queued for sending. The length prefix, and for requests the request
+ * code and serial, are kept next to the parcel and written from there, so
+ * that the parcel is never copied. */
+struct _OutFrame
+{
+  guint32 header[3];
+  guint header_size;
+  /* The payload, may be %NULL. */
+  GarilParcel *parcel;
+};
+
+/* Task data of garil_connection_send_request(). */
+struct _Request
+{
+  gint32 code;
+  GarilRequestPriority priority;
+  /* Set while waiting to be sent. */
+  GarilParcel *payload;
+  /* Link in GarilConnection::waiting, data is the task. */
+  GList link;
+  gint64 queued_time;
+  /* Armed with a GarilConnection:request-timeout, data is the task. */
+  GarilTimer timer;
+  /* Set once sent. */
+  gint32 serial;
+
+  gint32 ril_error;
+  GSource *cancel_source;
+};
+
+/* I/O state of a connection. Outstanding operations keep a reference to it
+ * rather than to the connection, so that dropping the last reference to the
+ * connection stops all I/O.
+ *
+ * All I/O runs in @context. That is the main context of the connection
+ * unless GARIL_CONNECTION_FLAGS_IO_THREAD is set, in which case it is the
+ * private context of an I/O thread, and frames cross between the two through
+ * @inbox and @outbox. */
+struct _Transport
+{
+  volatile gint ref_count;
+
+  /* Back pointer, cleared when the connection is disposed. Only used in the
+   * main context of the connection. */
+  GarilConnection *connection;
+
+  GMainContext *context;
+  GCancellable *cancellable;
+  /* Set if the stream is a socket connection. */
+  GSocket *socket;
+
+  /* I/O thread mode. Frames received by the I/O thread, and the source
+   * handling them in the main context of the connection. */
+  GarilSpscQueue *inbox;
+  GSource *inbox_source;
+  volatile gint inbox_signalled;
+  guint n_inbox_pushed;
+  /* The error that stopped the I/O thread, set at most once. */
+  gpointer volatile inbox_error;
+  /* Frames queued in the main context of the connection. */
+  GarilSpscQueue *outbox;
+
+  /* Receiving */
+  GInputStream *istream;
+  GSource *read_source;
+  GarilFrameDecoder *decoder;
+  /* Frames received until message processing starts, with their total size
+   * and bounds, and the source starting it. Reading pauses at either bound.
+   * Owned by the I/O context. */
+  gboolean delaying;
+  gboolean read_paused;
+  GQueue delayed;
+  gsize n_delayed_bytes;
+  guint max_delayed_frames;
+  gsize max_delayed_bytes;
+  GSource *start_source;
+
+  /* Sending */
+  GOutputStream *ostream;
+  GQueue out_queue;
+  /* Bytes of the first queued frame already written. */
+  gsize out_offset;
+  /* Number of queued frames passed to a pending stream write. */
+  guint n_writing;
+  GArray *out_vectors;
+  GSource *write_source;
+  /* Flushes the queue when ready, lives as long as the transport. */
+  GSource *flush_source;
+  volatile gint flush_scheduled;
+};
+
+struct _Subscription
+{
+  Subscription *next;
+  guint id;
+  gint32 code;
+  /* %NULL once unsubscribed. */
+  GarilUnsolicitedCallback callback;
+  gpointer user_data;
+  GDestroyNotify user_data_free_func;
+};
+
+/* Subscribers to one unsolicited response code, in subscription order, and
+ * its coalescing policy. */
+struct _Subscribers
+{
+  Subscription *head;
+  Subscription *tail;
+  Coalescer *coalescer;
+};
+
+/* Responses with a code held back until the end of a coalescing window. */
+struct _Coalescer
+{
+  gint32 code;
+  GarilUnsolicitedPolicy policy;
+  guint window;
+
+  /* Armed while responses are held back, data is the coalescer. */
+  GarilTimer timer;
+  guint count;
+  /* The latest response with %GARIL_UNSOLICITED_POLICY_LATEST. */
+  GarilParcel *frame;
+  goffset position;
+};
+
+static void initable_iface_init (GInitableIface *initable_iface);
+static void async_initable_iface_init (GAsyncInitableIface *async_initable_iface);
+
+G_DEFINE_TYPE_WITH_CODE (GarilConnection, garil_connection, G_TYPE_OBJECT,
+                         G_IMPLEMENT_INTERFACE (G_TYPE_INITABLE,
+                                                initable_iface_init)
+                         G_IMPLEMENT_INTERFACE (G_TYPE_ASYNC_INITABLE,
+                                                async_initable_iface_init)
+                        );
+
+/* Flags for GarilConnection::atom_flags */
+enum
+{
+  FLAG_INITIALIZED = (1 << 0),
+  FLAG_CLOSED = (1 << 1),
+};
+
+enum
+{
+  PROP_0,
+  PROP_STREAM,
+  PROP_ADDRESS,
+  PROP_FLAGS,
+  PROP_MAX_IN_FLIGHT,
+  PROP_COALESCING_WINDOW,
+  PROP_REQUEST_TIMEOUT,
+  PROP_MAX_DELAYED_FRAMES,
+  PROP_MAX_DELAYED_BYTES,
+  N_PROPERTIES
+};
+
+static GParamSpec *props[N_PROPERTIES] = { NULL, };
+
+/* Create a frame for @parcel, preceded by @n_words little-endian int32 header
+ * words after the length prefix. */
+static OutFrame*
+out_frame_new (GarilParcel   *parcel,
+               const gint32  *words,
+               guint          n_words)
+{
+  OutFrame *frame = g_slice_new (OutFrame);
+  const gsize payload_size =
+    (parcel != NULL) ? garil_parcel_get_size (parcel) : 0;
+
+  frame->header[0] =
+    GUINT32_TO_BE (payload_size + (n_words * sizeof (guint32)));
+  for (guint i = 0; i < n_words; i++)
+    frame->header[i + 1] = GINT32_TO_LE (words[i]);
+  frame->header_size = (n_words + 1) * sizeof (guint32);
+  frame->parcel = (parcel != NULL) ? garil_parcel_ref (parcel) : NULL;
+
+  return frame;
+}
+
+static void
+out_frame_free (OutFrame *frame)
+{
+  if (frame->parcel != NULL)
+    garil_parcel_unref (frame->parcel);
+  g_slice_free (OutFrame, frame);
+}
+
+static gsize
+out_frame_get_size (const OutFrame *frame)
+{
+  return sizeof (guint32) + GUINT32_FROM_BE (frame->header[0]);
+}
+
+static Transport*
+transport_ref (Transport *transport)
+{
+  g_atomic_int_inc (&transport->ref_count);
+  return transport;
+}
+
+static void
+clear_source (GSource **source)
+{
+  if (*source != NULL) {
+    g_source_destroy (*source);
+    g_source_unref (*source);
+    *source = NULL;
+  }
+}
+
+static void
+transport_unref (Transport *transport)
+{
+  const gboolean io_thread = (transport->inbox != NULL);
+
+  /* Once the reference is dropped, the I/O thread may exit and free the
+   * transport before it is woken up, so wake up a context of our own. */
+  GMainContext *context =
+    io_thread ? g_main_context_ref (transport->context) : NULL;
+
+  const gint old_ref_count = g_atomic_int_add (&transport->ref_count, -1);
+
+  /* The I/O thread holds the last reference, let it exit. */
+  if (io_thread) {
+    if (old_ref_count == 2)
+      g_main_context_wakeup (context);
+    g_main_context_unref (context);
+  }
+
+  if (old_ref_count != 1)
+    return;
+
+  g_assert (transport->connection == NULL);
+
+  clear_source (&transport->read_source);
+  clear_source (&transport->write_source);
+  clear_source (&transport->flush_source);
+
+  g_queue_foreach (&transport->out_queue, (GFunc) out_frame_free, NULL);
+  g_queue_clear (&transport->out_queue);
+  g_array_unref (transport->out_vectors);
+  g_object_unref (transport->ostream);
+
+  clear_source (&transport->start_source);
+  g_queue_foreach (&transport->delayed, (GFunc) garil_parcel_unref, NULL);
+  g_queue_clear (&transport->delayed);
+  _garil_frame_decoder_free (transport->decoder);
+  g_object_unref (transport->istream);
+
+  if (transport->inbox != NULL) {
+    clear_source (&transport->inbox_source);
+    _garil_spsc_queue_free (transport->inbox,
+                            (GDestroyNotify) garil_parcel_unref);
+    _garil_spsc_queue_free (transport->outbox,
+                            (GDestroyNotify) out_frame_free);
+    if (transport->inbox_error != NULL)
+      g_error_free (transport->inbox_error);
+  }
+
+  if (transport->socket != NULL)
+    g_object_unref (transport->socket);
+  g_object_unref (transport->cancellable);
+  g_main_context_unref (transport->context);
+  g_free (transport);
+}
+
+/* Whether the transport was stopped or failed. Any thread. */
+static gboolean
+transport_is_stopped (Transport *transport)
+{
+  return g_cancellable_is_cancelled (transport->cancellable);
+}
+
+static void complete_request (GarilConnection *connection,
+                              GarilParcel     *frame);
+static void dispatch_unsolicited (GarilConnection *connection,
+                                  GarilParcel     *frame);
+static void fail_requests (GarilConnection *connection,
+                           const GError    *error);
+
+/* Handle a received frame in the main context of the connection. */
+static void
+process_frame (GarilConnection *connection,
+               GarilParcel     *frame)
+{
+  const gint32 type = garil_parcel_read_int32 (frame);
+  if (garil_parcel_is_malformed (frame)) {
+    g_debug ("connection %p: dropped a truncated frame", connection);
+    return;
+  }
+
+  if (type == RESPONSE_SOLICITED) {
+    complete_request (connection, frame);
+    return;
+  }
+
+  if (type == RESPONSE_UNSOLICITED) {
+    dispatch_unsolicited (connection, frame);
+    return;
+  }
+
+  g_debug ("connection %p: dropped a frame of type %d, %" G_GSIZE_FORMAT
+           " bytes", connection, type, garil_parcel_get_size (frame));
+}
+
+/* Called for every frame decoded in the main context of the connection. */
+static void
+handle_frame (GarilParcel *frame,
+              gpointer     user_data)
+{
+  Transport *transport = user_data;
+
+  /* Disposed by a previous frame of the same batch. */
+  if (transport->connection == NULL)
+    return;
+
+  process_frame (transport->connection, frame);
+}
+
+/* Mark the connection closed after a failure of its transport. */
+static void
+close_connection (GarilConnection *connection,
+                  const GError    *error)
+{
+  g_debug ("connection %p: closed: %s", connection, error->message);
+
+  g_atomic_int_or (&connection->atom_flags, FLAG_CLOSED);
+  fail_requests (connection, error);
+}
+
+/* Stop all I/O after a failure. @error is ignored if the transport was
+ * stopped on purpose. */
+static void
+transport_fail (Transport    *transport,
+                const GError *error)
+{
+  if (transport_is_stopped (transport) ||
+      g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+    return;
+
+  g_cancellable_cancel (transport->cancellable);
+  clear_source (&transport->read_source);
+  clear_source (&transport->write_source);
+  g_source_destroy (transport->flush_source);
+  if (transport->start_source != NULL)
+    g_source_destroy (transport->start_source);
+
+  if (transport->inbox == NULL) {
+    close_connection (transport->connection, error);
+    return;
+  }
+
+  /* Handled in the main context after the frames received before. */
+  g_atomic_pointer_set (&transport->inbox_error, g_error_copy (error));
+  g_atomic_int_set (&transport->inbox_signalled, 1);
+  g_source_set_ready_time (transport->inbox_source, 0);
+}
+
+/* Dispatches whenever its ready time is reached. */
+static gboolean
+ready_source_dispatch (GSource     *source G_GNUC_UNUSED,
+                       GSourceFunc  callback,
+                       gpointer     user_data)
+{
+  return callback (user_data);
+}
+
+static GSourceFuncs ready_source_funcs = {
+  NULL,
+  NULL,
+  ready_source_dispatch,
+  NULL,
+};
+
+/*** I/O thread ***/
+
+/* Called for every frame decoded in I/O thread mode. */
+static void
+push_frame (GarilParcel *frame,
+            gpointer     user_data)
+{
+  Transport *transport = user_data;
+
+  _garil_spsc_queue_push (transport->inbox, garil_parcel_ref (frame));
+  transport->n_inbox_pushed++;
+}
+
+/* Wake the main context of the connection for the frames pushed since the
+ * last call, unless it was woken already and didn't get to run yet. */
+static void
+signal_inbox (Transport *transport)
+{
+  if (transport->n_inbox_pushed == 0)
+    return;
+
+  transport->n_inbox_pushed = 0;
+  if (g_atomic_int_compare_and_exchange (&transport->inbox_signalled, 0, 1))
+    g_source_set_ready_time (transport->inbox_source, 0);
+}
+
+/* Runs in the main context of the connection. */
+static gboolean
+on_inbox (gpointer user_data)
+{
+  /* Frames may dispose the connection. */
+  Transport *transport = transport_ref (user_data);
+
+  /* Reset before draining, so that frames pushed meanwhile signal again. */
+  g_source_set_ready_time (transport->inbox_source, -1);
+  g_atomic_int_set (&transport->inbox_signalled, 0);
+
+  /* Read before draining, so that frames pushed before the error are
+   * processed first. */
+  const GError *error = g_atomic_pointer_get (&transport->inbox_error);
+
+  GarilParcel *frame;
+  while ((frame = _garil_spsc_queue_pop (transport->inbox)) != NULL) {
+    /* Disposed by a previous frame of the same batch. */
+    if (transport->connection != NULL)
+      process_frame (transport->connection, frame);
+    garil_parcel_unref (frame);
+  }
+
+  GarilConnection *connection = transport->connection;
+  if ((error != NULL) && (connection != NULL) &&
+      !(g_atomic_int_get (&connection->atom_flags) & FLAG_CLOSED))
+    close_connection (connection, error);
+
+  transport_unref (transport);
+
+  return G_SOURCE_CONTINUE;
+}
+
+static gpointer
+io_thread_run (gpointer user_data)
+{
+  Transport *transport = user_data;
+
+  g_main_context_push_thread_default (transport->context);
+
+  /* Run until the connection dropped its reference and all operations
+   * finished after being cancelled. transport_unref() wakes the context
+   * when only this reference is left. */
+  while (g_atomic_int_get (&transport->ref_count) > 1)
+    g_main_context_iteration (transport->context, TRUE);
+
+  g_main_context_pop_thread_default (transport->context);
+  transport_unref (transport);
+
+  return NULL;
+}
+
+/*** Receiving ***/
+
+/* Called for every frame decoded before message processing starts. */
+static void
+delay_frame (GarilParcel *frame,
+             gpointer     user_data)
+{
+  Transport *transport = user_data;
+
+  g_queue_push_tail (&transport->delayed, garil_parcel_ref (frame));
+  transport->n_delayed_bytes += garil_parcel_get_size (frame);
+}
+
+/* Whether reading should pause until message processing starts. Frames
+ * decoded from the same read are kept anyway, so the bounds can be
+ * exceeded by at most a receive buffer. */
+static gboolean
+transport_is_delay_full (Transport *transport)
+{
+  return transport->delaying &&
+    ((transport->delayed.length >= transport->max_delayed_frames) ||
+     (transport->n_delayed_bytes >= transport->max_delayed_bytes));
+}
+
+/* Decode @len bytes just received. Returns FALSE with @error set if the loop
+ * should stop. */
+static gboolean
+transport_commit (Transport  *transport,
+                  gssize      len,
+                  GError    **error)
+{
+  if (len == 0) {
+    g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_CONNECTION_CLOSED,
+                         "Connection closed by peer");
+    return FALSE;
+  }
+
+  if (transport->delaying)
+    return _garil_frame_decoder_commit (transport->decoder, len, delay_frame,
+                                        transport, error);
+
+  if (transport->inbox == NULL)
+    return _garil_frame_decoder_commit (transport->decoder, len, handle_frame,
+                                        transport, error);
+
+  const gboolean ret =
+    _garil_frame_decoder_commit (transport->decoder, len, push_frame,
+                                 transport, error);
+  signal_inbox (transport);
+
+  return ret;
+}
+
+static void transport_read (Transport *transport);
+
+static void
+on_read (GObject      *source_object,
+         GAsyncResult *res,
+         gpointer      user_data)
+{
+  Transport *transport = user_data;
+  GError *error = NULL;
+
+  const gssize len =
+    g_input_stream_read_finish (G_INPUT_STREAM (source_object), res, &error);
+
+  if (transport_is_stopped (transport))
+    goto out;
+
+  if ((len >= 0) && transport_commit (transport, len, &error) &&
+      !transport_is_stopped (transport)) {
+    if (transport_is_delay_full (transport))
+      transport->read_paused = TRUE;
+    else
+      transport_read (transport);
+  }
+
+  if (error != NULL)
+    transport_fail (transport, error);
+
+out:
+  g_clear_error (&error);
+  transport_unref (transport);
+}
+
+/* Must be called with @transport->context acquired. */
+static void
+transport_read (Transport *transport)
+{
+  gsize len;
+  guint8 *buffer = _garil_frame_decoder_get_buffer (transport->decoder, &len);
+
+  g_main_context_push_thread_default (transport->context);
+  g_input_stream_read_async (transport->istream, buffer, len,
+                             G_PRIORITY_DEFAULT, transport->cancellable,
+                             on_read, transport_ref (transport));
+  g_main_context_pop_thread_default (transport->context);
+}
+
+static gboolean
+on_socket_readable (GSocket      *socket,
+                    GIOCondition  condition G_GNUC_UNUSED,
+                    gpointer      user_data)
+{
+  Transport *transport = user_data;
+  GError *error = NULL;
+
+  for (guint i = 0; i < MAX_RECEIVES_PER_WAKEUP; i++) {
+    if (transport_is_stopped (transport))
+      return G_SOURCE_REMOVE;
+
+    GInputVector vector;
+    vector.buffer = _garil_frame_decoder_get_buffer (transport->decoder,
+                                                     &vector.size);
+    gint flags = 0;
+
+    const gssize len =
+      g_socket_receive_message (socket, NULL, &vector, 1, NULL, NULL, &flags,
+                                transport->cancellable, &error);
+    if (len < 0) {
+      if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_WOULD_BLOCK)) {
+        g_error_free (error);
+        return G_SOURCE_CONTINUE;
+      }
+      break;
+    }
+
+    if (!transport_commit (transport, len, &error))
+      break;
+
+    if (transport_is_delay_full (transport)) {
+      transport->read_paused = TRUE;
+      g_source_unref (transport->read_source);
+      transport->read_source = NULL;
+      return G_SOURCE_REMOVE;
+    }
+  }
+
+  if (error == NULL)
+    return G_SOURCE_CONTINUE;
+
+  transport_fail (transport, error);
+  g_error_free (error);
+
+  return G_SOURCE_REMOVE;
+}
+
+static gboolean
+transport_start (gpointer user_data)
+{
+  Transport *transport = user_data;
+
+  if (transport_is_stopped (transport))
+    return G_SOURCE_REMOVE;
+
+  if (transport->socket != NULL) {
+    transport->read_source =
+      g_socket_create_source (transport->socket, G_IO_IN,
+                              transport->cancellable);
+    g_source_set_callback (transport->read_source,
+                           (GSourceFunc) on_socket_readable,
+                           transport_ref (transport),
+                           (GDestroyNotify) transport_unref);
+    g_source_attach (transport->read_source, transport->context);
+  } else {
+    transport_read (transport);
+  }
+
+  return G_SOURCE_REMOVE;
+}
+
+/* Handle the frames received so far in one batch, then go on reading if
+ * that was paused. Runs in the I/O context. */
+static gboolean
+on_start (gpointer user_data)
+{
+  /* Frames may dispose the connection. */
+  Transport *transport = transport_ref (user_data);
+
+  g_source_set_ready_time (transport->start_source, -1);
+
+  if (transport->delaying && !transport_is_stopped (transport)) {
+    const GarilFrameFunc func =
+      (transport->inbox != NULL) ? push_frame : handle_frame;
+
+    transport->delaying = FALSE;
+    transport->n_delayed_bytes = 0;
+
+    GarilParcel *frame;
+    while ((frame = g_queue_pop_head (&transport->delayed)) != NULL) {
+      func (frame, transport);
+      garil_parcel_unref (frame);
+    }
+    if (transport->inbox != NULL)
+      signal_inbox (transport);
+
+    if (transport->read_paused && !transport_is_stopped (transport)) {
+      transport->read_paused = FALSE;
+      transport_start (transport);
+    }
+  }
+
+  transport_unref (transport);
+
+  return G_SOURCE_CONTINUE;
+}
+
+/*** Sending ***/
+
+/* Collect the vectors of up to MAX_FRAMES_PER_WRITE queued frames, skipping
+ * what was already written. Returns the number of frames covered. */
+static guint
+transport_build_vectors (Transport *transport)
+{
+  GArray *vectors = transport->out_vectors;
+  g_array_set_size (vectors, 0);
+
+  guint n_frames = 0;
+  for (GList *l = transport->out_queue.head;
+       (l != NULL) && (n_frames < MAX_FRAMES_PER_WRITE);
+       l = l->next, n_frames++) {
+    OutFrame *frame = l->data;
+
+    const GOutputVector header = { frame->header, frame->header_size };
+    g_array_append_val (vectors, header);
+
+    if (frame->parcel == NULL)
+      continue;
+
+    const guint base = vectors->len;
+    const guint n = garil_parcel_get_vectors (frame->parcel, NULL, 0);
+    g_array_set_size (vectors, base + n);
+    garil_parcel_get_vectors (frame->parcel,
+                              &g_array_index (vectors, GOutputVector, base), n);
+  }
+
+  gsize skip = transport->out_offset;
+  guint i = 0;
+  while (skip) {
+    GOutputVector *vector = &g_array_index (vectors, GOutputVector, i);
+    if (vector->size > skip) {
+      vector->buffer = ((const guint8 *) vector->buffer) + skip;
+      vector->size -= skip;
+      break;
+    }
+    skip -= vector->size;
+    i++;
+  }
+  if (i)
+    g_array_remove_range (vectors, 0, i);
+
+  return n_frames;
+}
+
+/* Drop frames completed by @len more bytes written. */
+static void
+transport_advance (Transport *transport,
+                   gsize      len)
+{
+  len += transport->out_offset;
+
+  while (len) {
+    OutFrame *frame = g_queue_peek_head (&transport->out_queue);
+    const gsize size = out_frame_get_size (frame);
+    if (len < size)
+      break;
+
+    len -= size;
+    out_frame_free (g_queue_pop_head (&transport->out_queue));
+  }
+
+  transport->out_offset = len;
+}
+
+static void transport_flush (Transport *transport);
+
+static gboolean
+on_socket_writable (GSocket      *socket G_GNUC_UNUSED,
+                    GIOCondition  condition G_GNUC_UNUSED,
+                    gpointer      user_data)
+{
+  Transport *transport = user_data;
+
+  g_source_unref (transport->write_source);
+  transport->write_source = NULL;
+
+  if (!transport_is_stopped (transport))
+    transport_flush (transport);
+
+  return G_SOURCE_REMOVE;
+}
+
+static void
+on_written (GObject      *source_object,
+            GAsyncResult *res,
+            gpointer      user_data)
+{
+  Transport *transport = user_data;
+  GError *error = NULL;
+  gsize len = 0;
+
+  g_output_stream_writev_all_finish (G_OUTPUT_STREAM (source_object), res,
+                                     &len, &error);
+
+  if (transport_is_stopped (transport))
+    goto out;
+
+  transport->n_writing = 0;
+  if (error != NULL) {
+    transport_fail (transport, error);
+    goto out;
+  }
+
+  transport_advance (transport, len);
+  transport_flush (transport);
+
+out:
+  g_clear_error (&error);
+  transport_unref (transport);
+}
+
+/* Write as many queued frames as possible, each system call covering a batch
+ * of them. Must be called with @transport->context acquired. */
+static void
+transport_flush (Transport *transport)
+{
+  if (transport->n_writing || (transport->write_source != NULL))
+    return;
+
+  while (!g_queue_is_empty (&transport->out_queue)) {
+    const guint n_frames = transport_build_vectors (transport);
+    GArray *vectors = transport->out_vectors;
+
+    if (transport->socket == NULL) {
+      transport->n_writing = n_frames;
+
+      g_main_context_push_thread_default (transport->context);
+      g_output_stream_writev_all_async (transport->ostream,
+                                        (GOutputVector *) vectors->data,
+                                        vectors->len, G_PRIORITY_DEFAULT,
+                                        transport->cancellable, on_written,
+                                        transport_ref (transport));
+      g_main_context_pop_thread_default (transport->context);
+      return;
+    }
+
+    GError *error = NULL;
+    const gssize len =
+      g_socket_send_message (transport->socket, NULL,
+                             (GOutputVector *) vectors->data, vectors->len,
+                             NULL, 0, G_SOCKET_MSG_NONE,
+                             transport->cancellable, &error);
+    if (len < 0) {
+      if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_WOULD_BLOCK)) {
+        transport->write_source =
+          g_socket_create_source (transport->socket, G_IO_OUT,
+                                  transport->cancellable);
+        g_source_set_callback (transport->write_source,
+                               (GSourceFunc) on_socket_writable,
+                               transport_ref (transport),
+                               (GDestroyNotify) transport_unref);
+        g_source_attach (transport->write_source, transport->context);
+      } else {
+        transport_fail (transport, error);
+      }
+      g_error_free (error);
+      return;
+    }
+
+    transport_advance (transport, len);
+  }
+}
+
+static gboolean
+on_flush (gpointer user_data)
+{
+  Transport *transport = user_data;
+
+  /* Reset before draining, so that frames queued meanwhile schedule
+   * another flush. */
+  g_source_set_ready_time (transport->flush_source, -1);
+  g_atomic_int_set (&transport->flush_scheduled, 0);
+
+  if (transport->outbox != NULL) {
+    OutFrame *frame;
+    while ((frame = _garil_spsc_queue_pop (transport->outbox)) != NULL)
+      g_queue_push_tail (&transport->out_queue, frame);
+  }
+
+  /* A failure may dispose the connection. */
+  transport_ref (transport);
+  if (!transport_is_stopped (transport))
+    transport_flush (transport);
+  transport_unref (transport);
+
+  return G_SOURCE_CONTINUE;
+}
+
+/* Queue @frame to be sent. Frames queued within the coalescing window, or
+ * before the I/O context gets to run otherwise, are written together. Must
+ * be called from the main context of the connection. */
+static void
+transport_send (Transport *transport,
+                OutFrame  *frame)
+{
+  if (transport->outbox != NULL)
+    _garil_spsc_queue_push (transport->outbox, frame);
+  else
+    g_queue_push_tail (&transport->out_queue, frame);
+
+  if (!g_atomic_int_compare_and_exchange (&transport->flush_scheduled, 0, 1))
+    return;
+
+  const gint window =
+    g_atomic_int_get (&transport->connection->coalescing_window);
+  g_source_set_ready_time (transport->flush_source,
+                           window ? (g_get_monotonic_time () + window) : 0);
+}
+
+/*** Requests ***/
+
+static void
+request_free (Request *request)
+{
+  clear_source (&request->cancel_source);
+  if (request->payload != NULL)
+    garil_parcel_unref (request->payload);
+  g_slice_free (Request, request);
+}
+
+static gboolean
+can_send_request (GarilConnection *connection)
+{
+  return (connection->max_in_flight == 0) ||
+    (_garil_pending_table_get_size (connection->pending) <
+       connection->max_in_flight);
+}
+
+/* Allocate a serial for the request and queue it for sending. */
+static void
+send_request (GarilConnection *connection,
+              GTask           *task)
+{
+  Request *request = g_task_get_task_data (task);
+
+  /* The table keeps the reference until the request completes. */
+  request->serial = _garil_pending_table_insert (connection->pending, task);
+
+  const gint32 header[] = { request->code, request->serial };
+  transport_send (connection->transport,
+                  out_frame_new (request->payload, header,
+                                 G_N_ELEMENTS (header)));
+  if (request->payload != NULL) {
+    garil_parcel_unref (request->payload);
+    request->payload = NULL;
+  }
+}
+
+static void
+queue_request (GarilConnection *connection,
+               GTask           *task)
+{
+  Request *request = g_task_get_task_data (task);
+
+  request->queued_time = g_get_monotonic_time ();
+  /* The queue keeps the reference until the request is sent. */
+  g_queue_push_tail_link (&connection->waiting[request->priority],
+                          &request->link);
+  connection->n_waiting++;
+}
+
+static void
+unqueue_request (GarilConnection *connection,
+                 Request         *request)
+{
+  g_queue_unlink (&connection->waiting[request->priority], &request->link);
+  connection->n_waiting--;
+}
+
+/* Pick the queue to send from. Queues are FIFO, so only their heads, which
+ * waited longest, need to be compared after aging. Ties go to the more
+ * urgent queue. */
+static GQueue*
+next_waiting_queue (GarilConnection *connection,
+                    gint64           now)
+{
+  GQueue *next = NULL;
+  gint64 next_level = G_MAXINT64;
+
+  for (guint i = 0; i < N_PRIORITIES; i++) {
+    GQueue *queue = &connection->waiting[i];
+    if (g_queue_is_empty (queue))
+      continue;
+
+    const Request *request = g_task_get_task_data (g_queue_peek_head (queue));
+    const gint64 level =
+      (gint64) i - ((now - request->queued_time) / AGING_INTERVAL);
+    if (level < next_level) {
+      next = queue;
+      next_level = level;
+    }
+  }
+
+  return next;
+}
+
+/* Send waiting requests, most urgent first, while the window allows. */
+static void
+send_waiting_requests (GarilConnection *connection)
+{
+  if ((connection->transport == NULL) ||
+      (g_atomic_int_get (&connection->atom_flags) & FLAG_CLOSED) ||
+      (connection->n_waiting == 0))
+    return;
+
+  const gint64 now = g_get_monotonic_time ();
+  while (connection->n_waiting && can_send_request (connection)) {
+    GList *link =
+      g_queue_pop_head_link (next_waiting_queue (connection, now));
+    connection->n_waiting--;
+    send_request (connection, link->data);
+  }
+}
+
+/* Stop watching for cancellation and timeout of a request about to
+ * complete. */
+static void
+disarm_request (GarilConnection *connection,
+                Request         *request)
+{
+  clear_source (&request->cancel_source);
+  if (_garil_timer_is_active (&request->timer))
+    _garil_timer_wheel_remove (connection->timers, &request->timer);
+}
+
+/* Take a request off the waiting queues or the pending table before it got
+ * a response. A late response to it is dropped as one to an unknown
+ * serial. */
+static void
+abandon_request (GarilConnection *connection,
+                 GTask           *task)
+{
+  Request *request = g_task_get_task_data (task);
+
+  disarm_request (connection, request);
+
+  if (request->serial == 0) {
+    unqueue_request (connection, request);
+  } else {
+    GTask *pending =
+      _garil_pending_table_remove (connection->pending, request->serial);
+    g_assert (pending == task);
+  }
+}
+
+static void
+complete_request (GarilConnection *connection,
+                  GarilParcel     *frame)
+{
+  const gint32 serial = garil_parcel_read_int32 (frame);
+  const gint32 ril_error = garil_parcel_read_int32 (frame);
+  if (garil_parcel_is_malformed (frame)) {
+    g_debug ("connection %p: dropped a truncated response", connection);
+    return;
+  }
+
+  GTask *task = _garil_pending_table_remove (connection->pending, serial);
+  if (task == NULL) {
+    g_debug ("connection %p: dropped a response to unknown serial %d",
+             connection, serial);
+    return;
+  }
+
+  Request *request = g_task_get_task_data (task);
+  request->ril_error = ril_error;
+  disarm_request (connection, request);
+
+  /* The task may hold the last reference to the connection. */
+  g_object_ref (connection);
+
+  g_task_return_pointer (task, garil_parcel_ref (frame),
+                         (GDestroyNotify) garil_parcel_unref);
+  g_object_unref (task);
+
+  send_waiting_requests (connection);
+  g_object_unref (connection);
+}
+
+static void
+fail_request (gpointer data,
+              gpointer user_data)
+{
+  GTask *task = data;
+  const GError *error = user_data;
+  Request *request = g_task_get_task_data (task);
 
-/**
- * SECTION:garilconnection
- * @title: RIL Connections
- * @short_description: Raw RIL connection API
- *
- * GarilConnection wraps raw RIL traffic with GIO asynchronous APIs.
- */
+  disarm_request (g_task_get_source_object (task), request);
+  g_task_return_error (task, g_error_copy (error));
+  g_object_unref (task);
+}
 
-/**
- * GarilConnection:
- *
- * An opaque structure.
- */
-struct _GarilConnection {
-  /*< private >*/
-  GObject parent_instance;
+static void
+fail_requests (GarilConnection *connection,
+               const GError    *error)
+{
+  g_object_ref (connection);
 
-  volatile gint atom_flags;
+  _garil_pending_table_steal_all (connection->pending, fail_request,
+                                  (gpointer) error);
 
-  GMutex init_lock;
-  GError *init_error;
-  GIOStream *stream;
-  GSocketAddress *address;
-  GarilConnectionFlags flags;
-};
+  for (guint i = 0; i < N_PRIORITIES; i++) {
+    GList *link;
+    while ((link = g_queue_pop_head_link (&connection->waiting[i])) != NULL) {
+      connection->n_waiting--;
+      fail_request (link->data, (gpointer) error);
+    }
+  }
 
-static void initable_iface_init (GInitableIface *initable_iface);
-static void async_initable_iface_init (GAsyncInitableIface *async_initable_iface);
+  g_object_unref (connection);
+}
 
-G_DEFINE_TYPE_WITH_CODE (GarilConnection, garil_connection, G_TYPE_OBJECT,
-                         G_IMPLEMENT_INTERFACE (G_TYPE_INITABLE,
-                                                initable_iface_init)
-                         G_IMPLEMENT_INTERFACE (G_TYPE_ASYNC_INITABLE,
-                                                async_initable_iface_init)
-                        );
+static gboolean
+on_request_cancelled (GCancellable *cancellable G_GNUC_UNUSED,
+                      gpointer      user_data)
+{
+  GTask *task = user_data;
+  GarilConnection *connection = g_object_ref (g_task_get_source_object (task));
 
-/* Flags for GarilConnection::atom_flags */
-enum
+  abandon_request (connection, task);
+
+  g_task_return_error_if_cancelled (task);
+  g_object_unref (task);
+
+  send_waiting_requests (connection);
+  g_object_unref (connection);
+
+  return G_SOURCE_REMOVE;
+}
+
+static void
+schedule_request_timeouts (GarilConnection *connection)
 {
-  FLAG_INITIALIZED = (1 << 0),
-};
+  g_source_set_ready_time (connection->timeout_source,
+                           _garil_timer_wheel_get_next_deadline (
+                             connection->timers));
+}
 
-enum
+static void
+arm_request (GarilConnection *connection,
+             GTask           *task)
 {
-  PROP_0,
-  PROP_STREAM,
-  PROP_ADDRESS,
-  PROP_FLAGS,
-  N_PROPERTIES
-};
+  Request *request = g_task_get_task_data (task);
 
-static GParamSpec *props[N_PROPERTIES] = { NULL, };
+  request->timer.data = task;
+  _garil_timer_wheel_add (connection->timers, &request->timer,
+                          g_get_monotonic_time () +
+                            (gint64) connection->request_timeout * 1000);
+  schedule_request_timeouts (connection);
+}
+
+static gboolean
+on_request_timeout (gpointer user_data)
+{
+  GarilConnection *connection = g_object_ref (user_data);
+  const gint64 now = g_get_monotonic_time ();
+
+  GarilTimer *timer;
+  while ((timer = _garil_timer_wheel_pop_expired (connection->timers,
+                                                  now)) != NULL) {
+    GTask *task = timer->data;
+
+    abandon_request (connection, task);
+    g_task_return_new_error (task, G_IO_ERROR, G_IO_ERROR_TIMED_OUT,
+                             "Request timed out");
+    g_object_unref (task);
+  }
+
+  schedule_request_timeouts (connection);
+  send_waiting_requests (connection);
+  g_object_unref (connection);
+
+  return G_SOURCE_CONTINUE;
+}
+
+/*** Unsolicited responses ***/
+
+static void
+subscription_unlink (GarilConnection *connection,
+                     Subscription    *subscription)
+{
+  Subscribers *subscribers =
+    &connection->unsolicited[subscription->code - UNSOLICITED_BASE];
+
+  Subscription *prev = NULL;
+  for (Subscription *s = subscribers->head; s != subscription; s = s->next)
+    prev = s;
+
+  if (prev != NULL)
+    prev->next = subscription->next;
+  else
+    subscribers->head = subscription->next;
+  if (subscribers->tail == subscription)
+    subscribers->tail = prev;
+}
+
+/* Free an unlinked subscription. The user data may be freed only now, as the
+ * callback may be running until its dispatch is over. */
+static void
+subscription_free (Subscription *subscription)
+{
+  if (subscription->user_data_free_func != NULL)
+    subscription->user_data_free_func (subscription->user_data);
+
+  g_slice_free (Subscription, subscription);
+}
+
+/* Free the subscriptions removed while responses were being dispatched. They
+ * are all unlinked first, as freeing user data may unsubscribe others. */
+static void
+sweep_subscriptions (GarilConnection *connection)
+{
+  Subscription *dead = NULL;
+
+  for (guint i = 0;
+       (i < connection->n_unsolicited) && connection->n_dead_subscriptions;
+       i++) {
+    Subscription *subscription = connection->unsolicited[i].head;
+    while (subscription != NULL) {
+      Subscription *next = subscription->next;
+      if (subscription->callback == NULL) {
+        subscription_unlink (connection, subscription);
+        connection->n_dead_subscriptions--;
+        subscription->next = dead;
+        dead = subscription;
+      }
+      subscription = next;
+    }
+  }
+
+  while (dead != NULL) {
+    Subscription *next = dead->next;
+    subscription_free (dead);
+    dead = next;
+  }
+}
+
+/* Called once the subscription is out of GarilConnection::subscriptions.
+ * While a dispatch may be walking the list, it's only marked, and freed once
+ * the dispatch is over. */
+static void
+remove_subscription (GarilConnection *connection,
+                     Subscription    *subscription)
+{
+  subscription->callback = NULL;
+
+  if (connection->dispatch_depth) {
+    connection->n_dead_subscriptions++;
+  } else {
+    subscription_unlink (connection, subscription);
+    subscription_free (subscription);
+  }
+}
+
+static Subscribers*
+ensure_subscribers (GarilConnection *connection,
+                    gint32           code)
+{
+  const guint index = code - UNSOLICITED_BASE;
+  if (index >= connection->n_unsolicited) {
+    guint n = MAX (connection->n_unsolicited, 64);
+    while (n <= index)
+      n <<= 1;
+    connection->unsolicited =
+      g_renew (Subscribers, connection->unsolicited, n);
+    memset (connection->unsolicited + connection->n_unsolicited, 0,
+            (n - connection->n_unsolicited) * sizeof (Subscribers));
+    connection->n_unsolicited = n;
+  }
+
+  return &connection->unsolicited[index];
+}
+
+/* Call the subscribers of @code with @frame, positioned at the response
+ * data, or %NULL for counted responses. Each gets the frame from the same
+ * position. Subscriptions made meanwhile only see the next response. */
+static void
+deliver_unsolicited (GarilConnection *connection,
+                     gint32           code,
+                     GarilParcel     *frame,
+                     guint            count)
+{
+  const Subscribers *subscribers =
+    &connection->unsolicited[code - UNSOLICITED_BASE];
+  if (subscribers->head == NULL)
+    return;
+
+  const goffset position = (frame != NULL) ?
+    garil_parcel_get_position (frame) : 0;
+  Subscription *subscription = subscribers->head;
+  const Subscription *last = subscribers->tail;
+  const guint outer_count = connection->dispatch_count;
+
+  g_object_ref (connection);
+  connection->dispatch_depth++;
+  connection->dispatch_count = count;
+
+  for (;;) {
+    if (subscription->callback != NULL) {
+      if (frame != NULL)
+        _garil_parcel_rewind (frame, position);
+      subscription->callback (connection, code, frame,
+                              subscription->user_data);
+    }
+    if (subscription == last)
+      break;
+    subscription = subscription->next;
+  }
+
+  connection->dispatch_count = outer_count;
+  if ((--connection->dispatch_depth == 0) &&
+      connection->n_dead_subscriptions)
+    sweep_subscriptions (connection);
+
+  g_object_unref (connection);
+}
+
+static void
+schedule_deliveries (GarilConnection *connection)
+{
+  g_source_set_ready_time (connection->delivery_source,
+                           _garil_timer_wheel_get_next_deadline (
+                             connection->deliveries));
+}
+
+/* Deliver what was held back by coalescers whose window ended. */
+static gboolean
+on_delivery (gpointer user_data)
+{
+  GarilConnection *connection = g_object_ref (user_data);
+  const gint64 now = g_get_monotonic_time ();
+
+  GarilTimer *timer;
+  while ((timer = _garil_timer_wheel_pop_expired (connection->deliveries,
+                                                  now)) != NULL) {
+    Coalescer *coalescer = timer->data;
+    GarilParcel *frame = coalescer->frame;
+    const guint count = coalescer->count;
+
+    coalescer->frame = NULL;
+    coalescer->count = 0;
+
+    if (frame != NULL)
+      _garil_parcel_rewind (frame, coalescer->position);
+    deliver_unsolicited (connection, coalescer->code, frame, count);
+    if (frame != NULL)
+      garil_parcel_unref (frame);
+  }
+
+  schedule_deliveries (connection);
+  g_object_unref (connection);
+
+  return G_SOURCE_CONTINUE;
+}
+
+/* Hold a response back under the policy of @coalescer. Superseded and
+ * counted responses are dropped without reading past their code. */
+static void
+coalesce_unsolicited (GarilConnection *connection,
+                      Coalescer       *coalescer,
+                      GarilParcel     *frame)
+{
+  coalescer->count++;
+
+  if (coalescer->policy == GARIL_UNSOLICITED_POLICY_LATEST) {
+    if (coalescer->frame != NULL)
+      garil_parcel_unref (coalescer->frame);
+    coalescer->frame = garil_parcel_ref (frame);
+    coalescer->position = garil_parcel_get_position (frame);
+  }
+
+  if (!_garil_timer_is_active (&coalescer->timer)) {
+    _garil_timer_wheel_add (connection->deliveries, &coalescer->timer,
+                            g_get_monotonic_time () +
+                              (gint64) coalescer->window * 1000);
+    schedule_deliveries (connection);
+  }
+}
+
+/* Handle an unsolicited response according to the policy of its code. */
+static void
+dispatch_unsolicited (GarilConnection *connection,
+                      GarilParcel     *frame)
+{
+  const gint32 code = garil_parcel_read_int32 (frame);
+  if (garil_parcel_is_malformed (frame)) {
+    g_debug ("connection %p: dropped a truncated unsolicited response",
+             connection);
+    return;
+  }
+
+  /* Codes below the base wrap around past the end of the table. */
+  const guint index = (guint) code - UNSOLICITED_BASE;
+  if ((index >= connection->n_unsolicited) ||
+      (connection->unsolicited[index].head == NULL))
+    return;
+
+  Coalescer *coalescer = connection->unsolicited[index].coalescer;
+  if ((coalescer != NULL) &&
+      (coalescer->policy != GARIL_UNSOLICITED_POLICY_DELIVER_ALL))
+    coalesce_unsolicited (connection, coalescer, frame);
+  else
+    deliver_unsolicited (connection, code, frame, 1);
+}
+
+/*** Setup ***/
+
+/* Start I/O in the main context the connection was created in, or in a new
+ * I/O thread. Initialization may be running in a worker thread, so defer to
+ * an idle callback in the I/O context. */
+static void
+start_transport (GarilConnection *connection)
+{
+  g_assert (connection->transport == NULL);
+
+  const gboolean io_thread =
+    (connection->flags & GARIL_CONNECTION_FLAGS_IO_THREAD) != 0;
+
+  Transport *transport = g_new0 (Transport, 1);
+  transport->ref_count = 1;
+  transport->connection = connection;
+  transport->context = io_thread ?
+    g_main_context_new () : g_main_context_ref (connection->context);
+  transport->cancellable = g_cancellable_new ();
+  if (G_IS_SOCKET_CONNECTION (connection->stream)) {
+    GSocketConnection *socket_connection =
+      G_SOCKET_CONNECTION (connection->stream);
+    transport->socket =
+      g_object_ref (g_socket_connection_get_socket (socket_connection));
+  }
+
+  transport->istream =
+    g_object_ref (g_io_stream_get_input_stream (connection->stream));
+  transport->decoder = _garil_frame_decoder_new (0, 0);
+  g_queue_init (&transport->delayed);
+  if (connection->flags & GARIL_CONNECTION_FLAGS_DELAY_MESSAGE_PROCESSING) {
+    transport->delaying = TRUE;
+    transport->max_delayed_frames = connection->max_delayed_frames;
+    transport->max_delayed_bytes = connection->max_delayed_bytes;
+    transport->start_source =
+      g_source_new (&ready_source_funcs, sizeof (GSource));
+    g_source_set_callback (transport->start_source, on_start, transport, NULL);
+    g_source_attach (transport->start_source, transport->context);
+  }
+
+  transport->ostream =
+    g_object_ref (g_io_stream_get_output_stream (connection->stream));
+  g_queue_init (&transport->out_queue);
+  transport->out_vectors = g_array_new (FALSE, FALSE, sizeof (GOutputVector));
+  transport->flush_source =
+    g_source_new (&ready_source_funcs, sizeof (GSource));
+  g_source_set_callback (transport->flush_source, on_flush, transport, NULL);
+  g_source_attach (transport->flush_source, transport->context);
+
+  if (io_thread) {
+    transport->inbox = _garil_spsc_queue_new ();
+    transport->outbox = _garil_spsc_queue_new ();
+    transport->inbox_source =
+      g_source_new (&ready_source_funcs, sizeof (GSource));
+    g_source_set_callback (transport->inbox_source, on_inbox, transport, NULL);
+    g_source_attach (transport->inbox_source, connection->context);
+  }
+
+  connection->transport = transport;
+
+  GSource *source = g_idle_source_new ();
+  g_source_set_callback (source, transport_start, transport_ref (transport),
+                         (GDestroyNotify) transport_unref);
+  g_source_attach (source, transport->context);
+  g_source_unref (source);
+
+  if (io_thread)
+    g_thread_unref (g_thread_new ("garil-io", io_thread_run,
+                                  transport_ref (transport)));
+}
+
+static void
+stop_transport (GarilConnection *connection)
+{
+  Transport *transport = connection->transport;
+  if (transport == NULL)
+    return;
+
+  connection->transport = NULL;
+  transport->connection = NULL;
+  g_cancellable_cancel (transport->cancellable);
+  g_source_destroy (transport->flush_source);
+  if (transport->start_source != NULL)
+    g_source_destroy (transport->start_source);
+
+  if (transport->inbox == NULL) {
+    clear_source (&transport->read_source);
+    clear_source (&transport->write_source);
+    transport_unref (transport);
+    return;
+  }
+
+  /* The I/O thread owns the remaining sources, which dispatch once more
+   * after cancellation and drop their references. */
+  g_source_destroy (transport->inbox_source);
+  transport_unref (transport);
+}
 
 static void
 set_property (GObject      *object,
@@ -93,6 +1661,24 @@ set_property (GObject      *object,
     case PROP_FLAGS:
       connection->flags = g_value_get_flags (value);
       break;
+    case PROP_MAX_DELAYED_FRAMES:
+      connection->max_delayed_frames = g_value_get_uint (value);
+      break;
+    case PROP_MAX_DELAYED_BYTES:
+      connection->max_delayed_bytes = g_value_get_uint (value);
+      break;
+    case PROP_MAX_IN_FLIGHT:
+      garil_connection_set_max_in_flight (connection,
+                                          g_value_get_uint (value));
+      break;
+    case PROP_COALESCING_WINDOW:
+      garil_connection_set_coalescing_window (connection,
+                                              g_value_get_uint (value));
+      break;
+    case PROP_REQUEST_TIMEOUT:
+      garil_connection_set_request_timeout (connection,
+                                            g_value_get_uint (value));
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -117,12 +1703,59 @@ get_property (GObject    *object,
     case PROP_FLAGS:
       g_value_set_flags (value, garil_connection_get_flags (connection));
       break;
+    case PROP_MAX_DELAYED_FRAMES:
+      g_value_set_uint (value,
+                        garil_connection_get_max_delayed_frames (connection));
+      break;
+    case PROP_MAX_DELAYED_BYTES:
+      g_value_set_uint (value,
+                        garil_connection_get_max_delayed_bytes (connection));
+      break;
+    case PROP_MAX_IN_FLIGHT:
+      g_value_set_uint (value, garil_connection_get_max_in_flight (connection));
+      break;
+    case PROP_COALESCING_WINDOW:
+      g_value_set_uint (value,
+                        garil_connection_get_coalescing_window (connection));
+      break;
+    case PROP_REQUEST_TIMEOUT:
+      g_value_set_uint (value,
+                        garil_connection_get_request_timeout (connection));
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
   }
 }
 
+static void
+dispose (GObject *object)
+{
+  GarilConnection *connection = GARIL_CONNECTION (object);
+
+  stop_transport (connection);
+
+  /* Only reachable through g_object_run_dispose(), as requests hold a
+   * reference to the connection. */
+  if (_garil_pending_table_get_size (connection->pending) ||
+      connection->n_waiting) {
+    GError *error = g_error_new_literal (G_IO_ERROR, G_IO_ERROR_CLOSED,
+                                         "Connection closed");
+    fail_requests (connection, error);
+    g_error_free (error);
+  }
+
+  GHashTableIter iter;
+  gpointer value;
+  g_hash_table_iter_init (&iter, connection->subscriptions);
+  while (g_hash_table_iter_next (&iter, NULL, &value)) {
+    g_hash_table_iter_remove (&iter);
+    remove_subscription (connection, value);
+  }
+
+  G_OBJECT_CLASS (garil_connection_parent_class)->dispose (object);
+}
+
 static void
 finalize (GObject *object)
 {
@@ -143,7 +1776,27 @@ finalize (GObject *object)
     connection->init_error = NULL;
   }
 
+  clear_source (&connection->timeout_source);
+  _garil_timer_wheel_free (connection->timers);
+
+  for (guint i = 0; i < connection->n_unsolicited; i++) {
+    Coalescer *coalescer = connection->unsolicited[i].coalescer;
+    if (coalescer == NULL)
+      continue;
+    if (coalescer->frame != NULL)
+      garil_parcel_unref (coalescer->frame);
+    g_slice_free (Coalescer, coalescer);
+  }
+  if (connection->deliveries != NULL) {
+    clear_source (&connection->delivery_source);
+    _garil_timer_wheel_free (connection->deliveries);
+  }
+  g_free (connection->unsolicited);
+  g_hash_table_unref (connection->subscriptions);
+  _garil_pending_table_free (connection->pending);
+  g_cond_clear (&connection->init_cond);
   g_mutex_clear (&connection->init_lock);
+  g_main_context_unref (connection->context);
 
   G_OBJECT_CLASS (garil_connection_parent_class)->finalize (object);
 }
@@ -157,6 +1810,7 @@ garil_connection_class_init (GarilConnectionClass *klass)
 
   object_class->set_property = set_property;
   object_class->get_property = get_property;
+  object_class->dispose = dispose;
   object_class->finalize = finalize;
 
   /* properties */
@@ -207,6 +1861,87 @@ garil_connection_class_init (GarilConnectionClass *klass)
                            G_PARAM_READWRITE | \
                            G_PARAM_STATIC_STRINGS);
 
+  /**
+   * GarilConnection:max-in-flight:
+   *
+   * Maximum number of requests sent and still awaiting their responses, or 0
+   * for no limit. Requests beyond that wait to be sent by priority.
+   */
+  props[PROP_MAX_IN_FLIGHT] =
+    g_param_spec_uint (GARIL_CONNECTION_PROP_MAX_IN_FLIGHT,
+                       "Max in flight",
+                       "Maximum number of requests awaiting responses",
+                       0, G_MAXINT32, 0,
+                       G_PARAM_READWRITE | \
+                         G_PARAM_EXPLICIT_NOTIFY | \
+                         G_PARAM_STATIC_STRINGS);
+
+  /**
+   * GarilConnection:coalescing-window:
+   *
+   * Time in microseconds to hold back the first queued frame, so that frames
+   * queued shortly after it are written with the same system call. With the
+   * default of 0, frames queued before the I/O context runs again are still
+   * written together.
+   */
+  props[PROP_COALESCING_WINDOW] =
+    g_param_spec_uint (GARIL_CONNECTION_PROP_COALESCING_WINDOW,
+                       "Coalescing window",
+                       "Microseconds to wait for more frames to write at once",
+                       0, MAX_COALESCING_WINDOW, 0,
+                       G_PARAM_READWRITE | \
+                         G_PARAM_EXPLICIT_NOTIFY | \
+                         G_PARAM_STATIC_STRINGS);
+
+  /**
+   * GarilConnection:request-timeout:
+   *
+   * Time in milliseconds a request may take from
+   * garil_connection_send_request() until its response arrives, before it
+   * fails with %G_IO_ERROR_TIMED_OUT, or 0 for no limit. Time spent waiting
+   * to be sent counts.
+   */
+  props[PROP_REQUEST_TIMEOUT] =
+    g_param_spec_uint (GARIL_CONNECTION_PROP_REQUEST_TIMEOUT,
+                       "Request timeout",
+                       "Milliseconds to wait for a response",
+                       0, G_MAXUINT, 0,
+                       G_PARAM_READWRITE | \
+                         G_PARAM_EXPLICIT_NOTIFY | \
+                         G_PARAM_STATIC_STRINGS);
+
+  /**
+   * GarilConnection:max-delayed-frames:
+   *
+   * Number of frames received before
+   * garil_connection_start_message_processing() at which reading pauses.
+   * Only used with %GARIL_CONNECTION_FLAGS_DELAY_MESSAGE_PROCESSING.
+   */
+  props[PROP_MAX_DELAYED_FRAMES] =
+    g_param_spec_uint (GARIL_CONNECTION_PROP_MAX_DELAYED_FRAMES,
+                       "Max delayed frames",
+                       "Frames to keep until message processing starts",
+                       1, G_MAXUINT, DEFAULT_MAX_DELAYED_FRAMES,
+                       G_PARAM_CONSTRUCT_ONLY | \
+                         G_PARAM_READWRITE | \
+                         G_PARAM_STATIC_STRINGS);
+
+  /**
+   * GarilConnection:max-delayed-bytes:
+   *
+   * Total size in bytes of the frames received before
+   * garil_connection_start_message_processing() at which reading pauses.
+   * Only used with %GARIL_CONNECTION_FLAGS_DELAY_MESSAGE_PROCESSING.
+   */
+  props[PROP_MAX_DELAYED_BYTES] =
+    g_param_spec_uint (GARIL_CONNECTION_PROP_MAX_DELAYED_BYTES,
+                       "Max delayed bytes",
+                       "Bytes to keep until message processing starts",
+                       1, G_MAXUINT, DEFAULT_MAX_DELAYED_BYTES,
+                       G_PARAM_CONSTRUCT_ONLY | \
+                         G_PARAM_READWRITE | \
+                         G_PARAM_STATIC_STRINGS);
+
   g_object_class_install_properties (object_class, N_PROPERTIES, props);
 }
 
@@ -214,6 +1949,36 @@ static void
 garil_connection_init (GarilConnection *connection)
 {
   g_mutex_init (&connection->init_lock);
+  g_cond_init (&connection->init_cond);
+  connection->context = g_main_context_ref_thread_default ();
+  connection->pending = _garil_pending_table_new (0);
+  for (guint i = 0; i < N_PRIORITIES; i++)
+    g_queue_init (&connection->waiting[i]);
+
+  connection->timers = _garil_timer_wheel_new (g_get_monotonic_time ());
+  connection->timeout_source =
+    g_source_new (&ready_source_funcs, sizeof (GSource));
+  g_source_set_callback (connection->timeout_source, on_request_timeout,
+                         connection, NULL);
+  g_source_attach (connection->timeout_source, connection->context);
+
+  connection->subscriptions = g_hash_table_new (NULL, NULL);
+}
+
+/* Put a connected socket into non-blocking mode and start I/O on the stream.
+ * Called with init_lock held. */
+static void
+start_stream (GarilConnection *connection)
+{
+  if (G_IS_SOCKET_CONNECTION (connection->stream)) {
+    GSocketConnection *socket_connection;
+
+    socket_connection = G_SOCKET_CONNECTION (connection->stream);
+    g_socket_set_blocking (g_socket_connection_get_socket (socket_connection),
+                           FALSE);
+  }
+
+  start_transport (connection);
 }
 
 static gboolean
@@ -226,6 +1991,10 @@ initable_init (GInitable     *initable,
 
   g_mutex_lock (&connection->init_lock);
 
+  /* An asynchronous initialization may be connecting without the lock */
+  while (connection->init_tasks != NULL)
+    g_cond_wait (&connection->init_cond, &connection->init_lock);
+
   if (g_atomic_int_get (&connection->atom_flags) & FLAG_INITIALIZED) {
     ret = (connection->init_error == NULL);
     goto out;
@@ -260,38 +2029,159 @@ initable_init (GInitable     *initable,
     g_assert_not_reached ();
   }
 
-  if (G_IS_SOCKET_CONNECTION (connection->stream)) {
-    GSocketConnection *socket_connection;
+  start_stream (connection);
+
+  ret = TRUE;
+
+out:
+  if (!ret) {
+    g_assert (connection->init_error != NULL);
+    g_propagate_error (error, g_error_copy (connection->init_error));
+  }
+
+  g_atomic_int_or (&connection->atom_flags, FLAG_INITIALIZED);
+  g_mutex_unlock (&connection->init_lock);
+
+  return ret;
+}
+
+static void
+initable_iface_init (GInitableIface *initable_iface)
+{
+  initable_iface->init = initable_init;
+}
+
+static void
+return_init_result (GarilConnection *connection,
+                    GTask           *task)
+{
+  if (connection->init_error != NULL)
+    g_task_return_error (task, g_error_copy (connection->init_error));
+  else
+    g_task_return_boolean (task, TRUE);
+}
+
+/* Finish an asynchronous initialization with either socket_connection or
+ * error, and complete every task that joined it while connecting. */
+static void
+complete_init (GarilConnection   *connection,
+               GSocketConnection *socket_connection,
+               GError            *error)
+{
+  g_mutex_lock (&connection->init_lock);
+
+  g_assert (connection->init_tasks != NULL);
+  g_assert (connection->init_error == NULL);
+
+  if (error != NULL) {
+    connection->init_error = error;
+  } else {
+    if (socket_connection != NULL) {
+      g_assert (connection->stream == NULL);
+      connection->stream = G_IO_STREAM (socket_connection);
+    }
+    start_stream (connection);
+  }
+
+  GSList *tasks = connection->init_tasks;
+  connection->init_tasks = NULL;
+
+  g_atomic_int_or (&connection->atom_flags, FLAG_INITIALIZED);
+  g_cond_broadcast (&connection->init_cond);
+  g_mutex_unlock (&connection->init_lock);
+
+  /* Complete tasks in the order initialization was requested */
+  tasks = g_slist_reverse (tasks);
+  for (GSList *l = tasks; l != NULL; l = l->next) {
+    GTask *task = l->data;
+    return_init_result (connection, task);
+    g_object_unref (task);
+  }
+  g_slist_free (tasks);
+}
+
+static void
+on_init_connected (GObject      *source_object,
+                   GAsyncResult *res,
+                   gpointer      user_data)
+{
+  GarilConnection *connection = user_data;
+  GError *error = NULL;
+
+  GSocketConnection *socket_connection =
+    g_socket_client_connect_finish (G_SOCKET_CLIENT (source_object), res,
+                                    &error);
+  complete_init (connection, socket_connection, error);
+
+  g_object_unref (connection);
+}
+
+/* Connect with g_socket_client_connect_async() rather than running the
+ * blocking initable_init() in a worker thread, so that many connections can
+ * be set up at once without occupying the shared thread pool. Concurrent
+ * calls join the initialization already in progress. */
+static void
+async_initable_init_async (GAsyncInitable      *initable,
+                           int                  io_priority,
+                           GCancellable        *cancellable,
+                           GAsyncReadyCallback  callback,
+                           gpointer             user_data)
+{
+  GarilConnection *connection = GARIL_CONNECTION (initable);
 
-    socket_connection = G_SOCKET_CONNECTION (connection->stream);
-    g_socket_set_blocking (g_socket_connection_get_socket (socket_connection),
-                           FALSE);
-  }
+  GTask *task = g_task_new (connection, cancellable, callback, user_data);
+  g_task_set_source_tag (task, async_initable_init_async);
+  g_task_set_priority (task, io_priority);
 
-  ret = TRUE;
+  g_mutex_lock (&connection->init_lock);
 
-out:
-  if (!ret) {
-    g_assert (connection->init_error != NULL);
-    g_propagate_error (error, g_error_copy (connection->init_error));
+  if (g_atomic_int_get (&connection->atom_flags) & FLAG_INITIALIZED) {
+    g_mutex_unlock (&connection->init_lock);
+    return_init_result (connection, task);
+    g_object_unref (task);
+    return;
   }
 
-  g_atomic_int_or (&connection->atom_flags, FLAG_INITIALIZED);
+  const gboolean connecting = (connection->init_tasks != NULL);
+  connection->init_tasks = g_slist_prepend (connection->init_tasks, task);
+
   g_mutex_unlock (&connection->init_lock);
 
-  return ret;
+  if (connecting)
+    return;
+
+  GError *error = NULL;
+  if (g_cancellable_set_error_if_cancelled (cancellable, &error)) {
+    complete_init (connection, NULL, error);
+  } else if (connection->address != NULL) {
+    GSocketClient *socket_client = g_socket_client_new ();
+
+    g_socket_client_connect_async (socket_client,
+                                   G_SOCKET_CONNECTABLE (connection->address),
+                                   cancellable, on_init_connected,
+                                   g_object_ref (connection));
+    g_object_unref (socket_client);
+  } else {
+    g_assert (connection->stream != NULL);
+    complete_init (connection, NULL, NULL);
+  }
 }
 
-static void
-initable_iface_init (GInitableIface *initable_iface)
+static gboolean
+async_initable_init_finish (GAsyncInitable  *initable,
+                            GAsyncResult    *res,
+                            GError         **error)
 {
-  initable_iface->init = initable_init;
+  g_return_val_if_fail (g_task_is_valid (res, initable), FALSE);
+
+  return g_task_propagate_boolean (G_TASK (res), error);
 }
 
 static void
-async_initable_iface_init (GAsyncInitableIface *async_initable_iface G_GNUC_UNUSED)
+async_initable_iface_init (GAsyncInitableIface *async_initable_iface)
 {
-  /* use default */
+  async_initable_iface->init_async = async_initable_init_async;
+  async_initable_iface->init_finish = async_initable_init_finish;
 }
 
 /**
@@ -483,6 +2373,207 @@ garil_connection_new_for_address_sync (GSocketAddress        *address,
                          NULL);
 }
 
+typedef struct {
+  GSocketAddress **addresses;
+  guint n_addresses;
+  guint max_parallel;
+  GarilConnectionFlags flags;
+  GarilConnectionReadyCallback ready_callback;
+  gpointer ready_data;
+
+  guint n_started;
+  guint n_running;
+  gint64 started;
+  gint64 latency_sum;
+  GarilConnectionStats stats;
+} Batch;
+
+typedef struct {
+  GTask *task;
+  guint index;
+  gint64 started;
+} Attempt;
+
+static void
+batch_free (Batch *batch)
+{
+  for (guint i = 0; i < batch->n_addresses; i++)
+    g_object_unref (batch->addresses[i]);
+  g_free (batch->addresses);
+  g_slice_free (Batch, batch);
+}
+
+static void start_attempts (GTask *task);
+
+static void
+on_attempt_ready (GObject      *source_object G_GNUC_UNUSED,
+                  GAsyncResult *res,
+                  gpointer      user_data)
+{
+  Attempt *attempt = user_data;
+  GTask *task = attempt->task;
+  Batch *batch = g_task_get_task_data (task);
+  GError *error = NULL;
+
+  GarilConnection *connection =
+    garil_connection_new_for_address_finish (res, &error);
+
+  const gint64 now = g_get_monotonic_time ();
+  const gint64 latency = now - attempt->started;
+  GarilConnectionStats *stats = &batch->stats;
+  if (stats->n_connected + stats->n_failed == 0) {
+    stats->min_latency = latency;
+    stats->max_latency = latency;
+  } else {
+    stats->min_latency = MIN (stats->min_latency, latency);
+    stats->max_latency = MAX (stats->max_latency, latency);
+  }
+  batch->latency_sum += latency;
+  if (connection != NULL)
+    stats->n_connected++;
+  else
+    stats->n_failed++;
+
+  batch->n_running--;
+
+  if (batch->ready_callback != NULL)
+    batch->ready_callback (connection, batch->addresses[attempt->index],
+                           attempt->index, error, batch->ready_data);
+
+  g_clear_object (&connection);
+  g_clear_error (&error);
+  g_slice_free (Attempt, attempt);
+
+  start_attempts (task);
+  g_object_unref (task);
+}
+
+/* Start connecting to the next addresses, up to max_parallel at a time, and
+ * complete the batch once every attempt finished. */
+static void
+start_attempts (GTask *task)
+{
+  Batch *batch = g_task_get_task_data (task);
+  GarilConnectionStats *stats = &batch->stats;
+
+  while ((batch->n_started < batch->n_addresses) &&
+         ((batch->max_parallel == 0) ||
+          (batch->n_running < batch->max_parallel))) {
+    Attempt *attempt = g_slice_new (Attempt);
+    attempt->task = g_object_ref (task);
+    attempt->index = batch->n_started++;
+    attempt->started = g_get_monotonic_time ();
+    batch->n_running++;
+
+    garil_connection_new_for_address (batch->addresses[attempt->index],
+                                      batch->flags,
+                                      g_task_get_cancellable (task),
+                                      on_attempt_ready, attempt);
+  }
+
+  if (batch->n_running > 0)
+    return;
+
+  stats->elapsed = g_get_monotonic_time () - batch->started;
+  if (batch->n_addresses > 0)
+    stats->mean_latency = batch->latency_sum / batch->n_addresses;
+
+  if (!g_task_return_error_if_cancelled (task))
+    g_task_return_boolean (task, TRUE);
+}
+
+/**
+ * garil_connection_new_for_addresses:
+ * @addresses: (array length=n_addresses): The #GSocketAddress of each
+ *   endpoint.
+ * @n_addresses: The number of addresses.
+ * @max_parallel: The maximum number of connections set up at the same time,
+ *   or 0 for no limit.
+ * @flags: Flags describing how to make the connections.
+ * @cancellable: (nullable): A #GCancellable or %NULL.
+ * @ready_callback: (nullable): A #GarilConnectionReadyCallback to call as
+ *   each connection finishes.
+ * @ready_data: (nullable): The data to pass to the @ready_callback.
+ * @callback: A #GAsyncReadyCallback to call when every connection finished.
+ * @user_data: (nullable): The data to pass to the @callback.
+ *
+ * Asynchronously sets up RIL connections to many endpoints at once, as with
+ * #garil_connection_new_for_address() for each address, but starting at most
+ * max_parallel of them at a time.
+ *
+ * The result of each connection is passed to ready_callback as soon as it
+ * finishes, in no particular order. A failed connection doesn't stop the
+ * others.
+ *
+ * When every connection finished, callback will be invoked. You can then call
+ * #garil_connection_new_for_addresses_finish() to get the timing of the
+ * batch.
+ */
+void
+garil_connection_new_for_addresses (GSocketAddress * const       *addresses,
+                                    guint                         n_addresses,
+                                    guint                         max_parallel,
+                                    GarilConnectionFlags          flags,
+                                    GCancellable                 *cancellable,
+                                    GarilConnectionReadyCallback  ready_callback,
+                                    gpointer                      ready_data,
+                                    GAsyncReadyCallback           callback,
+                                    gpointer                      user_data)
+{
+  g_return_if_fail (addresses != NULL || n_addresses == 0);
+  for (guint i = 0; i < n_addresses; i++)
+    g_return_if_fail (G_IS_SOCKET_ADDRESS (addresses[i]));
+
+  Batch *batch = g_slice_new0 (Batch);
+  batch->addresses = g_new (GSocketAddress*, n_addresses);
+  for (guint i = 0; i < n_addresses; i++)
+    batch->addresses[i] = g_object_ref (addresses[i]);
+  batch->n_addresses = n_addresses;
+  batch->max_parallel = max_parallel;
+  batch->flags = flags;
+  batch->ready_callback = ready_callback;
+  batch->ready_data = ready_data;
+  batch->started = g_get_monotonic_time ();
+
+  GTask *task = g_task_new (NULL, cancellable, callback, user_data);
+  g_task_set_source_tag (task, garil_connection_new_for_addresses);
+  g_task_set_task_data (task, batch, (GDestroyNotify)batch_free);
+
+  start_attempts (task);
+  g_object_unref (task);
+}
+
+/**
+ * garil_connection_new_for_addresses_finish:
+ * @res: A #GAsyncResult obtained from the #GAsyncReadyCallback passed to
+ *   #garil_connection_new_for_addresses().
+ * @stats: (out caller-allocates) (optional): Return location for the timing
+ *   of the batch, or %NULL.
+ * @error: (out) (nullable): Return location for error or %NULL.
+ *
+ * Finishes an operation started with #garil_connection_new_for_addresses().
+ * The connections that failed were reported to its ready_callback, so this
+ * only fails if the batch was cancelled. stats is set either way.
+ *
+ * Returns: %TRUE, or %FALSE if error is set.
+ */
+gboolean
+garil_connection_new_for_addresses_finish (GAsyncResult          *res,
+                                           GarilConnectionStats  *stats,
+                                           GError               **error)
+{
+  g_return_val_if_fail (g_task_is_valid (res, NULL), FALSE);
+  g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
+
+  GTask *task = G_TASK (res);
+  if (stats != NULL) {
+    const Batch *batch = g_task_get_task_data (task);
+    *stats = batch->stats;
+  }
+
+  return g_task_propagate_boolean (task, error);
+}
+
 /**
  * garil_connection_get_stream:
  * @connection: A #GarilConnection.
@@ -532,3 +2623,519 @@ garil_connection_get_flags (GarilConnection *connection)
 
   return connection->flags;
 }
+
+/**
+ * garil_connection_get_max_delayed_frames:
+ * @connection: A #GarilConnection.
+ *
+ * Get the number of frames kept before message processing starts.
+ *
+ * Returns: The value of #GarilConnection:max-delayed-frames.
+ */
+guint
+garil_connection_get_max_delayed_frames (GarilConnection *connection)
+{
+  g_return_val_if_fail (GARIL_IS_CONNECTION (connection), 0);
+
+  return connection->max_delayed_frames;
+}
+
+/**
+ * garil_connection_get_max_delayed_bytes:
+ * @connection: A #GarilConnection.
+ *
+ * Get the size of the frames kept before message processing starts.
+ *
+ * Returns: The value of #GarilConnection:max-delayed-bytes.
+ */
+guint
+garil_connection_get_max_delayed_bytes (GarilConnection *connection)
+{
+  g_return_val_if_fail (GARIL_IS_CONNECTION (connection), 0);
+
+  return connection->max_delayed_bytes;
+}
+
+/**
+ * garil_connection_start_message_processing:
+ * @connection: A #GarilConnection.
+ *
+ * If @connection was created with
+ * %GARIL_CONNECTION_FLAGS_DELAY_MESSAGE_PROCESSING, start processing
+ * messages. Does nothing if processing already started or if the flag was
+ * not set.
+ *
+ * The frames received meanwhile are handled together, in the order they
+ * arrived, the next time the main context runs, and reading resumes if it
+ * paused at #GarilConnection:max-delayed-frames or
+ * #GarilConnection:max-delayed-bytes. Subscribe to unsolicited responses
+ * first so that none are dropped.
+ *
+ * Must be called from the thread-default main context the connection was
+ * created in.
+ */
+void
+garil_connection_start_message_processing (GarilConnection *connection)
+{
+  g_return_if_fail (GARIL_IS_CONNECTION (connection));
+  g_return_if_fail (g_atomic_int_get (&connection->atom_flags) &
+                    FLAG_INITIALIZED);
+
+  Transport *transport = connection->transport;
+  if ((transport != NULL) && (transport->start_source != NULL))
+    g_source_set_ready_time (transport->start_source, 0);
+}
+
+/**
+ * garil_connection_get_max_in_flight:
+ * @connection: A #GarilConnection.
+ *
+ * Get the maximum number of requests sent ahead of their responses.
+ *
+ * Returns: The value of #GarilConnection:max-in-flight, 0 for no limit.
+ */
+guint
+garil_connection_get_max_in_flight (GarilConnection *connection)
+{
+  g_return_val_if_fail (GARIL_IS_CONNECTION (connection), 0);
+
+  return connection->max_in_flight;
+}
+
+/**
+ * garil_connection_set_max_in_flight:
+ * @connection: A #GarilConnection.
+ * @max_in_flight: Maximum number of requests, or 0 for no limit.
+ *
+ * Set the maximum number of requests sent ahead of their responses. Raising
+ * it sends waiting requests right away; lowering it lets requests already
+ * sent complete.
+ *
+ * Must be called from the thread-default main context the connection was
+ * created in.
+ */
+void
+garil_connection_set_max_in_flight (GarilConnection *connection,
+                                    guint            max_in_flight)
+{
+  g_return_if_fail (GARIL_IS_CONNECTION (connection));
+  g_return_if_fail (max_in_flight <= G_MAXINT32);
+
+  if (connection->max_in_flight == max_in_flight)
+    return;
+
+  connection->max_in_flight = max_in_flight;
+  send_waiting_requests (connection);
+
+  g_object_notify_by_pspec (G_OBJECT (connection), props[PROP_MAX_IN_FLIGHT]);
+}
+
+/**
+ * garil_connection_get_coalescing_window:
+ * @connection: A #GarilConnection.
+ *
+ * Get the time queued frames are held back to be written together.
+ *
+ * Returns: The value of #GarilConnection:coalescing-window in microseconds.
+ */
+guint
+garil_connection_get_coalescing_window (GarilConnection *connection)
+{
+  g_return_val_if_fail (GARIL_IS_CONNECTION (connection), 0);
+
+  return g_atomic_int_get (&connection->coalescing_window);
+}
+
+/**
+ * garil_connection_set_coalescing_window:
+ * @connection: A #GarilConnection.
+ * @window: Time in microseconds, at most one second.
+ *
+ * Set the time queued frames are held back to be written together. It takes
+ * effect from the next frame queued after a flush.
+ */
+void
+garil_connection_set_coalescing_window (GarilConnection *connection,
+                                        guint            window)
+{
+  g_return_if_fail (GARIL_IS_CONNECTION (connection));
+  g_return_if_fail (window <= MAX_COALESCING_WINDOW);
+
+  if ((guint) g_atomic_int_get (&connection->coalescing_window) == window)
+    return;
+
+  g_atomic_int_set (&connection->coalescing_window, window);
+  g_object_notify_by_pspec (G_OBJECT (connection),
+                            props[PROP_COALESCING_WINDOW]);
+}
+
+/**
+ * garil_connection_get_request_timeout:
+ * @connection: A #GarilConnection.
+ *
+ * Get the time requests are given to complete.
+ *
+ * Returns: The value of #GarilConnection:request-timeout in milliseconds, 0
+ *   for no limit.
+ */
+guint
+garil_connection_get_request_timeout (GarilConnection *connection)
+{
+  g_return_val_if_fail (GARIL_IS_CONNECTION (connection), 0);
+
+  return connection->request_timeout;
+}
+
+/**
+ * garil_connection_set_request_timeout:
+ * @connection: A #GarilConnection.
+ * @timeout: Time in milliseconds, or 0 for no limit.
+ *
+ * Set the time requests are given to complete. It applies to requests made
+ * afterwards.
+ *
+ * Must be called from the thread-default main context the connection was
+ * created in.
+ */
+void
+garil_connection_set_request_timeout (GarilConnection *connection,
+                                      guint            timeout)
+{
+  g_return_if_fail (GARIL_IS_CONNECTION (connection));
+
+  if (connection->request_timeout == timeout)
+    return;
+
+  connection->request_timeout = timeout;
+  g_object_notify_by_pspec (G_OBJECT (connection),
+                            props[PROP_REQUEST_TIMEOUT]);
+}
+
+/**
+ * garil_connection_send_parcel:
+ * @connection: A #GarilConnection.
+ * @parcel: A #GarilParcel holding a complete RIL message.
+ *
+ * Queue @parcel to be sent as one frame, prefixed with its length. The parcel
+ * is written straight from its own storage, so it must not be modified
+ * afterwards. Parcels created with garil_parcel_new_segmented() are written
+ * without being flattened first.
+ *
+ * Frames queued close together are written with a single vectored system
+ * call, see #GarilConnection:coalescing-window. Nothing is reported back; a
+ * write error closes the connection.
+ *
+ * Must be called from the thread-default main context the connection was
+ * created in.
+ */
+void
+garil_connection_send_parcel (GarilConnection *connection,
+                              GarilParcel     *parcel)
+{
+  g_return_if_fail (GARIL_IS_CONNECTION (connection));
+  g_return_if_fail ((parcel != NULL) && !garil_parcel_is_measure (parcel) &&
+                    (garil_parcel_get_size (parcel) <= G_MAXUINT32));
+  g_return_if_fail (g_atomic_int_get (&connection->atom_flags) &
+                    FLAG_INITIALIZED);
+
+  if ((connection->transport == NULL) ||
+      (g_atomic_int_get (&connection->atom_flags) & FLAG_CLOSED))
+    return;
+
+  transport_send (connection->transport, out_frame_new (parcel, NULL, 0));
+}
+
+/**
+ * garil_connection_send_request:
+ * @connection: A #GarilConnection.
+ * @request: The RIL request code, one of RIL_REQUEST_*.
+ * @payload: (nullable): A #GarilParcel holding the request parameters, or
+ *   %NULL if there are none.
+ * @priority: The #GarilRequestPriority of the request.
+ * @cancellable: (nullable): A #GCancellable or %NULL.
+ * @callback: A #GAsyncReadyCallback to call when the response arrived.
+ * @user_data: (nullable): The data to pass to the @callback.
+ *
+ * Send a RIL request and asynchronously wait for its solicited response. A
+ * serial number is allocated for the request and written between @request
+ * and @payload; @payload is written straight from its own storage, so it must
+ * not be modified afterwards.
+ *
+ * If #GarilConnection:max-in-flight requests are already awaiting responses,
+ * the request waits to be sent until enough of them complete. Waiting
+ * requests are sent by @priority, and in the order they were made within the
+ * same priority. Priorities have no effect while the window isn't full.
+ * Requests not completed within #GarilConnection:request-timeout fail with
+ * %G_IO_ERROR_TIMED_OUT.
+ *
+ * When the response arrives, @callback will be invoked. You can then call
+ * garil_connection_send_request_finish() to get the response. If the
+ * connection is closed before, the request fails with the error that closed
+ * it. Cancelling only stops waiting; the request may still have been sent.
+ *
+ * Must be called from the thread-default main context the connection was
+ * created in.
+ */
+void
+garil_connection_send_request (GarilConnection      *connection,
+                               gint32                request,
+                               GarilParcel          *payload,
+                               GarilRequestPriority  priority,
+                               GCancellable         *cancellable,
+                               GAsyncReadyCallback   callback,
+                               gpointer              user_data)
+{
+  g_return_if_fail (GARIL_IS_CONNECTION (connection));
+  g_return_if_fail ((guint) priority < N_PRIORITIES);
+  g_return_if_fail ((payload == NULL) ||
+                    (!garil_parcel_is_measure (payload) &&
+                     (garil_parcel_get_size (payload) <=
+                        (G_MAXUINT32 - 2 * sizeof (guint32)))));
+  g_return_if_fail (g_atomic_int_get (&connection->atom_flags) &
+                    FLAG_INITIALIZED);
+
+  GTask *task = g_task_new (connection, cancellable, callback, user_data);
+  g_task_set_source_tag (task, garil_connection_send_request);
+
+  Request *state = g_slice_new0 (Request);
+  state->code = request;
+  state->priority = priority;
+  state->payload = (payload != NULL) ? garil_parcel_ref (payload) : NULL;
+  state->link.data = task;
+  g_task_set_task_data (task, state, (GDestroyNotify) request_free);
+
+  if ((connection->transport == NULL) ||
+      (g_atomic_int_get (&connection->atom_flags) & FLAG_CLOSED)) {
+    g_task_return_new_error (task, G_IO_ERROR, G_IO_ERROR_CLOSED,
+                             "Connection closed");
+    g_object_unref (task);
+    return;
+  }
+
+  if (g_task_return_error_if_cancelled (task)) {
+    g_object_unref (task);
+    return;
+  }
+
+  if (cancellable != NULL) {
+    state->cancel_source = g_cancellable_source_new (cancellable);
+    g_source_set_callback (state->cancel_source,
+                           (GSourceFunc) on_request_cancelled,
+                           g_object_ref (task), g_object_unref);
+    g_source_attach (state->cancel_source, connection->context);
+  }
+
+  if (connection->request_timeout)
+    arm_request (connection, task);
+
+  /* Requests only wait while the window is full. */
+  if ((connection->n_waiting == 0) && can_send_request (connection))
+    send_request (connection, task);
+  else
+    queue_request (connection, task);
+}
+
+/**
+ * garil_connection_send_request_finish:
+ * @connection: A #GarilConnection.
+ * @res: A #GAsyncResult obtained from the #GAsyncReadyCallback passed to
+ *   garil_connection_send_request().
+ * @ril_error: (out) (optional): Return location for the RIL error code of the
+ *   response, 0 for RIL_E_SUCCESS.
+ * @error: (out) (nullable): Return location for error or %NULL.
+ *
+ * Finishes an operation started with garil_connection_send_request().
+ *
+ * A response carrying a RIL error code is still returned, as some responses
+ * have a payload describing the failure.
+ *
+ * Returns: (transfer full): A read-only #GarilParcel positioned at the
+ *   response payload, or %NULL if @error is set. Free with
+ *   garil_parcel_unref().
+ */
+GarilParcel*
+garil_connection_send_request_finish (GarilConnection  *connection,
+                                      GAsyncResult     *res,
+                                      gint32           *ril_error,
+                                      GError          **error)
+{
+  g_return_val_if_fail (GARIL_IS_CONNECTION (connection), NULL);
+  g_return_val_if_fail (g_task_is_valid (res, connection), NULL);
+  g_return_val_if_fail (g_task_get_source_tag (G_TASK (res)) ==
+                          garil_connection_send_request, NULL);
+  g_return_val_if_fail (error == NULL || *error == NULL, NULL);
+
+  GarilParcel *response = g_task_propagate_pointer (G_TASK (res), error);
+  if ((response != NULL) && (ril_error != NULL)) {
+    const Request *state = g_task_get_task_data (G_TASK (res));
+    *ril_error = state->ril_error;
+  }
+
+  return response;
+}
+
+/**
+ * garil_connection_unsolicited_subscribe:
+ * @connection: A #GarilConnection.
+ * @code: The RIL unsolicited response code, one of RIL_UNSOL_*.
+ * @callback: Function to call for every unsolicited response with @code.
+ * @user_data: (nullable): The data to pass to @callback.
+ * @user_data_free_func: (nullable): Function to free @user_data with when
+ *   unsubscribing, or %NULL.
+ *
+ * Subscribe to unsolicited responses with @code. The payload of a response
+ * is only looked at by its subscribers; responses nobody subscribed to are
+ * dropped right after their code is read. Several subscriptions to the same
+ * code are called in the order they were made.
+ *
+ * @callback is invoked in the thread-default main context the connection was
+ * created in, which this must be called from too. It may subscribe and
+ * unsubscribe.
+ *
+ * Returns: A subscription identifier that can be used with
+ *   garil_connection_unsolicited_unsubscribe(), never 0.
+ */
+guint
+garil_connection_unsolicited_subscribe (GarilConnection          *connection,
+                                        gint32                    code,
+                                        GarilUnsolicitedCallback  callback,
+                                        gpointer                  user_data,
+                                        GDestroyNotify            user_data_free_func)
+{
+  g_return_val_if_fail (GARIL_IS_CONNECTION (connection), 0);
+  g_return_val_if_fail ((code >= UNSOLICITED_BASE) &&
+                        (code < (UNSOLICITED_BASE + N_UNSOLICITED_CODES)), 0);
+  g_return_val_if_fail (callback != NULL, 0);
+
+  Subscribers *subscribers = ensure_subscribers (connection, code);
+
+  Subscription *subscription = g_slice_new0 (Subscription);
+  do {
+    subscription->id = ++connection->last_subscription_id;
+  } while ((subscription->id == 0) ||
+           g_hash_table_contains (connection->subscriptions,
+                                  GUINT_TO_POINTER (subscription->id)));
+  subscription->code = code;
+  subscription->callback = callback;
+  subscription->user_data = user_data;
+  subscription->user_data_free_func = user_data_free_func;
+
+  if (subscribers->tail != NULL)
+    subscribers->tail->next = subscription;
+  else
+    subscribers->head = subscription;
+  subscribers->tail = subscription;
+
+  g_hash_table_insert (connection->subscriptions,
+                       GUINT_TO_POINTER (subscription->id), subscription);
+
+  return subscription->id;
+}
+
+/**
+ * garil_connection_unsolicited_unsubscribe:
+ * @connection: A #GarilConnection.
+ * @subscription_id: A subscription identifier obtained from
+ *   garil_connection_unsolicited_subscribe().
+ *
+ * Unsubscribe from unsolicited responses. The callback of the subscription is
+ * not invoked anymore, even for a response being dispatched. Its user data is
+ * freed right away, or once the dispatch is over if called from a callback.
+ *
+ * Must be called from the thread-default main context the connection was
+ * created in.
+ */
+void
+garil_connection_unsolicited_unsubscribe (GarilConnection *connection,
+                                          guint            subscription_id)
+{
+  g_return_if_fail (GARIL_IS_CONNECTION (connection));
+
+  Subscription *subscription =
+    g_hash_table_lookup (connection->subscriptions,
+                         GUINT_TO_POINTER (subscription_id));
+  g_return_if_fail (subscription != NULL);
+
+  g_hash_table_remove (connection->subscriptions,
+                       GUINT_TO_POINTER (subscription_id));
+  remove_subscription (connection, subscription);
+}
+
+/**
+ * garil_connection_set_unsolicited_policy:
+ * @connection: A #GarilConnection.
+ * @code: The RIL unsolicited response code, one of RIL_UNSOL_*.
+ * @policy: A #GarilUnsolicitedPolicy.
+ * @window: Length of the coalescing window in milliseconds. Ignored with
+ *   %GARIL_UNSOLICITED_POLICY_DELIVER_ALL.
+ *
+ * Set how unsolicited responses with @code are delivered to their
+ * subscribers. The window starts with the first response held back, and all
+ * responses arriving until it ends are delivered together at its end, so
+ * subscribers are called at most once per window. With a @window of 0, the
+ * responses received in one go are coalesced.
+ *
+ * Responses already held back are still delivered at the end of their
+ * window. Within a #GarilUnsolicitedCallback, the number of responses
+ * coalesced into the call is available from
+ * garil_connection_get_unsolicited_count().
+ *
+ * Must be called from the thread-default main context the connection was
+ * created in.
+ */
+void
+garil_connection_set_unsolicited_policy (GarilConnection        *connection,
+                                         gint32                  code,
+                                         GarilUnsolicitedPolicy  policy,
+                                         guint                   window)
+{
+  g_return_if_fail (GARIL_IS_CONNECTION (connection));
+  g_return_if_fail ((code >= UNSOLICITED_BASE) &&
+                    (code < (UNSOLICITED_BASE + N_UNSOLICITED_CODES)));
+  g_return_if_fail ((policy == GARIL_UNSOLICITED_POLICY_DELIVER_ALL) ||
+                    (policy == GARIL_UNSOLICITED_POLICY_LATEST) ||
+                    (policy == GARIL_UNSOLICITED_POLICY_COUNT));
+
+  Subscribers *subscribers = ensure_subscribers (connection, code);
+  Coalescer *coalescer = subscribers->coalescer;
+  if (coalescer == NULL) {
+    if (policy == GARIL_UNSOLICITED_POLICY_DELIVER_ALL)
+      return;
+
+    coalescer = g_slice_new0 (Coalescer);
+    coalescer->code = code;
+    coalescer->timer.data = coalescer;
+    subscribers->coalescer = coalescer;
+  }
+
+  if (connection->deliveries == NULL) {
+    connection->deliveries = _garil_timer_wheel_new (g_get_monotonic_time ());
+    connection->delivery_source =
+      g_source_new (&ready_source_funcs, sizeof (GSource));
+    g_source_set_callback (connection->delivery_source, on_delivery,
+                           connection, NULL);
+    g_source_attach (connection->delivery_source, connection->context);
+  }
+
+  coalescer->policy = policy;
+  coalescer->window = window;
+}
+
+/**
+ * garil_connection_get_unsolicited_count:
+ * @connection: A #GarilConnection.
+ *
+ * Get the number of unsolicited responses delivered by the call of the
+ * #GarilUnsolicitedCallback in progress, i.e. 1 unless they were coalesced.
+ * See garil_connection_set_unsolicited_policy().
+ *
+ * Returns: The number of responses, or 0 outside of a
+ *   #GarilUnsolicitedCallback.
+ */
+guint
+garil_connection_get_unsolicited_count (GarilConnection *connection)
+{
+  g_return_val_if_fail (GARIL_IS_CONNECTION (connection), 0);
+
+  return connection->dispatch_count;
+}
@@ -25,6 +25,8 @@
 #include <glib-object.h>
 #include <gio/gio.h>
 
+#include <garil/garilparcel.h>
+
 G_BEGIN_DECLS
 
 /**
@@ -55,20 +57,147 @@ G_DECLARE_FINAL_TYPE (GarilConnection, garil_connection, GARIL, CONNECTION,
  * Property name for #GarilConnection:flags.
  */
 #define GARIL_CONNECTION_PROP_FLAGS "flags"
+/**
+ * GARIL_CONNECTION_PROP_MAX_IN_FLIGHT:
+ *
+ * Property name for #GarilConnection:max-in-flight.
+ */
+#define GARIL_CONNECTION_PROP_MAX_IN_FLIGHT "max-in-flight"
+/**
+ * GARIL_CONNECTION_PROP_COALESCING_WINDOW:
+ *
+ * Property name for #GarilConnection:coalescing-window.
+ */
+#define GARIL_CONNECTION_PROP_COALESCING_WINDOW "coalescing-window"
+/**
+ * GARIL_CONNECTION_PROP_REQUEST_TIMEOUT:
+ *
+ * Property name for #GarilConnection:request-timeout.
+ */
+#define GARIL_CONNECTION_PROP_REQUEST_TIMEOUT "request-timeout"
+/**
+ * GARIL_CONNECTION_PROP_MAX_DELAYED_FRAMES:
+ *
+ * Property name for #GarilConnection:max-delayed-frames.
+ */
+#define GARIL_CONNECTION_PROP_MAX_DELAYED_FRAMES "max-delayed-frames"
+/**
+ * GARIL_CONNECTION_PROP_MAX_DELAYED_BYTES:
+ *
+ * Property name for #GarilConnection:max-delayed-bytes.
+ */
+#define GARIL_CONNECTION_PROP_MAX_DELAYED_BYTES "max-delayed-bytes"
 
 /**
  * GarilConnectionFlags:
  * @GARIL_CONNECTION_FLAGS_NONE: No flag set.
  * @GARIL_CONNECTION_FLAGS_DELAY_MESSAGE_PROCESSING: Delay message processing
- *   until #garil_connection_start_message_processing() is called.
+ *   until garil_connection_start_message_processing() is called.
+ * @GARIL_CONNECTION_FLAGS_IO_THREAD: Read, decode and write frames in a
+ *   private thread, so that a busy main context doesn't hold up the socket.
  *
  * Flags used when creating a new #GarilConnection.
  */
 typedef enum {
   GARIL_CONNECTION_FLAGS_NONE = 0,
   GARIL_CONNECTION_FLAGS_DELAY_MESSAGE_PROCESSING = (1 << 0),
+  GARIL_CONNECTION_FLAGS_IO_THREAD = (1 << 1),
 } GarilConnectionFlags;
 
+/**
+ * GarilRequestPriority:
+ * @GARIL_REQUEST_PRIORITY_URGENT: Emergency calls and call control, e.g.
+ *   RIL_REQUEST_DIAL or RIL_REQUEST_HANGUP.
+ * @GARIL_REQUEST_PRIORITY_HIGH: SMS, e.g. RIL_REQUEST_SEND_SMS.
+ * @GARIL_REQUEST_PRIORITY_NORMAL: Data calls and anything else.
+ * @GARIL_REQUEST_PRIORITY_LOW: Periodic polling, e.g.
+ *   RIL_REQUEST_SIGNAL_STRENGTH or RIL_REQUEST_GET_CELL_INFO_LIST, and network
+ *   scans.
+ *
+ * Order in which requests waiting for #GarilConnection:max-in-flight are
+ * sent.
+ */
+typedef enum {
+  GARIL_REQUEST_PRIORITY_URGENT,
+  GARIL_REQUEST_PRIORITY_HIGH,
+  GARIL_REQUEST_PRIORITY_NORMAL,
+  GARIL_REQUEST_PRIORITY_LOW,
+} GarilRequestPriority;
+
+/**
+ * GarilUnsolicitedPolicy:
+ * @GARIL_UNSOLICITED_POLICY_DELIVER_ALL: Deliver every response as it
+ *   arrives.
+ * @GARIL_UNSOLICITED_POLICY_LATEST: Deliver only the latest response at the
+ *   end of the coalescing window. The ones it superseded are dropped.
+ * @GARIL_UNSOLICITED_POLICY_COUNT: Only count the responses. Subscribers are
+ *   called with a %NULL payload at the end of the coalescing window.
+ *
+ * How unsolicited responses with a code are delivered to the subscribers,
+ * see garil_connection_set_unsolicited_policy().
+ */
+typedef enum {
+  GARIL_UNSOLICITED_POLICY_DELIVER_ALL,
+  GARIL_UNSOLICITED_POLICY_LATEST,
+  GARIL_UNSOLICITED_POLICY_COUNT,
+} GarilUnsolicitedPolicy;
+
+/**
+ * GarilUnsolicitedCallback:
+ * @connection: The #GarilConnection the response arrived on.
+ * @code: The RIL unsolicited response code, one of RIL_UNSOL_*.
+ * @payload: (nullable): A read-only #GarilParcel positioned at the response
+ *   data, or %NULL with %GARIL_UNSOLICITED_POLICY_COUNT. Take a reference to
+ *   keep it beyond the callback.
+ * @user_data: The data passed to garil_connection_unsolicited_subscribe().
+ *
+ * Signature of the callback of garil_connection_unsolicited_subscribe().
+ */
+typedef void (*GarilUnsolicitedCallback) (GarilConnection *connection,
+                                          gint32           code,
+                                          GarilParcel     *payload,
+                                          gpointer         user_data);
+
+/**
+ * GarilConnectionStats:
+ * @n_connected: Number of addresses connected to.
+ * @n_failed: Number of addresses that failed to connect.
+ * @elapsed: Microseconds from the start of the batch until the last
+ *   connection finished.
+ * @min_latency: Microseconds of the fastest connection attempt.
+ * @max_latency: Microseconds of the slowest connection attempt.
+ * @mean_latency: Mean microseconds of a connection attempt.
+ *
+ * Timing of a garil_connection_new_for_addresses() batch. Latencies are
+ * measured from the start to the end of each attempt, including failed ones.
+ */
+typedef struct {
+  guint n_connected;
+  guint n_failed;
+  gint64 elapsed;
+  gint64 min_latency;
+  gint64 max_latency;
+  gint64 mean_latency;
+} GarilConnectionStats;
+
+/**
+ * GarilConnectionReadyCallback:
+ * @connection: (nullable): The new #GarilConnection, or %NULL if error is
+ *   set. Take a reference to keep it beyond the callback.
+ * @address: The #GSocketAddress connected to.
+ * @index: The index of address in the batch.
+ * @error: (nullable): Why connecting to address failed, or %NULL.
+ * @user_data: The data passed to garil_connection_new_for_addresses().
+ *
+ * Signature of the callback of garil_connection_new_for_addresses(), called
+ * as each connection finishes.
+ */
+typedef void (*GarilConnectionReadyCallback) (GarilConnection *connection,
+                                              GSocketAddress  *address,
+                                              guint            index,
+                                              const GError    *error,
+                                              gpointer         user_data);
+
 void garil_connection_new (GIOStream            *stream,
                            GarilConnectionFlags  flags,
                            GCancellable         *cancellable,
@@ -97,10 +226,69 @@ GarilConnection* garil_connection_new_for_address_sync (GSocketAddress        *a
                                                         GCancellable          *cancellable,
                                                         GError               **error);
 
+void garil_connection_new_for_addresses (GSocketAddress * const       *addresses,
+                                         guint                         n_addresses,
+                                         guint                         max_parallel,
+                                         GarilConnectionFlags          flags,
+                                         GCancellable                 *cancellable,
+                                         GarilConnectionReadyCallback  ready_callback,
+                                         gpointer                      ready_data,
+                                         GAsyncReadyCallback           callback,
+                                         gpointer                      user_data);
+
+gboolean garil_connection_new_for_addresses_finish (GAsyncResult          *res,
+                                                    GarilConnectionStats  *stats,
+                                                    GError               **error);
+
 GIOStream* garil_connection_get_stream (GarilConnection *connection);
 
 GSocketAddress* garil_connection_get_address (GarilConnection *connection);
 
 GarilConnectionFlags garil_connection_get_flags (GarilConnection *connection);
 
+guint garil_connection_get_max_delayed_frames (GarilConnection *connection);
+guint garil_connection_get_max_delayed_bytes (GarilConnection *connection);
+void garil_connection_start_message_processing (GarilConnection *connection);
+
+guint garil_connection_get_max_in_flight (GarilConnection *connection);
+void garil_connection_set_max_in_flight (GarilConnection *connection,
+                                         guint            max_in_flight);
+
+guint garil_connection_get_coalescing_window (GarilConnection *connection);
+void garil_connection_set_coalescing_window (GarilConnection *connection,
+                                             guint            window);
+
+guint garil_connection_get_request_timeout (GarilConnection *connection);
+void garil_connection_set_request_timeout (GarilConnection *connection,
+                                           guint            timeout);
+
+void garil_connection_send_parcel (GarilConnection *connection,
+                                   GarilParcel     *parcel);
+
+void garil_connection_send_request (GarilConnection      *connection,
+                                    gint32                request,
+                                    GarilParcel          *payload,
+                                    GarilRequestPriority  priority,
+                                    GCancellable         *cancellable,
+                                    GAsyncReadyCallback   callback,
+                                    gpointer              user_data);
+GarilParcel* garil_connection_send_request_finish (GarilConnection  *connection,
+                                                   GAsyncResult     *res,
+                                                   gint32           *ril_error,
+                                                   GError          **error);
+
+guint garil_connection_unsolicited_subscribe (GarilConnection          *connection,
+                                              gint32                    code,
+                                              GarilUnsolicitedCallback  callback,
+                                              gpointer                  user_data,
+                                              GDestroyNotify            user_data_free_func);
+void garil_connection_unsolicited_unsubscribe (GarilConnection *connection,
+                                               guint            subscription_id);
+
+void garil_connection_set_unsolicited_policy (GarilConnection        *connection,
+                                              gint32                  code,
+                                              GarilUnsolicitedPolicy  policy,
+                                              guint                   window);
+guint garil_connection_get_unsolicited_count (GarilConnection *connection);
+
 G_END_DECLS
@@ -0,0 +1,58 @@
+/* GARIL - Android RIL client library
+ * Copyright (C) 2016 You-Sheng Yang
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <gio/gio.h>
+
+#include "garil/garilparcel.h"
+
+G_BEGIN_DECLS
+
+/* Size of the big-endian length prefix of every RIL frame. */
+#define GARIL_FRAME_HEADER_SIZE 4
+
+/* Largest frame accepted by default. Android's RILJ rejects anything larger
+ * than 8KiB, leave some head room for vendor extensions. */
+#define GARIL_FRAME_DEFAULT_MAX_SIZE (64 * 1024)
+
+/* Default size of receive buffer blocks. */
+#define GARIL_FRAME_DEFAULT_BLOCK_SIZE (128 * 1024)
+
+typedef struct _GarilFrameDecoder GarilFrameDecoder;
+
+/* Called for every complete frame. @frame is a read-only parcel positioned
+ * at the first byte after the length prefix and is only borrowed for the
+ * duration of the call. */
+typedef void (*GarilFrameFunc) (GarilParcel *frame,
+                                gpointer     user_data);
+
+GarilFrameDecoder *_garil_frame_decoder_new (gsize block_size,
+                                             gsize max_frame_size);
+void _garil_frame_decoder_free (GarilFrameDecoder *decoder);
+
+guint8 *_garil_frame_decoder_get_buffer (GarilFrameDecoder *decoder,
+                                         gsize             *len);
+gboolean _garil_frame_decoder_commit (GarilFrameDecoder  *decoder,
+                                      gsize               len,
+                                      GarilFrameFunc      func,
+                                      gpointer            user_data,
+                                      GError            **error);
+gsize _garil_frame_decoder_get_pending (GarilFrameDecoder *decoder);
+guint _garil_frame_decoder_get_n_blocks (GarilFrameDecoder *decoder);
+
+G_END_DECLS
@@ -0,0 +1,265 @@
+/* GARIL - Android RIL client library
+ * Copyright (C) 2016 You-Sheng Yang
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#if defined (HAVE_CONFIG_H)
+#include "config.h"
+#endif
+
+#include <string.h>
+
+#include "garil/garilframe-private.h"
+
+/* Incremental decoder of length-prefixed RIL frames.
+ *
+ * Data is received straight into large blocks owned by the decoder, and
+ * every complete frame is handed out as a read-only parcel viewing the block
+ * it was received into. Views keep a reference to their block, and a block is
+ * recycled once the decoder moved on and all its views were released, so
+ * bursts of frames cost neither an allocation nor a copy each.
+ *
+ * When the free space at the end of the current block runs low, the decoder
+ * rotates to a recycled or new block. An incomplete frame left at the end of
+ * the old block is moved to the start of the new one: the single copy a frame
+ * ever undergoes, and only when it straddles a block boundary. */
+
+/* Don't bother reading into less free space than this. */
+#define MIN_READ_SPACE 2048
+
+/* Blocks kept for recycling, whether or not they still have views. */
+#define MAX_SPARE_BLOCKS 4
+
+typedef struct {
+  volatile gint ref_count;
+  gsize size;
+  guint8 data[];
+} Block;
+
+struct _GarilFrameDecoder
+{
+  gsize block_size;
+  gsize max_frame_size;
+
+  Block *block;
+  /* Start of the unparsed data, i.e. the first incomplete frame. */
+  gsize tail;
+  /* End of the received data. */
+  gsize head;
+
+  GPtrArray *spares;
+  guint n_blocks;
+
+  gboolean failed;
+};
+
+static Block*
+block_ref (Block *block)
+{
+  g_atomic_int_inc (&block->ref_count);
+  return block;
+}
+
+static void
+block_unref (Block *block)
+{
+  if (g_atomic_int_dec_and_test (&block->ref_count))
+    g_free (block);
+}
+
+static Block*
+block_new (GarilFrameDecoder *decoder)
+{
+  Block *block = g_malloc (sizeof (Block) + decoder->block_size);
+  block->ref_count = 1;
+  block->size = decoder->block_size;
+  decoder->n_blocks++;
+
+  return block;
+}
+
+GarilFrameDecoder*
+_garil_frame_decoder_new (gsize block_size,
+                          gsize max_frame_size)
+{
+  GarilFrameDecoder *decoder = g_new0 (GarilFrameDecoder, 1);
+  decoder->max_frame_size =
+    max_frame_size ? max_frame_size : GARIL_FRAME_DEFAULT_MAX_SIZE;
+  /* Room for the largest frame, plus some to read the next one into. */
+  decoder->block_size =
+    MAX (block_size ? block_size : GARIL_FRAME_DEFAULT_BLOCK_SIZE,
+         GARIL_FRAME_HEADER_SIZE + decoder->max_frame_size + MIN_READ_SPACE);
+  decoder->spares = g_ptr_array_new_with_free_func ((GDestroyNotify) block_unref);
+  decoder->block = block_new (decoder);
+
+  return decoder;
+}
+
+void
+_garil_frame_decoder_free (GarilFrameDecoder *decoder)
+{
+  g_return_if_fail (decoder != NULL);
+
+  g_ptr_array_unref (decoder->spares);
+  block_unref (decoder->block);
+  g_free (decoder);
+}
+
+static guint32
+peek_frame_size (const guint8 *data)
+{
+  guint32 size;
+  memcpy (&size, data, sizeof (size));
+  return GUINT32_FROM_BE (size);
+}
+
+/* Move the unparsed data to the start of a block without views. */
+static void
+rotate (GarilFrameDecoder *decoder)
+{
+  Block *old = decoder->block;
+  Block *block = NULL;
+
+  for (guint i = 0; i < decoder->spares->len; i++) {
+    Block *spare = g_ptr_array_index (decoder->spares, i);
+    if (g_atomic_int_get (&spare->ref_count) == 1) {
+      block = block_ref (spare);
+      g_ptr_array_remove_index (decoder->spares, i);
+      break;
+    }
+  }
+  if (block == NULL)
+    block = block_new (decoder);
+
+  const gsize pending = decoder->head - decoder->tail;
+  memcpy (block->data, old->data + decoder->tail, pending);
+  decoder->block = block;
+  decoder->tail = 0;
+  decoder->head = pending;
+
+  g_ptr_array_add (decoder->spares, old);
+  if (decoder->spares->len > MAX_SPARE_BLOCKS)
+    g_ptr_array_remove_index (decoder->spares, 0);
+}
+
+/* Get free space to receive data into. It stays valid until the matching
+ * _garil_frame_decoder_commit() call. */
+guint8*
+_garil_frame_decoder_get_buffer (GarilFrameDecoder *decoder,
+                                 gsize             *len)
+{
+  g_return_val_if_fail ((decoder != NULL) && (len != NULL), NULL);
+  g_return_val_if_fail (!decoder->failed, NULL);
+
+  Block *block = decoder->block;
+
+  if ((decoder->tail == decoder->head) &&
+      (g_atomic_int_get (&block->ref_count) == 1)) {
+    /* Nothing pending and no views, start over. */
+    decoder->tail = decoder->head = 0;
+  } else {
+    gsize needed = MIN_READ_SPACE;
+    if ((decoder->head - decoder->tail) >= GARIL_FRAME_HEADER_SIZE) {
+      const gsize frame_end = decoder->tail + GARIL_FRAME_HEADER_SIZE +
+        peek_frame_size (block->data + decoder->tail);
+      needed = MIN (needed, frame_end - decoder->head);
+    }
+
+    if ((block->size - decoder->head) < needed) {
+      rotate (decoder);
+      block = decoder->block;
+    }
+  }
+
+  *len = block->size - decoder->head;
+  return block->data + decoder->head;
+}
+
+static gboolean
+check_frame_size (GarilFrameDecoder  *decoder,
+                  gsize               size,
+                  GError            **error)
+{
+  if (size <= decoder->max_frame_size)
+    return TRUE;
+
+  decoder->failed = TRUE;
+  g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+               "Frame of %" G_GSIZE_FORMAT " bytes exceeds the limit of %"
+               G_GSIZE_FORMAT " bytes",
+               size, decoder->max_frame_size);
+  return FALSE;
+}
+
+/* Account for @len bytes received into the buffer returned by
+ * _garil_frame_decoder_get_buffer(), and call @func for every frame completed
+ * by them. On a framing error @error is set and the decoder refuses further
+ * input. */
+gboolean
+_garil_frame_decoder_commit (GarilFrameDecoder  *decoder,
+                             gsize               len,
+                             GarilFrameFunc      func,
+                             gpointer            user_data,
+                             GError            **error)
+{
+  g_return_val_if_fail ((decoder != NULL) && (func != NULL), FALSE);
+  g_return_val_if_fail (!decoder->failed, FALSE);
+  g_return_val_if_fail (len <= (decoder->block->size - decoder->head), FALSE);
+
+  Block *block = decoder->block;
+  decoder->head += len;
+
+  while ((decoder->head - decoder->tail) >= GARIL_FRAME_HEADER_SIZE) {
+    const gsize size = peek_frame_size (block->data + decoder->tail);
+    if (!check_frame_size (decoder, size, error))
+      return FALSE;
+
+    const gsize offset = decoder->tail + GARIL_FRAME_HEADER_SIZE;
+    if ((decoder->head - offset) < size)
+      break;
+
+    decoder->tail = offset + size;
+
+    GBytes *bytes =
+      g_bytes_new_with_free_func (block->data + offset, size,
+                                  (GDestroyNotify) block_unref,
+                                  block_ref (block));
+    GarilParcel *frame = garil_parcel_new_from_bytes (bytes);
+    g_bytes_unref (bytes);
+
+    func (frame, user_data);
+    garil_parcel_unref (frame);
+  }
+
+  return TRUE;
+}
+
+/* Number of bytes of an incomplete frame held by the decoder. */
+gsize
+_garil_frame_decoder_get_pending (GarilFrameDecoder *decoder)
+{
+  g_return_val_if_fail (decoder != NULL, 0);
+
+  return decoder->head - decoder->tail;
+}
+
+/* Number of blocks allocated so far. */
+guint
+_garil_frame_decoder_get_n_blocks (GarilFrameDecoder *decoder)
+{
+  g_return_val_if_fail (decoder != NULL, 0);
+
+  return decoder->n_blocks;
+}
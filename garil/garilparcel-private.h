@@ -0,0 +1,36 @@
+/* GARIL - Android RIL client library
+ * Copyright (C) 2016 You-Sheng Yang
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "garil/garilparcel.h"
+#include "garil/garilparcelpool.h"
+
+G_BEGIN_DECLS
+
+void _garil_parcel_attach_pool (GarilParcel     *parcel,
+                                GarilParcelPool *pool,
+                                gsize            capacity);
+void _garil_parcel_revive (GarilParcel *parcel);
+void _garil_parcel_rewind (GarilParcel *parcel,
+                           goffset      position);
+
+gboolean _garil_parcel_pool_recycle (GarilParcelPool *pool,
+                                     GarilParcel     *parcel,
+                                     gsize            capacity);
+
+G_END_DECLS
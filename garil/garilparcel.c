@@ -22,6 +22,9 @@
 #include <string.h>
 
 #include "garil/garilparcel.h"
+#include "garil/garilcodec-private.h"
+#include "garil/garilparcel-private.h"
+#include "garil/garilparcelpool.h"
 
 /**
  * SECTION:garilparcel
@@ -35,6 +38,22 @@
 G_DEFINE_BOXED_TYPE (GarilParcel, garil_parcel,
                      garil_parcel_ref, garil_parcel_unref)
 
+typedef enum {
+  STORAGE_BYTE_ARRAY,
+  STORAGE_BYTES,
+  STORAGE_SEGMENTS,
+  STORAGE_MEASURE,
+} Storage;
+
+/* A chunk of a segmented parcel. Written bytes are never moved. */
+typedef struct {
+  gsize size;
+  gsize len;
+  guint8 data[];
+} Segment;
+
+#define DEFAULT_SEGMENT_SIZE 4096
+
 /**
  * GarilParcel:
  *
@@ -44,11 +63,61 @@ struct _GarilParcel
 {
   volatile gint ref_count;
 
+  Storage storage;
+
+  /* STORAGE_BYTE_ARRAY */
   GByteArray *byte_array;
+
+  /* STORAGE_BYTES: read-only, caches data pointer and size of the bytes. */
+  GBytes *bytes;
+  const guint8 *bytes_data;
+  gsize bytes_size;
+
+  /* STORAGE_SEGMENTS: write-only, a chain of Segment. */
+  GPtrArray *segments;
+  gsize segment_size;
+  gsize segments_len;
+
+  /* STORAGE_MEASURE: no data at all, only the would-be size. */
+  gsize measured_size;
+
   goffset position;
   gboolean malformed;
+
+  /* Pool this parcel returns to when the last reference is dropped, and a
+   * lower bound of the allocated size of byte_array, which never shrinks. */
+  GarilParcelPool *pool;
+  gsize capacity;
 };
 
+static inline gsize
+pad_size (gsize size)
+{
+  return (size + 3) & ~3;
+}
+
+/* Only valid for readable storages. */
+static inline const guint8*
+get_data (GarilParcel *parcel)
+{
+  if (parcel->storage == STORAGE_BYTES)
+    return parcel->bytes_data;
+
+  return parcel->byte_array->data;
+}
+
+static GarilParcel*
+parcel_alloc (Storage storage)
+{
+  GarilParcel *parcel = g_new0 (GarilParcel, 1);
+  parcel->ref_count = 1;
+  parcel->storage = storage;
+  parcel->position = 0;
+  parcel->malformed = FALSE;
+
+  return parcel;
+}
+
 /**
  * garil_parcel_new:
  * @array: A #GByteArray or %NULL.
@@ -62,10 +131,7 @@ struct _GarilParcel
 GarilParcel*
 garil_parcel_new (GByteArray *array)
 {
-  GarilParcel *parcel = g_new0 (GarilParcel, 1);
-  parcel->ref_count = 1;
-  parcel->position = 0;
-  parcel->malformed = FALSE;
+  GarilParcel *parcel = parcel_alloc (STORAGE_BYTE_ARRAY);
 
   if (array != NULL)
     parcel->byte_array = g_byte_array_ref (array);
@@ -75,6 +141,112 @@ garil_parcel_new (GByteArray *array)
   return parcel;
 }
 
+/**
+ * garil_parcel_new_from_bytes:
+ * @bytes: (not nullable): A #GBytes.
+ *
+ * Create a new read-only parcel to wrap @bytes without copying its contents.
+ * This can be a slice of a larger receive buffer created with
+ * g_bytes_new_from_bytes() or a memory mapped file obtained from
+ * g_mapped_file_get_bytes(). The parcel holds a reference to @bytes until
+ * it's freed.
+ *
+ * All the read functions, including garil_parcel_read_inplace(), operate
+ * directly on the memory of @bytes. Writing to the returned parcel is not
+ * allowed.
+ *
+ * Returns: (transfer full): A newly allocated #GarilParcel, which should be
+ *   freed with garil_parcel_unref().
+ */
+GarilParcel*
+garil_parcel_new_from_bytes (GBytes *bytes)
+{
+  g_return_val_if_fail ((bytes != NULL), NULL);
+
+  GarilParcel *parcel = parcel_alloc (STORAGE_BYTES);
+  parcel->bytes = g_bytes_ref (bytes);
+  parcel->bytes_data = g_bytes_get_data (bytes, &parcel->bytes_size);
+
+  return parcel;
+}
+
+/**
+ * garil_parcel_new_segmented:
+ * @segment_size: Size of each segment in bytes, or 0 for a default value.
+ *
+ * Create a new write-only parcel that stores its data in a chain of fixed-size
+ * segments instead of a single #GByteArray. Growing the parcel allocates a new
+ * segment and never reallocates or moves bytes already written, so pointers
+ * returned by garil_parcel_write_inplace() stay valid for the whole lifetime
+ * of the parcel.
+ *
+ * A single write is never split across segments. When it doesn't fit into the
+ * remaining space of the last segment, a new segment of @segment_size bytes,
+ * or larger if the write itself is, is started.
+ *
+ * Use garil_parcel_get_vectors() to access the written data, e.g. to pass it
+ * to g_socket_send_message() without copying. Reading from the returned parcel
+ * is not allowed.
+ *
+ * Returns: (transfer full): A newly allocated #GarilParcel, which should be
+ *   freed with garil_parcel_unref().
+ */
+GarilParcel*
+garil_parcel_new_segmented (gsize segment_size)
+{
+  GarilParcel *parcel = parcel_alloc (STORAGE_SEGMENTS);
+  parcel->segments = g_ptr_array_new_with_free_func (g_free);
+  parcel->segment_size = segment_size ? pad_size (segment_size)
+                                      : DEFAULT_SEGMENT_SIZE;
+  parcel->segments_len = 0;
+
+  return parcel;
+}
+
+/**
+ * garil_parcel_new_measure:
+ *
+ * Create a new parcel that doesn't store anything. All garil_parcel_write_*()
+ * functions on it only account for the size, including padding, the data
+ * would take when written into a regular parcel, which can then be obtained
+ * with garil_parcel_get_size().
+ *
+ * This allows encoding a message in two passes: first into a measuring parcel,
+ * then into one whose storage was allocated with the exact size up front,
+ * e.g. with g_byte_array_sized_new() or from a pool.
+ *
+ * garil_parcel_write_inplace() always returns NULL for measuring parcels
+ * without marking them malformed. Reading from them is not allowed.
+ *
+ * Returns: (transfer full): A newly allocated #GarilParcel, which should be
+ *   freed with garil_parcel_unref().
+ */
+GarilParcel*
+garil_parcel_new_measure (void)
+{
+  GarilParcel *parcel = parcel_alloc (STORAGE_MEASURE);
+  parcel->measured_size = 0;
+
+  return parcel;
+}
+
+/**
+ * garil_parcel_is_measure:
+ * @parcel: (not nullable): A #GarilParcel.
+ *
+ * Return whether the parcel only measures the size of what is written to it,
+ * i.e. was created with garil_parcel_new_measure().
+ *
+ * Returns: %TRUE if the parcel is a measuring one; %FALSE otherwise.
+ */
+gboolean
+garil_parcel_is_measure (GarilParcel *parcel)
+{
+  g_return_val_if_fail ((parcel != NULL), FALSE);
+
+  return (parcel->storage == STORAGE_MEASURE);
+}
+
 /**
  * garil_parcel_ref:
  * @parcel: A #GarilParcel.
@@ -97,7 +269,8 @@ garil_parcel_ref (GarilParcel *parcel)
  * garil_parcel_unref:
  * @parcel: A #GarilParcel.
  *
- * Release a reference of a parcel. This may results in parcel being freed.
+ * Release a reference of a parcel. This may results in parcel being freed, or
+ * returned to the #GarilParcelPool it was acquired from.
  */
 void
 garil_parcel_unref (GarilParcel *parcel)
@@ -105,11 +278,106 @@ garil_parcel_unref (GarilParcel *parcel)
   g_return_if_fail (parcel != NULL);
 
   if (g_atomic_int_dec_and_test (&parcel->ref_count)) {
-    g_byte_array_unref (parcel->byte_array);
+    GarilParcelPool *pool = parcel->pool;
+    if (pool != NULL) {
+      parcel->pool = NULL;
+      parcel->capacity = MAX (parcel->capacity, parcel->byte_array->len);
+      const gboolean recycled =
+          _garil_parcel_pool_recycle (pool, parcel, parcel->capacity);
+      garil_parcel_pool_unref (pool);
+      if (recycled)
+        return;
+    }
+
+    switch (parcel->storage) {
+      case STORAGE_BYTE_ARRAY:
+        g_byte_array_unref (parcel->byte_array);
+        break;
+      case STORAGE_BYTES:
+        g_bytes_unref (parcel->bytes);
+        break;
+      case STORAGE_SEGMENTS:
+        g_ptr_array_unref (parcel->segments);
+        break;
+      case STORAGE_MEASURE:
+        break;
+    }
     g_free (parcel);
   }
 }
 
+/**
+ * garil_parcel_reset:
+ * @parcel: (not nullable): A #GarilParcel.
+ *
+ * Rewind the parcel to position 0 and clear the malformed flag. Writable
+ * parcels are also truncated to size 0, keeping their allocated storage for
+ * reuse, which also affects the #GByteArray passed to garil_parcel_new() if
+ * any. Read-only parcels keep their data and can be read again.
+ */
+void
+garil_parcel_reset (GarilParcel *parcel)
+{
+  g_return_if_fail (parcel != NULL);
+
+  switch (parcel->storage) {
+    case STORAGE_BYTE_ARRAY:
+      g_byte_array_set_size (parcel->byte_array, 0);
+      break;
+    case STORAGE_BYTES:
+      break;
+    case STORAGE_SEGMENTS:
+      if (parcel->segments->len) {
+        Segment *segment = g_ptr_array_index (parcel->segments, 0);
+        segment->len = 0;
+        g_ptr_array_set_size (parcel->segments, 1);
+      }
+      parcel->segments_len = 0;
+      break;
+    case STORAGE_MEASURE:
+      parcel->measured_size = 0;
+      break;
+  }
+
+  parcel->position = 0;
+  parcel->malformed = FALSE;
+}
+
+/* Called by the pool with a freshly allocated or recycled parcel, whose
+ * storage is known to hold at least @capacity bytes. */
+void
+_garil_parcel_attach_pool (GarilParcel     *parcel,
+                           GarilParcelPool *pool,
+                           gsize            capacity)
+{
+  g_assert (parcel->storage == STORAGE_BYTE_ARRAY);
+  g_assert (parcel->pool == NULL);
+
+  parcel->pool = garil_parcel_pool_ref (pool);
+  parcel->capacity = MAX (parcel->capacity, capacity);
+}
+
+/* Called by the pool when keeping a parcel whose last reference was dropped. */
+void
+_garil_parcel_revive (GarilParcel *parcel)
+{
+  garil_parcel_reset (parcel);
+  g_atomic_int_set (&parcel->ref_count, 1);
+}
+
+/* Move a read-only parcel back to @position, previously returned by
+ * garil_parcel_get_position(), and clear the malformed flag. */
+void
+_garil_parcel_rewind (GarilParcel *parcel,
+                      goffset      position)
+{
+  g_assert (parcel->storage == STORAGE_BYTES);
+  g_assert ((position >= 0) && (position <= (goffset) parcel->bytes_size));
+
+  parcel->position = position;
+  parcel->malformed = FALSE;
+}
+
 /**
  * garil_parcel_get_size:
  * @parcel: A #GarilParcel.
@@ -123,7 +391,19 @@ garil_parcel_get_size (GarilParcel *parcel)
 {
   g_return_val_if_fail ((parcel != NULL), 0);
 
-  return parcel->byte_array->len;
+  switch (parcel->storage) {
+    case STORAGE_BYTE_ARRAY:
+      return parcel->byte_array->len;
+    case STORAGE_BYTES:
+      return parcel->bytes_size;
+    case STORAGE_SEGMENTS:
+      return parcel->segments_len;
+    case STORAGE_MEASURE:
+      return parcel->measured_size;
+  }
+
+  g_assert_not_reached ();
+  return 0;
 }
 
 /**
@@ -139,7 +419,7 @@ garil_parcel_get_available (GarilParcel *parcel)
 {
   g_return_val_if_fail ((parcel != NULL), 0);
 
-  return parcel->byte_array->len - parcel->position;
+  return garil_parcel_get_size (parcel) - parcel->position;
 }
 
 /**
@@ -158,6 +438,80 @@ garil_parcel_get_position (GarilParcel *parcel)
   return parcel->position;
 }
 
+/**
+ * garil_parcel_is_read_only:
+ * @parcel: A #GarilParcel.
+ *
+ * Return whether the parcel is read-only, i.e. was created with
+ * garil_parcel_new_from_bytes().
+ *
+ * Returns: %TRUE if the parcel is read-only; %FALSE otherwise.
+ */
+gboolean
+garil_parcel_is_read_only (GarilParcel *parcel)
+{
+  g_return_val_if_fail ((parcel != NULL), FALSE);
+
+  return (parcel->storage == STORAGE_BYTES);
+}
+
+/**
+ * garil_parcel_get_vectors:
+ * @parcel: A #GarilParcel.
+ * @vectors: (array length=n_vectors) (out caller-allocates) (nullable):
+ *   Destination array.
+ * @n_vectors: Number of elements in @vectors.
+ *
+ * Fill @vectors with the memory regions holding the parcel data, in order, so
+ * that the parcel can be passed to g_socket_send_message() or the like without
+ * being copied into a contiguous buffer first. Parcels other than those
+ * created with garil_parcel_new_segmented() have at most one region, measuring
+ * parcels none at all.
+ *
+ * The regions stay valid until the parcel is written again or freed.
+ *
+ * Returns: The total number of regions, which may be larger than @n_vectors.
+ *   Only the first @n_vectors of them are filled in that case.
+ */
+guint
+garil_parcel_get_vectors (GarilParcel   *parcel,
+                          GOutputVector *vectors,
+                          guint          n_vectors)
+{
+  g_return_val_if_fail ((parcel != NULL) && ((vectors != NULL) || !n_vectors),
+                        0);
+
+  if (parcel->storage == STORAGE_MEASURE)
+    return 0;
+
+  if (parcel->storage != STORAGE_SEGMENTS) {
+    const gsize size = garil_parcel_get_size (parcel);
+    if (!size)
+      return 0;
+
+    if (n_vectors) {
+      vectors[0].buffer = get_data (parcel);
+      vectors[0].size = size;
+    }
+    return 1;
+  }
+
+  guint n = 0;
+  for (guint i = 0; i < parcel->segments->len; i++) {
+    const Segment *segment = g_ptr_array_index (parcel->segments, i);
+    if (!segment->len)
+      continue;
+
+    if (n < n_vectors) {
+      vectors[n].buffer = segment->data;
+      vectors[n].size = segment->len;
+    }
+    n++;
+  }
+
+  return n;
+}
+
 /**
  * garil_parcel_is_malformed:
  * @parcel: A #GarilParcel.
@@ -185,12 +539,6 @@ ensure_available (GarilParcel *parcel,
   return FALSE;
 }
 
-static inline gsize
-pad_size (gsize size)
-{
-  return (size + 3) & ~3;
-}
-
 /**
  * garil_parcel_read:
  * @parcel: (not nullable): A #GarilParcel.
@@ -244,7 +592,8 @@ garil_parcel_read_dup (GarilParcel *parcel,
  * @len: Length to be read out.
  *
  * Read arbitrary length of data out of the parcel with a pointer to internal
- * buffer. Do nothing if the parcel has been marked malformed.
+ * buffer. Do nothing if the parcel has been marked malformed. Not allowed on
+ * segmented or measuring parcels.
  *
  * Returns: (transfer none) (array length=len): A pointer to internal buffer.
  *   It's owned by the parcel and should never be freed.
@@ -253,7 +602,9 @@ gconstpointer
 garil_parcel_read_inplace (GarilParcel *parcel,
                            gsize        len)
 {
-  g_return_val_if_fail ((parcel != NULL), NULL);
+  g_return_val_if_fail ((parcel != NULL) &&
+                        (parcel->storage != STORAGE_SEGMENTS) &&
+                        (parcel->storage != STORAGE_MEASURE), NULL);
 
   if (parcel->malformed)
     return NULL;
@@ -267,7 +618,7 @@ garil_parcel_read_inplace (GarilParcel *parcel,
   if (!ensure_available (parcel, padded_len))
     return NULL;
 
-  gpointer ret = parcel->byte_array->data + parcel->position;
+  gconstpointer ret = get_data (parcel) + parcel->position;
   parcel->position += padded_len;
   return ret;
 }
@@ -279,7 +630,7 @@ garil_parcel_read_inplace (GarilParcel *parcel,
  * @len: Length to be written.
  *
  * Write arbitrary length of data into the parcel. Do nothing if the parcel has
- * been marked malformed.
+ * been marked malformed. Not allowed on read-only parcels.
  */
 void
 garil_parcel_write (GarilParcel   *parcel,
@@ -287,6 +638,7 @@ garil_parcel_write (GarilParcel   *parcel,
                     gsize          len)
 {
   g_return_if_fail ((parcel != NULL) && ((buf != NULL) || !len));
+  g_return_if_fail (parcel->storage != STORAGE_BYTES);
 
   if (parcel->malformed || !len)
     return;
@@ -305,7 +657,12 @@ garil_parcel_write (GarilParcel   *parcel,
  * @len: Length to be written.
  *
  * Write arbitrary length of data into the parcel with a pointer to internal
- * buffer. Do nothing if the parcel has been marked malformed.
+ * buffer. Do nothing if the parcel has been marked malformed. Not allowed on
+ * read-only parcels.
+ *
+ * For segmented parcels the returned pointer stays valid until the parcel is
+ * freed. Otherwise it may be invalidated by any subsequent write. Measuring
+ * parcels only account for the size and always return NULL.
  *
  * Returns: (transfer none) (array length=len): A pointer to internal buffer.
  *   It's owned by the parcel and should never be freed.
@@ -314,7 +671,8 @@ gpointer
 garil_parcel_write_inplace (GarilParcel *parcel,
                             gsize        len)
 {
-  g_return_val_if_fail ((parcel != NULL), NULL);
+  g_return_val_if_fail ((parcel != NULL) &&
+                        (parcel->storage != STORAGE_BYTES), NULL);
 
   if (parcel->malformed)
     return NULL;
@@ -325,10 +683,34 @@ garil_parcel_write_inplace (GarilParcel *parcel,
   }
 
   const gsize padded_len = pad_size (len);
-  g_byte_array_set_size (parcel->byte_array,
-                         parcel->byte_array->len + padded_len);
+  gpointer ret;
+
+  if (parcel->storage == STORAGE_MEASURE) {
+    ret = NULL;
+    parcel->measured_size += padded_len;
+  } else if (parcel->storage == STORAGE_SEGMENTS) {
+    Segment *segment = NULL;
+    if (parcel->segments->len)
+      segment = g_ptr_array_index (parcel->segments,
+                                   parcel->segments->len - 1);
+
+    if ((segment == NULL) || ((segment->size - segment->len) < padded_len)) {
+      const gsize size = MAX (parcel->segment_size, padded_len);
+      segment = g_malloc (sizeof (Segment) + size);
+      segment->size = size;
+      segment->len = 0;
+      g_ptr_array_add (parcel->segments, segment);
+    }
+
+    ret = segment->data + segment->len;
+    segment->len += padded_len;
+    parcel->segments_len += padded_len;
+  } else {
+    g_byte_array_set_size (parcel->byte_array,
+                           parcel->byte_array->len + padded_len);
+    ret = parcel->byte_array->data + parcel->position;
+  }
 
-  gpointer ret = parcel->byte_array->data + parcel->position;
   parcel->position += padded_len;
   return ret;
 }
@@ -475,6 +857,40 @@ garil_parcel_read_int32 (GarilParcel *parcel)
   return value;
 }
 
+/* Read the length and the little-endian elements of an int32 array. */
+static const gint32*
+read_int32_array_le (GarilParcel *parcel,
+                     gsize       *len)
+{
+  const gint32 ilen = garil_parcel_read_int32 (parcel);
+  if (parcel->malformed || (ilen < 0)) {
+    parcel->malformed = TRUE;
+    return NULL;
+  }
+
+  const gint32 *p =
+    garil_parcel_read_inplace (parcel, (gsize) ilen * sizeof (gint32));
+  if (p == NULL)
+    return NULL;
+
+  *len = ilen;
+  return p;
+}
+
+/* Convert between native and little-endian int32 arrays. It's the same
+ * operation in both directions. */
+static inline void
+copy_int32_le (gint32       *dst,
+               const gint32 *src,
+               gsize         len)
+{
+#if (G_BYTE_ORDER == G_LITTLE_ENDIAN)
+  memmove (dst, src, len * sizeof (gint32));
+#else
+  _garil_int32_swap_copy (dst, src, len);
+#endif
+}
+
 /**
  * garil_parcel_read_int32_array:
  * @parcel: (not nullable): A #GarilParcel.
@@ -493,31 +909,98 @@ garil_parcel_read_int32_array (GarilParcel *parcel)
   if (parcel->malformed)
     return NULL;
 
-  const gint32 len = garil_parcel_read_int32 (parcel);
-  if (parcel->malformed || (len < 0)) {
-    parcel->malformed = TRUE;
-    return NULL;
-  }
-
-  const gint32 *p = garil_parcel_read_inplace (parcel, len * sizeof (gint32));
+  gsize len = 0;
+  const gint32 *p = read_int32_array_le (parcel, &len);
   if (p == NULL)
     return NULL;
 
   GArray *array = g_array_sized_new (FALSE, FALSE, sizeof (gint32), len);
-#if (G_BYTE_ORDER == G_LITTLE_ENDIAN)
-  g_array_append_vals (array, p, len);
-#else
   /* g_array_sized_new() only preallocates the space, but an explicit
    * g_array_set_size() call is still required. */
   g_array_set_size (array, len);
-  for (gint32 i = 0, *q = (gint32 *) array->data; i < len; i++, p++, q++) {
-    *q = GINT32_FROM_LE (*p);
-  }
-#endif
+  copy_int32_le ((gint32 *) array->data, p, len);
 
   return array;
 }
 
+/**
+ * garil_parcel_read_int32_array_into:
+ * @parcel: (not nullable): A #GarilParcel.
+ * @dst: (array length=capacity) (out caller-allocates): Destination buffer.
+ * @capacity: Number of elements @dst can hold.
+ * @len: (not nullable) (out): Number of elements read into @dst.
+ *
+ * Read a #gint32 array out of the parcel into a caller-provided buffer. Do
+ * nothing if the parcel has been marked malformed.
+ *
+ * An array with more than @capacity elements marks the parcel malformed.
+ *
+ * Returns: %TRUE if the array was read; %FALSE otherwise.
+ */
+gboolean
+garil_parcel_read_int32_array_into (GarilParcel *parcel,
+                                    gint32      *dst,
+                                    gsize        capacity,
+                                    gsize       *len)
+{
+  g_return_val_if_fail ((parcel != NULL) && ((dst != NULL) || !capacity) &&
+                        (len != NULL), FALSE);
+
+  if (parcel->malformed)
+    return FALSE;
+
+  gsize n = 0;
+  const gint32 *p = read_int32_array_le (parcel, &n);
+  if (p == NULL)
+    return FALSE;
+
+  if (n > capacity) {
+    parcel->malformed = TRUE;
+    return FALSE;
+  }
+
+  copy_int32_le (dst, p, n);
+  *len = n;
+  return TRUE;
+}
+
+#if (G_BYTE_ORDER == G_LITTLE_ENDIAN)
+/**
+ * garil_parcel_read_int32_array_inplace:
+ * @parcel: (not nullable): A #GarilParcel.
+ * @len: (not nullable) (out): Number of elements in the returned array.
+ *
+ * Read a #gint32 array out of the parcel with a pointer to internal buffer. Do
+ * nothing if the parcel has been marked malformed.
+ *
+ * Parcel data is little-endian, so this is only available on little-endian
+ * hosts. The returned pointer is 4-byte aligned as long as the parcel storage
+ * is, which is always the case except for parcels created with
+ * garil_parcel_new_from_bytes() over unaligned data.
+ *
+ * Returns: (transfer none) (array length=len) (nullable): A pointer to the
+ *   elements, or %NULL on failure. Note that an empty array may also be
+ *   returned as a non-%NULL pointer.
+ */
+const gint32*
+garil_parcel_read_int32_array_inplace (GarilParcel *parcel,
+                                       gsize       *len)
+{
+  g_return_val_if_fail ((parcel != NULL) && (len != NULL), NULL);
+
+  if (parcel->malformed)
+    return NULL;
+
+  gsize n = 0;
+  const gint32 *p = read_int32_array_le (parcel, &n);
+  if (p == NULL)
+    return NULL;
+
+  *len = n;
+  return p;
+}
+#endif
+
 /**
  * garil_parcel_write_int32:
  * @parcel: (not nullable): A #GarilParcel.
@@ -587,13 +1070,81 @@ garil_parcel_write_int32_array_buf (GarilParcel  *parcel,
   if (p == NULL)
     return;
 
-#if (G_BYTE_ORDER == G_LITTLE_ENDIAN)
-  memmove (p, buf, len * sizeof (gint32));
-#else
-  for (gsize i = 0; i < len; i++, p++, buf++) {
-    *p = GINT32_TO_LE (*buf);
+  copy_int32_le (p, buf, len);
+}
+
+/**
+ * garil_parcel_read_int32_struct:
+ * @parcel: (not nullable): A #GarilParcel.
+ * @dst: (array length=n_fields) (out caller-allocates): Destination buffer.
+ * @n_fields: Number of #gint32 fields to read.
+ *
+ * Read @n_fields consecutive #gint32 values, without a length prefix, out of
+ * the parcel into @dst. Do nothing if the parcel has been marked malformed.
+ *
+ * This is meant for messages that are a fixed sequence of #gint32 fields.
+ * Availability of the whole block is checked once, then it's copied or
+ * byte-swapped at once, so @dst is usually a structure made of #gint32 members
+ * only.
+ *
+ * Returns: %TRUE if @dst was filled in; %FALSE otherwise.
+ */
+gboolean
+garil_parcel_read_int32_struct (GarilParcel *parcel,
+                                gpointer     dst,
+                                gsize        n_fields)
+{
+  g_return_val_if_fail ((parcel != NULL) && ((dst != NULL) || !n_fields),
+                        FALSE);
+
+  if (parcel->malformed)
+    return FALSE;
+
+  if (n_fields > (G_MAXSIZE / sizeof (gint32))) {
+    parcel->malformed = TRUE;
+    return FALSE;
   }
-#endif
+
+  const gint32 *p =
+    garil_parcel_read_inplace (parcel, n_fields * sizeof (gint32));
+  if (p == NULL)
+    return FALSE;
+
+  copy_int32_le (dst, p, n_fields);
+  return TRUE;
+}
+
+/**
+ * garil_parcel_write_int32_struct:
+ * @parcel: (not nullable): A #GarilParcel.
+ * @src: (array length=n_fields): Source buffer.
+ * @n_fields: Number of #gint32 fields to write.
+ *
+ * Write @n_fields consecutive #gint32 values, without a length prefix, into
+ * the parcel. Do nothing if the parcel has been marked malformed.
+ *
+ * This is the counterpart of garil_parcel_read_int32_struct().
+ */
+void
+garil_parcel_write_int32_struct (GarilParcel   *parcel,
+                                 gconstpointer  src,
+                                 gsize          n_fields)
+{
+  g_return_if_fail ((parcel != NULL) && ((src != NULL) || !n_fields));
+
+  if (parcel->malformed || !n_fields)
+    return;
+
+  if (n_fields > (G_MAXSIZE / sizeof (gint32))) {
+    parcel->malformed = TRUE;
+    return;
+  }
+
+  gint32 *p = garil_parcel_write_inplace (parcel, n_fields * sizeof (gint32));
+  if (p == NULL)
+    return;
+
+  copy_int32_le (p, src, n_fields);
 }
 
 /**
@@ -610,24 +1161,167 @@ garil_parcel_read_string16 (GarilParcel *parcel)
 {
   g_return_val_if_fail ((parcel != NULL), NULL);
 
-  if (parcel->malformed)
+  GarilParcelString16 view;
+  if (!garil_parcel_read_string16_view (parcel, &view) || (view.len < 0))
     return NULL;
 
+  gchar *utf8_str = _garil_utf16_to_utf8 (view.data, view.len);
+  if (utf8_str == NULL)
+    parcel->malformed = TRUE;
+
+  return utf8_str;
+}
+
+/**
+ * GarilParcelString16:
+ * @data: Code units of the string in native byte order, or %NULL.
+ * @len: Number of code units in @data as stored in the parcel, not counting
+ *   the NUL terminator, or -1 for a %NULL string.
+ *
+ * A view of a utf-16 encoded string stored in a parcel, filled in by
+ * garil_parcel_read_string16_view(). @data points into the parcel storage,
+ * so the view is only valid as long as the parcel is alive and not written.
+ *
+ * As with garil_parcel_read_string16(), the string ends at its first NUL code
+ * unit even if @len is larger.
+ */
+
+/**
+ * garil_parcel_read_string16_view:
+ * @parcel: (not nullable): A #GarilParcel.
+ * @view: (out caller-allocates) (not nullable): A #GarilParcelString16.
+ *
+ * Read a utf-16 encoded string out of the parcel without converting it. The
+ * string is not validated until it is converted with
+ * garil_parcel_string16_to_utf8() or garil_parcel_string16_copy_utf8(). Do
+ * nothing if the parcel has been marked malformed.
+ *
+ * Returns: %TRUE if @view was filled in; %FALSE otherwise.
+ */
+gboolean
+garil_parcel_read_string16_view (GarilParcel         *parcel,
+                                 GarilParcelString16 *view)
+{
+  g_return_val_if_fail ((parcel != NULL) && (view != NULL), FALSE);
+
+  if (parcel->malformed)
+    return FALSE;
+
   const gint32 len = garil_parcel_read_int32 (parcel);
-  if (parcel->malformed || (len < 0))
-    return NULL;
+  if (parcel->malformed)
+    return FALSE;
+
+  if (len < 0) {
+    view->data = NULL;
+    view->len = -1;
+    return TRUE;
+  }
 
   /* Byte order for each gunichar2 is the native one. */
   const gunichar2 *utf16_str =
     garil_parcel_read_inplace (parcel, (len + 1) * sizeof (gunichar2));
   if (utf16_str == NULL)
+    return FALSE;
+
+  view->data = utf16_str;
+  view->len = len;
+  return TRUE;
+}
+
+/**
+ * garil_parcel_string16_is_null:
+ * @view: (not nullable): A #GarilParcelString16.
+ *
+ * Returns: %TRUE if @view refers to a %NULL string; %FALSE otherwise.
+ */
+gboolean
+garil_parcel_string16_is_null (const GarilParcelString16 *view)
+{
+  g_return_val_if_fail ((view != NULL), TRUE);
+
+  return (view->len < 0);
+}
+
+/**
+ * garil_parcel_string16_equal_ascii:
+ * @view: (not nullable): A #GarilParcelString16.
+ * @ascii: (nullable): An ASCII string or %NULL.
+ *
+ * Compare the string referred by @view against @ascii without converting it.
+ * A %NULL string only equals %NULL.
+ *
+ * Returns: %TRUE if both strings are equal; %FALSE otherwise.
+ */
+gboolean
+garil_parcel_string16_equal_ascii (const GarilParcelString16 *view,
+                                   const gchar               *ascii)
+{
+  g_return_val_if_fail ((view != NULL), FALSE);
+
+  if ((view->len < 0) || (ascii == NULL))
+    return ((view->len < 0) && (ascii == NULL));
+
+  gsize i = 0;
+  for (; (i < (gsize) view->len) && view->data[i]; i++) {
+    if (view->data[i] != (guchar) ascii[i])
+      return FALSE;
+  }
+
+  return (ascii[i] == '\0');
+}
+
+/**
+ * garil_parcel_string16_to_utf8:
+ * @view: (not nullable): A #GarilParcelString16.
+ *
+ * Convert the string referred by @view to utf-8.
+ *
+ * Returns: (transfer full) (nullable): A string, which should be freed with
+ *   g_free(), or %NULL if @view refers to a %NULL string or one that is not
+ *   valid utf-16.
+ */
+gchar*
+garil_parcel_string16_to_utf8 (const GarilParcelString16 *view)
+{
+  g_return_val_if_fail ((view != NULL), NULL);
+
+  if (view->len < 0)
     return NULL;
 
-  gchar *utf8_str = g_utf16_to_utf8 (utf16_str, len, NULL, NULL, NULL);
-  if (utf8_str == NULL)
-    parcel->malformed = TRUE;
+  return _garil_utf16_to_utf8 (view->data, view->len);
+}
 
-  return utf8_str;
+/**
+ * garil_parcel_string16_copy_utf8:
+ * @view: (not nullable): A #GarilParcelString16.
+ * @buf: (array length=size) (nullable): Destination buffer.
+ * @size: Size of @buf in bytes.
+ *
+ * Convert the string referred by @view to utf-8 into @buf, including a NUL
+ * terminator, if it fits. Otherwise @buf is left untouched. Like snprintf(),
+ * the return value can be used to size @buf for a second call.
+ *
+ * Returns: The length in bytes of the converted string, not counting the NUL
+ *   terminator, or -1 if @view refers to a %NULL string or one that is not
+ *   valid utf-16.
+ */
+gssize
+garil_parcel_string16_copy_utf8 (const GarilParcelString16 *view,
+                                 gchar                     *buf,
+                                 gsize                      size)
+{
+  g_return_val_if_fail ((view != NULL) && ((buf != NULL) || !size), -1);
+
+  if (view->len < 0)
+    return -1;
+
+  const gssize len = _garil_utf16_to_utf8_len (view->data, view->len);
+  if ((len >= 0) && ((gsize) len < size)) {
+    _garil_utf16_to_utf8_encode (view->data, view->len, buf);
+    buf[len] = '\0';
+  }
+
+  return len;
 }
 
 /**
@@ -681,6 +1375,86 @@ garil_parcel_read_string16_array (GarilParcel *parcel,
   return array;
 }
 
+/**
+ * garil_parcel_read_string16_array_packed:
+ * @parcel: (not nullable): A #GarilParcel.
+ * @len: (not nullable) (out): Number of elements in the @array.
+ *
+ * Read an array of utf-16 encoded strings out of the parcel like
+ * garil_parcel_read_string16_array(), but lay out the array and all the
+ * strings in one contiguous block. Do nothing if the parcel has been marked
+ * malformed.
+ *
+ * The elements in @array may be NULL. Actual array length is specified in @len.
+ *
+ * Returns: (transfer full) (array length=len): A string array. It should be
+ *   freed with a single g_free(), without freeing the elements.
+ */
+gchar**
+garil_parcel_read_string16_array_packed (GarilParcel *parcel,
+                                         gsize       *len)
+{
+  g_return_val_if_fail (((parcel != NULL) && (len != NULL)), NULL);
+
+  if (parcel->malformed)
+    return NULL;
+
+  gint32 ilen = garil_parcel_read_int32 (parcel);
+  if (parcel->malformed || (ilen < 0)) {
+    parcel->malformed = TRUE;
+    return NULL;
+  }
+
+  if (!ilen) {
+    *len = 0;
+    return NULL;
+  }
+
+  /* First pass: validate and size all strings. */
+  const goffset start = parcel->position;
+  gsize size = ilen * sizeof (gchar *);
+
+  for (gint i = 0; i < ilen; i++) {
+    GarilParcelString16 view;
+    if (!garil_parcel_read_string16_view (parcel, &view))
+      return NULL;
+    if (view.len < 0)
+      continue;
+
+    const gssize utf8_len = _garil_utf16_to_utf8_len (view.data, view.len);
+    if (utf8_len < 0) {
+      parcel->malformed = TRUE;
+      return NULL;
+    }
+    size += utf8_len + 1;
+  }
+
+  /* Second pass: convert into the block. */
+  const goffset end = parcel->position;
+  parcel->position = start;
+
+  gchar **array = g_malloc (size);
+  gchar *p = (gchar *) (array + ilen);
+
+  for (gint i = 0; i < ilen; i++) {
+    GarilParcelString16 view;
+    garil_parcel_read_string16_view (parcel, &view);
+    if (view.len < 0) {
+      array[i] = NULL;
+      continue;
+    }
+
+    array[i] = p;
+    p += _garil_utf16_to_utf8_encode (view.data, view.len, p);
+    *p++ = '\0';
+  }
+
+  g_assert (parcel->position == end);
+
+  *len = ilen;
+  return array;
+}
+
 /**
  * garil_parcel_write_string16:
  * @parcel: (not nullable): A #GarilParcel.
@@ -703,14 +1477,24 @@ garil_parcel_write_string16 (GarilParcel *parcel,
     return;
   }
 
-  glong len = 0;
-  gunichar2 *utf16_str = g_utf8_to_utf16 (utf8_str, -1, NULL, &len, NULL);
-  if (utf16_str == NULL)
+  const gsize utf8_len = strlen (utf8_str);
+  const gssize len = _garil_utf8_to_utf16_len (utf8_str, utf8_len);
+  if (len < 0)
     return;
 
   garil_parcel_write_int32 (parcel, len);
+
   /* Byte order for each gunichar2 is the native one. */
-  garil_parcel_write (parcel, utf16_str, (len + 1) * sizeof (gunichar2));
+  gunichar2 *p =
+    garil_parcel_write_inplace (parcel, (len + 1) * sizeof (gunichar2));
+  if (p == NULL)
+    return;
+
+  _garil_utf8_to_utf16_encode (utf8_str, utf8_len, p);
+  p[len] = 0;
+  /* Clear padding. */
+  if (!(len & 1))
+    p[len + 1] = 0;
 }
 
 /**
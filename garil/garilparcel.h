@@ -23,6 +23,7 @@
 
 #include <glib.h>
 #include <glib-object.h>
+#include <gio/gio.h>
 
 G_BEGIN_DECLS
 
@@ -34,15 +35,31 @@ G_BEGIN_DECLS
 #define GARIL_TYPE_PARCEL (garil_parcel_get_type ())
 
 typedef struct _GarilParcel GarilParcel;
+typedef struct _GarilParcelString16 GarilParcelString16;
+
+struct _GarilParcelString16
+{
+  const gunichar2 *data;
+  gssize len;
+};
 
 GType garil_parcel_get_type (void);
 GarilParcel *garil_parcel_new (GByteArray *array);
+GarilParcel *garil_parcel_new_from_bytes (GBytes *bytes);
+GarilParcel *garil_parcel_new_segmented (gsize segment_size);
+GarilParcel *garil_parcel_new_measure (void);
 GarilParcel *garil_parcel_ref (GarilParcel *parcel);
 void garil_parcel_unref (GarilParcel *parcel);
+void garil_parcel_reset (GarilParcel *parcel);
 
 gsize garil_parcel_get_size (GarilParcel *parcel);
 gsize garil_parcel_get_available (GarilParcel *parcel);
 goffset garil_parcel_get_position (GarilParcel *parcel);
+gboolean garil_parcel_is_read_only (GarilParcel *parcel);
+gboolean garil_parcel_is_measure (GarilParcel *parcel);
+guint garil_parcel_get_vectors (GarilParcel   *parcel,
+                                GOutputVector *vectors,
+                                guint          n_vectors);
 gboolean garil_parcel_is_malformed (GarilParcel *parcel);
 
 void garil_parcel_read (GarilParcel *parcel,
@@ -70,6 +87,14 @@ void garil_parcel_write_byte_array_buf (GarilParcel  *parcel,
 
 gint32 garil_parcel_read_int32 (GarilParcel *parcel);
 GArray *garil_parcel_read_int32_array (GarilParcel *parcel);
+gboolean garil_parcel_read_int32_array_into (GarilParcel *parcel,
+                                             gint32      *dst,
+                                             gsize        capacity,
+                                             gsize       *len);
+#if (G_BYTE_ORDER == G_LITTLE_ENDIAN)
+const gint32 *garil_parcel_read_int32_array_inplace (GarilParcel *parcel,
+                                                     gsize       *len);
+#endif
 void garil_parcel_write_int32 (GarilParcel *parcel,
                                gint32       value);
 void garil_parcel_write_int32_array (GarilParcel  *parcel,
@@ -77,14 +102,32 @@ void garil_parcel_write_int32_array (GarilParcel  *parcel,
 void garil_parcel_write_int32_array_buf (GarilParcel  *parcel,
                                          const gint32 *buf,
                                          gsize         len);
+gboolean garil_parcel_read_int32_struct (GarilParcel *parcel,
+                                         gpointer     dst,
+                                         gsize        n_fields);
+void garil_parcel_write_int32_struct (GarilParcel   *parcel,
+                                      gconstpointer  src,
+                                      gsize          n_fields);
 
 gchar *garil_parcel_read_string16 (GarilParcel *parcel);
+gboolean garil_parcel_read_string16_view (GarilParcel         *parcel,
+                                          GarilParcelString16 *view);
 gchar **garil_parcel_read_string16_array (GarilParcel *parcel,
                                           gsize       *len);
+gchar **garil_parcel_read_string16_array_packed (GarilParcel *parcel,
+                                                 gsize       *len);
 void garil_parcel_write_string16 (GarilParcel *parcel,
                                   const gchar *utf8_str);
 void garil_parcel_write_string16_array (GarilParcel         *parcel,
                                         const gchar * const *array,
                                         gsize                len);
 
+gboolean garil_parcel_string16_is_null (const GarilParcelString16 *view);
+gboolean garil_parcel_string16_equal_ascii (const GarilParcelString16 *view,
+                                            const gchar               *ascii);
+gchar *garil_parcel_string16_to_utf8 (const GarilParcelString16 *view);
+gssize garil_parcel_string16_copy_utf8 (const GarilParcelString16 *view,
+                                        gchar                     *buf,
+                                        gsize                      size);
+
 G_END_DECLS
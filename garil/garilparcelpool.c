@@ -0,0 +1,262 @@
+/* GARIL - Android RIL client library
+ * Copyright (C) 2016 You-Sheng Yang
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#if defined (HAVE_CONFIG_H)
+#include "config.h"
+#endif
+
+#include "garil/garilparcelpool.h"
+#include "garil/garilparcel-private.h"
+
+/**
+ * SECTION:garilparcelpool
+ * @title: Parcel Pools
+ * @short_description: Recycle parcels and their storage.
+ *
+ * GarilParcelPool keeps parcels whose last reference was dropped, together
+ * with their backing buffers, and hands them out again from
+ * garil_parcel_pool_acquire(). Idle parcels are grouped into size classes by
+ * the capacity of their buffers so that a request for a small parcel doesn't
+ * pin a large buffer and vice versa.
+ *
+ * Pools are thread-safe. Parcels acquired from a pool keep a reference to it
+ * until they are recycled.
+ */
+
+G_DEFINE_BOXED_TYPE (GarilParcelPool, garil_parcel_pool,
+                     garil_parcel_pool_ref, garil_parcel_pool_unref)
+
+/**
+ * GarilParcelPool:
+ *
+ * An opaque structure.
+ */
+
+static const gsize size_classes[] = { 256, 1024, 4096, 16384, 65536 };
+#define N_SIZE_CLASSES G_N_ELEMENTS (size_classes)
+
+#define DEFAULT_MAX_IDLE 32
+
+struct _GarilParcelPool
+{
+  volatile gint ref_count;
+
+  GMutex lock;
+  guint max_idle;
+  GPtrArray *idle[N_SIZE_CLASSES];
+};
+
+static void
+free_idle (GPtrArray *idle)
+{
+  g_ptr_array_foreach (idle, (GFunc) garil_parcel_unref, NULL);
+  g_ptr_array_unref (idle);
+}
+
+/**
+ * garil_parcel_pool_new:
+ * @max_idle: Maximum number of idle parcels kept per size class, or 0 for a
+ *   default value.
+ *
+ * Create a new parcel pool.
+ *
+ * Returns: (transfer full): A newly allocated #GarilParcelPool, which should
+ *   be freed with garil_parcel_pool_unref().
+ */
+GarilParcelPool*
+garil_parcel_pool_new (guint max_idle)
+{
+  GarilParcelPool *pool = g_new0 (GarilParcelPool, 1);
+  pool->ref_count = 1;
+  g_mutex_init (&pool->lock);
+  pool->max_idle = max_idle ? max_idle : DEFAULT_MAX_IDLE;
+
+  for (guint i = 0; i < N_SIZE_CLASSES; i++) {
+    pool->idle[i] = g_ptr_array_new ();
+  }
+
+  return pool;
+}
+
+/**
+ * garil_parcel_pool_ref:
+ * @pool: A #GarilParcelPool.
+ *
+ * Increase reference count of a pool.
+ *
+ * Returns: (transfer full): The same #GarilParcelPool.
+ */
+GarilParcelPool*
+garil_parcel_pool_ref (GarilParcelPool *pool)
+{
+  g_return_val_if_fail ((pool != NULL), NULL);
+
+  g_atomic_int_inc (&pool->ref_count);
+
+  return pool;
+}
+
+/**
+ * garil_parcel_pool_unref:
+ * @pool: A #GarilParcelPool.
+ *
+ * Release a reference of a pool. This may results in the pool and all its
+ * idle parcels being freed.
+ */
+void
+garil_parcel_pool_unref (GarilParcelPool *pool)
+{
+  g_return_if_fail (pool != NULL);
+
+  if (g_atomic_int_dec_and_test (&pool->ref_count)) {
+    for (guint i = 0; i < N_SIZE_CLASSES; i++)
+      free_idle (pool->idle[i]);
+    g_mutex_clear (&pool->lock);
+    g_free (pool);
+  }
+}
+
+static GarilParcel*
+new_parcel (gsize size)
+{
+  GByteArray *array = g_byte_array_sized_new (size);
+  GarilParcel *parcel = garil_parcel_new (array);
+  g_byte_array_unref (array);
+
+  return parcel;
+}
+
+/**
+ * garil_parcel_pool_acquire:
+ * @pool: (not nullable): A #GarilParcelPool.
+ * @size: Expected size of the parcel in bytes, e.g. as measured with
+ *   garil_parcel_new_measure(), or 0 if unknown.
+ *
+ * Get an empty writable parcel whose storage can hold at least @size bytes
+ * without growing, reusing an idle one if available. When its last reference
+ * is dropped with garil_parcel_unref(), the parcel is reset with
+ * garil_parcel_reset() and returned to @pool instead of being freed.
+ *
+ * Parcels larger than the largest size class are never pooled.
+ *
+ * Returns: (transfer full): A #GarilParcel, which should be released with
+ *   garil_parcel_unref().
+ */
+GarilParcel*
+garil_parcel_pool_acquire (GarilParcelPool *pool,
+                           gsize            size)
+{
+  g_return_val_if_fail ((pool != NULL), NULL);
+
+  guint size_class = 0;
+  while ((size_class < N_SIZE_CLASSES) && (size > size_classes[size_class]))
+    size_class++;
+
+  if (size_class == N_SIZE_CLASSES)
+    return new_parcel (size);
+
+  GarilParcel *parcel = NULL;
+
+  g_mutex_lock (&pool->lock);
+  GPtrArray *idle = pool->idle[size_class];
+  if (idle->len)
+    parcel = g_ptr_array_remove_index_fast (idle, idle->len - 1);
+  g_mutex_unlock (&pool->lock);
+
+  if (parcel == NULL)
+    parcel = new_parcel (size_classes[size_class]);
+
+  _garil_parcel_attach_pool (parcel, pool, size_classes[size_class]);
+
+  return parcel;
+}
+
+/**
+ * garil_parcel_pool_get_n_idle:
+ * @pool: (not nullable): A #GarilParcelPool.
+ *
+ * Returns: Number of idle parcels currently kept in @pool.
+ */
+guint
+garil_parcel_pool_get_n_idle (GarilParcelPool *pool)
+{
+  g_return_val_if_fail ((pool != NULL), 0);
+
+  guint n = 0;
+
+  g_mutex_lock (&pool->lock);
+  for (guint i = 0; i < N_SIZE_CLASSES; i++)
+    n += pool->idle[i]->len;
+  g_mutex_unlock (&pool->lock);
+
+  return n;
+}
+
+/**
+ * garil_parcel_pool_trim:
+ * @pool: (not nullable): A #GarilParcelPool.
+ *
+ * Free all idle parcels kept in @pool.
+ */
+void
+garil_parcel_pool_trim (GarilParcelPool *pool)
+{
+  g_return_if_fail (pool != NULL);
+
+  GPtrArray *idle[N_SIZE_CLASSES];
+
+  g_mutex_lock (&pool->lock);
+  for (guint i = 0; i < N_SIZE_CLASSES; i++) {
+    idle[i] = pool->idle[i];
+    pool->idle[i] = g_ptr_array_new ();
+  }
+  g_mutex_unlock (&pool->lock);
+
+  for (guint i = 0; i < N_SIZE_CLASSES; i++)
+    free_idle (idle[i]);
+}
+
+/* Take back a parcel whose last reference was dropped, and whose storage
+ * holds at least @capacity bytes. Returns FALSE if the parcel should be freed
+ * instead. */
+gboolean
+_garil_parcel_pool_recycle (GarilParcelPool *pool,
+                            GarilParcel     *parcel,
+                            gsize            capacity)
+{
+  if (capacity > size_classes[N_SIZE_CLASSES - 1])
+    return FALSE;
+
+  /* The largest class it fits, as the buffer may have grown past its own
+   * without reaching the next one. */
+  guint size_class = N_SIZE_CLASSES - 1;
+  while ((size_class > 0) && (capacity < size_classes[size_class]))
+    size_class--;
+
+  gboolean recycled = FALSE;
+
+  g_mutex_lock (&pool->lock);
+  GPtrArray *idle = pool->idle[size_class];
+  if (idle->len < pool->max_idle) {
+    _garil_parcel_revive (parcel);
+    g_ptr_array_add (idle, parcel);
+    recycled = TRUE;
+  }
+  g_mutex_unlock (&pool->lock);
+
+  return recycled;
+}
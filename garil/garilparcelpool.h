@@ -0,0 +1,50 @@
+/* GARIL - Android RIL client library
+ * Copyright (C) 2016 You-Sheng Yang
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#if !defined (__GARIL_GARIL_H_INSIDE__) && !defined (LIBGARIL_COMPILATION)
+#error "Only <garil/garil.h> can be included directly."
+#endif
+
+#include <glib.h>
+#include <glib-object.h>
+
+#include <garil/garilparcel.h>
+
+G_BEGIN_DECLS
+
+/**
+ * GARIL_TYPE_PARCEL_POOL:
+ *
+ * GType for #GarilParcelPool.
+ */
+#define GARIL_TYPE_PARCEL_POOL (garil_parcel_pool_get_type ())
+
+typedef struct _GarilParcelPool GarilParcelPool;
+
+GType garil_parcel_pool_get_type (void);
+GarilParcelPool *garil_parcel_pool_new (guint max_idle);
+GarilParcelPool *garil_parcel_pool_ref (GarilParcelPool *pool);
+void garil_parcel_pool_unref (GarilParcelPool *pool);
+
+GarilParcel *garil_parcel_pool_acquire (GarilParcelPool *pool,
+                                        gsize            size);
+guint garil_parcel_pool_get_n_idle (GarilParcelPool *pool);
+void garil_parcel_pool_trim (GarilParcelPool *pool);
+
+G_END_DECLS
@@ -0,0 +1,42 @@
+/* GARIL - Android RIL client library
+ * Copyright (C) 2016 You-Sheng Yang
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+typedef struct _GarilPendingTable GarilPendingTable;
+
+GarilPendingTable *_garil_pending_table_new (guint capacity);
+void _garil_pending_table_free (GarilPendingTable *table);
+
+gint32 _garil_pending_table_insert (GarilPendingTable *table,
+                                    gpointer           data);
+gpointer _garil_pending_table_lookup (GarilPendingTable *table,
+                                      gint32             serial);
+gpointer _garil_pending_table_remove (GarilPendingTable *table,
+                                      gint32             serial);
+void _garil_pending_table_steal_all (GarilPendingTable *table,
+                                     GFunc              func,
+                                     gpointer           user_data);
+
+guint _garil_pending_table_get_size (GarilPendingTable *table);
+guint _garil_pending_table_get_capacity (GarilPendingTable *table);
+
+G_END_DECLS
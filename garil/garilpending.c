@@ -0,0 +1,184 @@
+/* GARIL - Android RIL client library
+ * Copyright (C) 2016 You-Sheng Yang
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#if defined (HAVE_CONFIG_H)
+#include "config.h"
+#endif
+
+#include "garil/garilpending-private.h"
+
+/* Table of requests awaiting a response, keyed by RIL serial.
+ *
+ * The table hands out the serials itself, so it can pick them to suit its
+ * layout: entries live in a power-of-two array at index serial & mask, and a
+ * new serial is the next one in sequence whose slot is free. Lookups are a
+ * single index and compare, and inserts skip at most a few slots as long as
+ * the table is kept at most half full, which is what growing ensures.
+ * Growing moves every entry to serial & new_mask; entries never collide
+ * there, as distinct slots under the old mask stay distinct under a wider
+ * one.
+ *
+ * Serials run from 1 to G_MAXINT32 and wrap around; 0 marks a free slot. */
+
+/* Smallest capacity, must be a power of two. */
+#define MIN_CAPACITY 16
+
+typedef struct {
+  gint32 serial;
+  gpointer data;
+} Entry;
+
+struct _GarilPendingTable
+{
+  Entry *entries;
+  guint mask;
+  guint size;
+
+  gint32 next_serial;
+};
+
+static gint32
+next_serial (gint32 serial)
+{
+  return (serial == G_MAXINT32) ? 1 : (serial + 1);
+}
+
+GarilPendingTable*
+_garil_pending_table_new (guint capacity)
+{
+  guint n = MIN_CAPACITY;
+  while ((n < capacity) && (n <= (G_MAXINT32 / 4)))
+    n <<= 1;
+
+  GarilPendingTable *table = g_new0 (GarilPendingTable, 1);
+  table->entries = g_new0 (Entry, n);
+  table->mask = n - 1;
+  table->next_serial = 1;
+
+  return table;
+}
+
+void
+_garil_pending_table_free (GarilPendingTable *table)
+{
+  g_free (table->entries);
+  g_free (table);
+}
+
+static void
+grow (GarilPendingTable *table)
+{
+  const guint old_capacity = table->mask + 1;
+  Entry *old_entries = table->entries;
+
+  g_assert (old_capacity <= (G_MAXINT32 / 4));
+
+  table->mask = (old_capacity << 1) - 1;
+  table->entries = g_new0 (Entry, table->mask + 1);
+
+  for (guint i = 0; i < old_capacity; i++) {
+    const Entry *entry = &old_entries[i];
+    if (entry->serial)
+      table->entries[entry->serial & table->mask] = *entry;
+  }
+
+  g_free (old_entries);
+}
+
+/* Store @data under a newly allocated serial. Returns the serial, always
+ * positive. */
+gint32
+_garil_pending_table_insert (GarilPendingTable *table,
+                             gpointer           data)
+{
+  if ((table->size + 1) > ((table->mask + 1) / 2))
+    grow (table);
+
+  gint32 serial = table->next_serial;
+  while (table->entries[serial & table->mask].serial)
+    serial = next_serial (serial);
+
+  Entry *entry = &table->entries[serial & table->mask];
+  entry->serial = serial;
+  entry->data = data;
+  table->size++;
+  table->next_serial = next_serial (serial);
+
+  return serial;
+}
+
+gpointer
+_garil_pending_table_lookup (GarilPendingTable *table,
+                             gint32             serial)
+{
+  const Entry *entry = &table->entries[serial & table->mask];
+
+  return ((serial > 0) && (entry->serial == serial)) ? entry->data : NULL;
+}
+
+/* Returns the data stored under @serial, or %NULL if there is none. */
+gpointer
+_garil_pending_table_remove (GarilPendingTable *table,
+                             gint32             serial)
+{
+  Entry *entry = &table->entries[serial & table->mask];
+  if ((serial <= 0) || (entry->serial != serial))
+    return NULL;
+
+  gpointer data = entry->data;
+  entry->serial = 0;
+  entry->data = NULL;
+  table->size--;
+
+  return data;
+}
+
+/* Empty the table, then call @func for the data of every former entry. @func
+ * may insert into the table again. */
+void
+_garil_pending_table_steal_all (GarilPendingTable *table,
+                                GFunc              func,
+                                gpointer           user_data)
+{
+  if (table->size == 0)
+    return;
+
+  const guint capacity = table->mask + 1;
+  Entry *entries = table->entries;
+
+  table->entries = g_new0 (Entry, capacity);
+  table->size = 0;
+
+  for (guint i = 0; i < capacity; i++) {
+    if (entries[i].serial)
+      func (entries[i].data, user_data);
+  }
+
+  g_free (entries);
+}
+
+guint
+_garil_pending_table_get_size (GarilPendingTable *table)
+{
+  return table->size;
+}
+
+guint
+_garil_pending_table_get_capacity (GarilPendingTable *table)
+{
+  return table->mask + 1;
+}
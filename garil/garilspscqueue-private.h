@@ -0,0 +1,34 @@
+/* GARIL - Android RIL client library
+ * Copyright (C) 2016 You-Sheng Yang
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+typedef struct _GarilSpscQueue GarilSpscQueue;
+
+GarilSpscQueue *_garil_spsc_queue_new (void);
+void _garil_spsc_queue_free (GarilSpscQueue *queue,
+                             GDestroyNotify  free_func);
+
+void _garil_spsc_queue_push (GarilSpscQueue *queue,
+                             gpointer        data);
+gpointer _garil_spsc_queue_pop (GarilSpscQueue *queue);
+
+G_END_DECLS
@@ -0,0 +1,118 @@
+/* GARIL - Android RIL client library
+ * Copyright (C) 2016 You-Sheng Yang
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#if defined (HAVE_CONFIG_H)
+#include "config.h"
+#endif
+
+#include "garil/garilspscqueue-private.h"
+
+/* Unbounded lock-free queue for exactly one producer thread and one consumer
+ * thread.
+ *
+ * Items are stored in a chain of fixed-size segments. The producer fills the
+ * slots of the last segment in order and links a new segment once it is
+ * full; the consumer empties the first segment in order and frees it once it
+ * moved on to the next. A slot is published by storing a non-%NULL pointer
+ * into it, and a segment by storing its address into the next pointer of the
+ * previous one, so neither side ever waits for the other, and a push or pop
+ * only allocates or frees memory once per SEGMENT_SIZE items. */
+
+#define SEGMENT_SIZE 256
+
+typedef struct _Segment Segment;
+
+struct _Segment
+{
+  gpointer slots[SEGMENT_SIZE];
+  Segment *next;
+};
+
+struct _GarilSpscQueue
+{
+  /* Consumer side */
+  Segment *head;
+  guint head_index;
+
+  /* Producer side */
+  Segment *tail;
+  guint tail_index;
+};
+
+GarilSpscQueue*
+_garil_spsc_queue_new (void)
+{
+  GarilSpscQueue *queue = g_new0 (GarilSpscQueue, 1);
+  queue->head = queue->tail = g_new0 (Segment, 1);
+
+  return queue;
+}
+
+/* Neither side may be using @queue any more. */
+void
+_garil_spsc_queue_free (GarilSpscQueue *queue,
+                        GDestroyNotify  free_func)
+{
+  gpointer data;
+  while ((data = _garil_spsc_queue_pop (queue)) != NULL) {
+    if (free_func != NULL)
+      free_func (data);
+  }
+
+  g_free (queue->head);
+  g_free (queue);
+}
+
+/* Append @data, which must not be %NULL. Producer side only. */
+void
+_garil_spsc_queue_push (GarilSpscQueue *queue,
+                        gpointer        data)
+{
+  g_assert (data != NULL);
+
+  if (queue->tail_index == SEGMENT_SIZE) {
+    Segment *segment = g_new0 (Segment, 1);
+    g_atomic_pointer_set (&queue->tail->next, segment);
+    queue->tail = segment;
+    queue->tail_index = 0;
+  }
+
+  g_atomic_pointer_set (&queue->tail->slots[queue->tail_index], data);
+  queue->tail_index++;
+}
+
+/* Remove the first item. Returns %NULL if the queue is empty. Consumer side
+ * only. */
+gpointer
+_garil_spsc_queue_pop (GarilSpscQueue *queue)
+{
+  if (queue->head_index == SEGMENT_SIZE) {
+    Segment *next = g_atomic_pointer_get (&queue->head->next);
+    if (next == NULL)
+      return NULL;
+
+    g_free (queue->head);
+    queue->head = next;
+    queue->head_index = 0;
+  }
+
+  gpointer data = g_atomic_pointer_get (&queue->head->slots[queue->head_index]);
+  if (data != NULL)
+    queue->head_index++;
+
+  return data;
+}
@@ -0,0 +1,55 @@
+/* GARIL - Android RIL client library
+ * Copyright (C) 2016 You-Sheng Yang
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+typedef struct _GarilTimerWheel GarilTimerWheel;
+typedef struct _GarilTimer GarilTimer;
+
+/* A timer embedded in its owner. Zero-initialized timers are inactive. */
+struct _GarilTimer
+{
+  gpointer data;
+
+  /*< private >*/
+  GarilTimer *next;
+  GarilTimer **pprev;
+  gint64 expires;
+  guint slot;
+};
+
+GarilTimerWheel *_garil_timer_wheel_new (gint64 now);
+void _garil_timer_wheel_free (GarilTimerWheel *wheel);
+
+void _garil_timer_wheel_add (GarilTimerWheel *wheel,
+                             GarilTimer      *timer,
+                             gint64           deadline);
+void _garil_timer_wheel_remove (GarilTimerWheel *wheel,
+                                GarilTimer      *timer);
+GarilTimer *_garil_timer_wheel_pop_expired (GarilTimerWheel *wheel,
+                                            gint64           now);
+
+gint64 _garil_timer_wheel_get_next_deadline (GarilTimerWheel *wheel);
+guint _garil_timer_wheel_get_size (GarilTimerWheel *wheel);
+
+gboolean _garil_timer_is_active (const GarilTimer *timer);
+
+G_END_DECLS
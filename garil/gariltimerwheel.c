@@ -0,0 +1,284 @@
+/* GARIL - Android RIL client library
+ * Copyright (C) 2016 You-Sheng Yang
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#if defined (HAVE_CONFIG_H)
+#include "config.h"
+#endif
+
+#include "garil/gariltimerwheel-private.h"
+
+/* Hierarchical timer wheel tracking deadlines on the monotonic clock.
+ *
+ * Deadlines are rounded up to ticks of TICK microseconds. Level 0 has a slot
+ * per tick for the next N_SLOTS ticks, and every level above has slots
+ * N_SLOTS times as wide. A timer is put in the lowest level whose range
+ * covers it, at the slot its expiry tick falls in. Whenever the wheel reaches
+ * the start of a slot above level 0, the timers in it are cascaded, i.e. put
+ * in again, which moves them down a level or more. Timers in the level 0 slot
+ * of the tick reached have expired. Adding and removing timers is O(1), and
+ * so is expiring one, but for the cascades it went through on the way down.
+ *
+ * Occupancy bitmaps let the wheel jump over empty slots, so idle stretches
+ * cost nothing however long they are. Deadlines beyond the top level are
+ * parked in its furthest slot and cascaded back up until they are in range.
+ *
+ * Timers are intrusive and singly-headed doubly-linked, so that the owner
+ * needs no allocation and removal needs no search. */
+
+#define TICK (G_USEC_PER_SEC / 1000)
+
+#define SLOT_BITS 5
+#define N_SLOTS (1 << SLOT_BITS)
+#define SLOT_MASK (N_SLOTS - 1)
+#define N_LEVELS 6
+
+/* Furthest expiry ahead of the current tick the levels can hold. */
+#define MAX_DELTA (((gint64) 1 << (N_LEVELS * SLOT_BITS)) - 1)
+
+/* GarilTimer::slot of expired timers. */
+#define EXPIRED_SLOT (N_LEVELS * N_SLOTS)
+
+G_STATIC_ASSERT (N_SLOTS <= 32);
+
+struct _GarilTimerWheel
+{
+  /* Next tick to process; the ones before have been. */
+  gint64 current;
+  guint size;
+
+  guint32 occupied[N_LEVELS];
+  GarilTimer *slots[N_LEVELS][N_SLOTS];
+  GarilTimer *expired;
+};
+
+static void
+timer_link (GarilTimer **head,
+            GarilTimer  *timer)
+{
+  timer->next = *head;
+  if (timer->next != NULL)
+    timer->next->pprev = &timer->next;
+  *head = timer;
+  timer->pprev = head;
+}
+
+static void
+timer_unlink (GarilTimerWheel *wheel,
+              GarilTimer      *timer)
+{
+  *timer->pprev = timer->next;
+  if (timer->next != NULL)
+    timer->next->pprev = timer->pprev;
+  timer->next = NULL;
+  timer->pprev = NULL;
+
+  if (timer->slot != EXPIRED_SLOT) {
+    const guint level = timer->slot / N_SLOTS;
+    const guint index = timer->slot % N_SLOTS;
+    if (wheel->slots[level][index] == NULL)
+      wheel->occupied[level] &= ~(1u << index);
+  }
+}
+
+/* Put @timer in the slot it belongs to as of the current tick. */
+static void
+timer_place (GarilTimerWheel *wheel,
+             GarilTimer      *timer)
+{
+  if (timer->expires < wheel->current) {
+    timer->slot = EXPIRED_SLOT;
+    timer_link (&wheel->expired, timer);
+    return;
+  }
+
+  const gint64 expires = MIN (timer->expires, wheel->current + MAX_DELTA);
+  const gint64 delta = expires - wheel->current;
+  guint level = 0;
+  while (delta >> ((level + 1) * SLOT_BITS))
+    level++;
+
+  /* The slot starts after the current tick, or delta would have fit a lower
+   * level, and wraps around no earlier than @expires, or delta would have
+   * needed a higher one. */
+  const guint index = (expires >> (level * SLOT_BITS)) & SLOT_MASK;
+  timer->slot = level * N_SLOTS + index;
+  timer_link (&wheel->slots[level][index], timer);
+  wheel->occupied[level] |= 1u << index;
+}
+
+/* Distance from slot @start to the next occupied one, wrapping around, or -1
+ * if there is none. */
+static gint
+next_occupied (guint32 occupied,
+               guint   start)
+{
+  if (occupied == 0)
+    return -1;
+
+  const guint32 rotated =
+    start ? ((occupied >> start) | (occupied << (N_SLOTS - start))) : occupied;
+  return g_bit_nth_lsf (rotated, -1);
+}
+
+/* First tick from the current one on that expires or cascades timers, or
+ * G_MAXINT64 if the wheel is empty. */
+static gint64
+next_event (GarilTimerWheel *wheel)
+{
+  gint64 next = G_MAXINT64;
+
+  const gint distance =
+    next_occupied (wheel->occupied[0], wheel->current & SLOT_MASK);
+  if (distance >= 0)
+    next = wheel->current + distance;
+
+  for (guint level = 1; level < N_LEVELS; level++) {
+    const guint shift = level * SLOT_BITS;
+    /* Start of the first slot at this level not yet cascaded. */
+    const gint64 start =
+      (wheel->current + ((gint64) 1 << shift) - 1) >> shift;
+    const gint distance =
+      next_occupied (wheel->occupied[level], start & SLOT_MASK);
+    if (distance >= 0)
+      next = MIN (next, (start + distance) << shift);
+  }
+
+  return next;
+}
+
+static void
+process_tick (GarilTimerWheel *wheel)
+{
+  const gint64 tick = wheel->current;
+
+  for (guint level = 1; level < N_LEVELS; level++) {
+    const guint shift = level * SLOT_BITS;
+    if (tick & (((gint64) 1 << shift) - 1))
+      break;
+
+    GarilTimer **slot = &wheel->slots[level][(tick >> shift) & SLOT_MASK];
+    GarilTimer *timer;
+    while ((timer = *slot) != NULL) {
+      timer_unlink (wheel, timer);
+      timer_place (wheel, timer);
+    }
+  }
+
+  GarilTimer **slot = &wheel->slots[0][tick & SLOT_MASK];
+  GarilTimer *timer;
+  while ((timer = *slot) != NULL) {
+    timer_unlink (wheel, timer);
+    timer->slot = EXPIRED_SLOT;
+    timer_link (&wheel->expired, timer);
+  }
+
+  wheel->current++;
+}
+
+GarilTimerWheel*
+_garil_timer_wheel_new (gint64 now)
+{
+  GarilTimerWheel *wheel = g_new0 (GarilTimerWheel, 1);
+  wheel->current = MAX (now, 0) / TICK;
+
+  return wheel;
+}
+
+/* Timers still in the wheel are left dangling. */
+void
+_garil_timer_wheel_free (GarilTimerWheel *wheel)
+{
+  g_free (wheel);
+}
+
+/* Arm @timer to expire once the monotonic clock reaches @deadline. */
+void
+_garil_timer_wheel_add (GarilTimerWheel *wheel,
+                        GarilTimer      *timer,
+                        gint64           deadline)
+{
+  g_return_if_fail (!_garil_timer_is_active (timer));
+
+  timer->expires = (MAX (deadline, 0) + TICK - 1) / TICK;
+  timer_place (wheel, timer);
+  wheel->size++;
+}
+
+void
+_garil_timer_wheel_remove (GarilTimerWheel *wheel,
+                           GarilTimer      *timer)
+{
+  g_return_if_fail (_garil_timer_is_active (timer));
+
+  timer_unlink (wheel, timer);
+  wheel->size--;
+}
+
+/* Returns a timer whose deadline is not after @now and removes it from the
+ * wheel, or returns %NULL if there is none. Timers are returned in order of
+ * their deadlines rounded up to ticks, but for ones that were added with a
+ * deadline already passed, which come first. */
+GarilTimer*
+_garil_timer_wheel_pop_expired (GarilTimerWheel *wheel,
+                                gint64           now)
+{
+  const gint64 tick = MAX (now, 0) / TICK;
+
+  while ((wheel->expired == NULL) && (wheel->current <= tick)) {
+    const gint64 next = next_event (wheel);
+    if (next > tick) {
+      wheel->current = tick + 1;
+      break;
+    }
+
+    wheel->current = next;
+    process_tick (wheel);
+  }
+
+  GarilTimer *timer = wheel->expired;
+  if (timer != NULL) {
+    timer_unlink (wheel, timer);
+    wheel->size--;
+  }
+
+  return timer;
+}
+
+/* Returns the time _garil_timer_wheel_pop_expired() should be called again
+ * at, 0 if timers have already expired, or -1 if the wheel is empty. The
+ * time may come before any timer expires, to cascade timers due later. */
+gint64
+_garil_timer_wheel_get_next_deadline (GarilTimerWheel *wheel)
+{
+  if (wheel->expired != NULL)
+    return 0;
+
+  const gint64 next = next_event (wheel);
+  return (next == G_MAXINT64) ? -1 : (next * TICK);
+}
+
+guint
+_garil_timer_wheel_get_size (GarilTimerWheel *wheel)
+{
+  return wheel->size;
+}
+
+gboolean
+_garil_timer_is_active (const GarilTimer *timer)
+{
+  return timer->pprev != NULL;
+}
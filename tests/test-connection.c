@@ -24,6 +24,7 @@
 #include <glib/gstdio.h>
 
 #if defined (G_OS_UNIX)
+# include <sys/socket.h>
 # include <gio/gunixsocketaddress.h>
 #endif
 
@@ -358,6 +359,197 @@ test_new_for_address_3 (void)
 #endif
 }
 
+typedef struct {
+  GMainLoop *loop;
+  guint n_pending;
+} TestContext3;
+
+static void
+on_test_new_for_address_ready_4 (GObject      *source_object,
+                                 GAsyncResult *res,
+                                 gpointer      user_data)
+{
+  TestContext3 *context = user_data;
+  GError *error = NULL;
+
+  g_assert_true (g_async_initable_init_finish (G_ASYNC_INITABLE (source_object),
+                                               res, &error));
+  g_assert_no_error (error);
+
+  if (--context->n_pending == 0)
+    g_main_loop_quit (context->loop);
+}
+
+/* Initializations started while connecting join the one in progress, and
+ * initialization after completion returns the cached result. */
+static void
+test_new_for_address_4 (gconstpointer user_data)
+{
+  GSocketAddress *address = (GSocketAddress*)user_data;
+  TestContext3 context = { g_main_loop_new (NULL, FALSE), 2 };
+
+  GarilConnection *connection =
+    g_object_new (GARIL_TYPE_CONNECTION,
+                  GARIL_CONNECTION_PROP_ADDRESS, address,
+                  GARIL_CONNECTION_PROP_FLAGS,
+                  GARIL_CONNECTION_FLAGS_DELAY_MESSAGE_PROCESSING,
+                  NULL);
+  g_async_initable_init_async (G_ASYNC_INITABLE (connection),
+                               G_PRIORITY_DEFAULT, NULL,
+                               on_test_new_for_address_ready_4, &context);
+  g_async_initable_init_async (G_ASYNC_INITABLE (connection),
+                               G_PRIORITY_DEFAULT, NULL,
+                               on_test_new_for_address_ready_4, &context);
+  g_main_loop_run (context.loop);
+
+  check_stream_address_flags (connection, NULL, address);
+  GIOStream *stream = garil_connection_get_stream (connection);
+
+  GError *error = NULL;
+  g_assert_true (g_initable_init (G_INITABLE (connection), NULL, &error));
+  g_assert_no_error (error);
+  g_assert_true (garil_connection_get_stream (connection) == stream);
+
+  g_object_unref (connection);
+  g_main_loop_unref (context.loop);
+}
+
+#if defined (G_OS_UNIX)
+#define N_BATCH_ADDRESSES 7
+
+typedef struct {
+  GMainLoop *loop;
+  guint n_ready[N_BATCH_ADDRESSES];
+  GError *errors[N_BATCH_ADDRESSES];
+  GarilConnectionStats stats;
+  GError *error;
+} TestContext4;
+
+static void
+on_test_new_for_addresses_connection (GarilConnection *connection,
+                                      GSocketAddress  *address,
+                                      guint            index,
+                                      const GError    *error,
+                                      gpointer         user_data)
+{
+  TestContext4 *context = user_data;
+
+  g_assert_cmpuint (index, <, N_BATCH_ADDRESSES);
+  g_assert_true (G_IS_SOCKET_ADDRESS (address));
+  context->n_ready[index]++;
+
+  if (error != NULL) {
+    g_assert_null (connection);
+    context->errors[index] = g_error_copy (error);
+  } else {
+    g_assert_true (GARIL_IS_CONNECTION (connection));
+    check_stream_address_flags (connection, NULL, address);
+  }
+}
+
+static void
+on_test_new_for_addresses_ready (GObject      *source_object G_GNUC_UNUSED,
+                                 GAsyncResult *res,
+                                 gpointer      user_data)
+{
+  TestContext4 *context = user_data;
+
+  gboolean ret = garil_connection_new_for_addresses_finish (res,
+                                                            &context->stats,
+                                                            &context->error);
+  g_assert_true (ret == (context->error == NULL));
+
+  g_main_loop_quit (context->loop);
+}
+
+/* Connect to N_BATCH_ADDRESSES - 1 copies of address and one nonexistent
+ * address, max_parallel at a time, and check that each reports once. */
+static void
+test_new_for_addresses (GSocketAddress *address,
+                        guint           max_parallel,
+                        GCancellable   *cancellable,
+                        TestContext4   *context)
+{
+  GSocketAddress *addresses[N_BATCH_ADDRESSES];
+  for (guint i = 0; i < N_BATCH_ADDRESSES - 1; i++)
+    addresses[i] = g_object_ref (address);
+  addresses[N_BATCH_ADDRESSES - 1] = g_unix_socket_address_new ("/nonexist");
+
+  context->loop = g_main_loop_new (NULL, FALSE);
+  garil_connection_new_for_addresses (addresses, N_BATCH_ADDRESSES,
+                                      max_parallel,
+                                      GARIL_CONNECTION_FLAGS_DELAY_MESSAGE_PROCESSING,
+                                      cancellable,
+                                      on_test_new_for_addresses_connection,
+                                      context,
+                                      on_test_new_for_addresses_ready,
+                                      context);
+  g_main_loop_run (context->loop);
+  g_main_loop_unref (context->loop);
+
+  for (guint i = 0; i < N_BATCH_ADDRESSES; i++) {
+    g_assert_cmpuint (context->n_ready[i], ==, 1);
+    g_object_unref (addresses[i]);
+  }
+
+  const GarilConnectionStats *stats = &context->stats;
+  g_assert_cmpuint (stats->n_connected + stats->n_failed,
+                    ==, N_BATCH_ADDRESSES);
+  g_assert_cmpint (stats->min_latency, >=, 0);
+  g_assert_cmpint (stats->min_latency, <=, stats->mean_latency);
+  g_assert_cmpint (stats->mean_latency, <=, stats->max_latency);
+  g_assert_cmpint (stats->max_latency, <=, stats->elapsed);
+}
+
+static void
+clear_test_new_for_addresses (TestContext4 *context)
+{
+  for (guint i = 0; i < N_BATCH_ADDRESSES; i++)
+    g_clear_error (&context->errors[i]);
+  g_clear_error (&context->error);
+}
+
+static void
+test_new_for_addresses_1 (gconstpointer user_data)
+{
+  GSocketAddress *address = (GSocketAddress*)user_data;
+  TestContext4 context = { 0 };
+
+  test_new_for_addresses (address, 2, NULL, &context);
+
+  g_assert_no_error (context.error);
+  g_assert_cmpuint (context.stats.n_connected, ==, N_BATCH_ADDRESSES - 1);
+  g_assert_cmpuint (context.stats.n_failed, ==, 1);
+  for (guint i = 0; i < N_BATCH_ADDRESSES - 1; i++)
+    g_assert_no_error (context.errors[i]);
+  g_assert_error (context.errors[N_BATCH_ADDRESSES - 1],
+                  G_IO_ERROR, G_IO_ERROR_NOT_FOUND);
+
+  clear_test_new_for_addresses (&context);
+}
+
+static void
+test_new_for_addresses_2 (gconstpointer user_data)
+{
+  GSocketAddress *address = (GSocketAddress*)user_data;
+  TestContext4 context = { 0 };
+
+  GCancellable *cancellable = g_cancellable_new ();
+  g_cancellable_cancel (cancellable);
+
+  test_new_for_addresses (address, 0, cancellable, &context);
+
+  g_assert_error (context.error, G_IO_ERROR, G_IO_ERROR_CANCELLED);
+  g_assert_cmpuint (context.stats.n_connected, ==, 0);
+  g_assert_cmpuint (context.stats.n_failed, ==, N_BATCH_ADDRESSES);
+  for (guint i = 0; i < N_BATCH_ADDRESSES; i++)
+    g_assert_error (context.errors[i], G_IO_ERROR, G_IO_ERROR_CANCELLED);
+
+  clear_test_new_for_addresses (&context);
+  g_object_unref (cancellable);
+}
+#endif /* G_OS_UNIX */
+
 static void
 test_new_for_address_sync_1 (gconstpointer user_data)
 {
@@ -395,6 +587,1302 @@ test_new_for_address_sync_2 (gconstpointer user_data)
   g_object_unref (cancellable);
 }
 
+#if defined (G_OS_UNIX)
+/* Create a connection over one end of a socket pair. The other end is
+ * returned in @peer. If @ostream is given, it replaces the output stream of
+ * the connection. */
+static GarilConnection*
+new_socket_pair_connection_full (GSocket              **peer,
+                                 GOutputStream         *ostream,
+                                 GarilConnectionFlags   flags)
+{
+  int fds[2];
+  g_assert_cmpint (socketpair (AF_UNIX, SOCK_STREAM, 0, fds), ==, 0);
+
+  GError *error = NULL;
+  GSocket *socket = g_socket_new_from_fd (fds[0], &error);
+  g_assert_no_error (error);
+  *peer = g_socket_new_from_fd (fds[1], &error);
+  g_assert_no_error (error);
+
+  GIOStream *stream =
+    G_IO_STREAM (g_socket_connection_factory_create_connection (socket));
+  g_object_unref (socket);
+  if (ostream != NULL) {
+    GIOStream *simple =
+      g_simple_io_stream_new (g_io_stream_get_input_stream (stream), ostream);
+    g_object_unref (stream);
+    stream = simple;
+  }
+
+  GarilConnection *connection =
+    garil_connection_new_sync (stream, flags, NULL, &error);
+  g_assert_no_error (error);
+  g_object_unref (stream);
+
+  return connection;
+}
+
+static GarilConnection*
+new_socket_pair_connection (GSocket       **peer,
+                            GOutputStream  *ostream)
+{
+  return new_socket_pair_connection_full (peer, ostream,
+                                          GARIL_CONNECTION_FLAGS_NONE);
+}
+
+/* Run the default main context until @peer received @len bytes. */
+static GByteArray*
+receive_from_peer (GSocket *peer,
+                   gsize    len)
+{
+  GByteArray *array = g_byte_array_sized_new (len);
+  const gint64 deadline = g_get_monotonic_time () + 5 * G_USEC_PER_SEC;
+
+  while (array->len < len) {
+    g_assert_cmpint (g_get_monotonic_time (), <, deadline);
+
+    while (g_main_context_iteration (NULL, FALSE));
+
+    if (!(g_socket_condition_check (peer, G_IO_IN) & G_IO_IN)) {
+      g_usleep (1000);
+      continue;
+    }
+
+    guint8 buffer[4096];
+    GError *error = NULL;
+    const gssize n =
+      g_socket_receive (peer, (gchar *) buffer,
+                        MIN (sizeof (buffer), len - array->len), NULL, &error);
+    g_assert_no_error (error);
+    g_assert_cmpint (n, >, 0);
+    g_byte_array_append (array, buffer, n);
+  }
+
+  return array;
+}
+
+#define N_SEND_PARCELS 24
+
+static void
+send_parcels (GarilConnection *connection)
+{
+  for (gint32 i = 0; i < N_SEND_PARCELS; i++) {
+    GarilParcel *parcel = garil_parcel_new (NULL);
+    garil_parcel_write_int32 (parcel, i);
+    garil_connection_send_parcel (connection, parcel);
+    garil_parcel_unref (parcel);
+  }
+}
+
+static void
+check_sent_parcels (const guint8 *data,
+                    gsize         len)
+{
+  g_assert_cmpuint (len, ==, N_SEND_PARCELS * 8);
+
+  for (gint32 i = 0; i < N_SEND_PARCELS; i++, data += 8) {
+    static const guint8 prefix[] = { 0x00, 0x00, 0x00, 0x04 };
+    const gint32 value = GINT32_TO_LE (i);
+    g_assert_cmpmem (data, 4, prefix, sizeof (prefix));
+    g_assert_cmpmem (data + 4, 4, &value, sizeof (value));
+  }
+}
+
+/* Many parcels queued at once */
+static void
+test_send_parcel_1 (void)
+{
+  GSocket *peer;
+  GarilConnection *connection = new_socket_pair_connection (&peer, NULL);
+
+  send_parcels (connection);
+
+  GByteArray *array = receive_from_peer (peer, N_SEND_PARCELS * 8);
+  check_sent_parcels (array->data, array->len);
+
+  g_byte_array_unref (array);
+  g_object_unref (connection);
+  g_object_unref (peer);
+}
+
+/* Segmented parcels */
+static void
+test_send_parcel_2 (void)
+{
+  static const guint8 expected[] = {
+    0x00, 0x00, 0x00, 0x10,
+    0x01, 0x00, 0x00, 0x00, 0x02, 0x00, 0x00, 0x00,
+    0x03, 0x00, 0x00, 0x00, 0x04, 0x00, 0x00, 0x00,
+  };
+
+  GSocket *peer;
+  GarilConnection *connection = new_socket_pair_connection (&peer, NULL);
+
+  GarilParcel *parcel = garil_parcel_new_segmented (8);
+  for (gint32 i = 1; i <= 4; i++)
+    garil_parcel_write_int32 (parcel, i);
+  g_assert_cmpuint (garil_parcel_get_vectors (parcel, NULL, 0), ==, 2);
+
+  garil_connection_send_parcel (connection, parcel);
+  garil_parcel_unref (parcel);
+
+  GByteArray *array = receive_from_peer (peer, sizeof (expected));
+  g_assert_cmpmem (array->data, array->len, expected, sizeof (expected));
+
+  g_byte_array_unref (array);
+  g_object_unref (connection);
+  g_object_unref (peer);
+}
+
+/* Streams other than sockets */
+static void
+test_send_parcel_3 (void)
+{
+  GOutputStream *ostream = g_memory_output_stream_new_resizable ();
+  GSocket *peer;
+  GarilConnection *connection = new_socket_pair_connection (&peer, ostream);
+
+  send_parcels (connection);
+
+  GMemoryOutputStream *memory = G_MEMORY_OUTPUT_STREAM (ostream);
+  const gint64 deadline = g_get_monotonic_time () + 5 * G_USEC_PER_SEC;
+  while (g_memory_output_stream_get_data_size (memory) < N_SEND_PARCELS * 8) {
+    g_assert_cmpint (g_get_monotonic_time (), <, deadline);
+    g_main_context_iteration (NULL, TRUE);
+  }
+  check_sent_parcels (g_memory_output_stream_get_data (memory),
+                      g_memory_output_stream_get_data_size (memory));
+
+  g_object_unref (connection);
+  g_object_unref (peer);
+  g_object_unref (ostream);
+}
+
+static void
+on_notify (GObject    *object G_GNUC_UNUSED,
+           GParamSpec *pspec G_GNUC_UNUSED,
+           gpointer    user_data)
+{
+  guint *count = user_data;
+  (*count)++;
+}
+
+/* Property */
+static void
+test_coalescing_window_1 (void)
+{
+  GSocket *peer;
+  GarilConnection *connection = new_socket_pair_connection (&peer, NULL);
+  guint count = 0;
+
+  g_assert_cmpuint (garil_connection_get_coalescing_window (connection), ==,
+                    0);
+  g_signal_connect (connection,
+                    "notify::" GARIL_CONNECTION_PROP_COALESCING_WINDOW,
+                    G_CALLBACK (on_notify), &count);
+
+  garil_connection_set_coalescing_window (connection, 500);
+  garil_connection_set_coalescing_window (connection, 500);
+  g_assert_cmpuint (count, ==, 1);
+
+  guint window = 0;
+  g_object_get (connection, GARIL_CONNECTION_PROP_COALESCING_WINDOW, &window,
+                NULL);
+  g_assert_cmpuint (window, ==, 500);
+
+  g_object_unref (connection);
+  g_object_unref (peer);
+}
+
+/* Frames are held back for the window */
+static void
+test_coalescing_window_2 (void)
+{
+  GSocket *peer;
+  GarilConnection *connection = new_socket_pair_connection (&peer, NULL);
+  garil_connection_set_coalescing_window (connection, G_USEC_PER_SEC);
+
+  const gint64 start = g_get_monotonic_time ();
+  send_parcels (connection);
+
+  while (g_main_context_iteration (NULL, FALSE));
+  if ((g_get_monotonic_time () - start) < G_USEC_PER_SEC)
+    g_assert_false (g_socket_condition_check (peer, G_IO_IN) & G_IO_IN);
+
+  GByteArray *array = receive_from_peer (peer, N_SEND_PARCELS * 8);
+  g_assert_cmpint (g_get_monotonic_time () - start, >=, G_USEC_PER_SEC);
+  check_sent_parcels (array->data, array->len);
+
+  g_byte_array_unref (array);
+  g_object_unref (connection);
+  g_object_unref (peer);
+}
+/* Read a request frame with an int32 payload from @peer. */
+static gint32
+peer_receive_request (GSocket *peer,
+                      gint32  *serial)
+{
+  GByteArray *array = receive_from_peer (peer, 16);
+  guint32 words[4];
+  memcpy (words, array->data, sizeof (words));
+  g_byte_array_unref (array);
+
+  g_assert_cmpuint (GUINT32_FROM_BE (words[0]), ==, 12);
+  *serial = GINT32_FROM_LE (words[2]);
+  g_assert_cmpint (GINT32_FROM_LE (words[3]), ==,
+                   GINT32_FROM_LE (words[1]) * 10);
+
+  return GINT32_FROM_LE (words[1]);
+}
+
+static void
+append_response (GByteArray *array,
+                 gint32      serial,
+                 gint32      ril_error,
+                 gint32      value)
+{
+  const guint32 words[] = {
+    GUINT32_TO_BE (16),
+    GINT32_TO_LE (0),
+    GINT32_TO_LE (serial),
+    GINT32_TO_LE (ril_error),
+    GINT32_TO_LE (value),
+  };
+
+  g_byte_array_append (array, (const guint8 *) words, sizeof (words));
+}
+
+static void
+send_from_peer (GSocket    *peer,
+                GByteArray *array)
+{
+  for (gsize offset = 0; offset < array->len;) {
+    GError *error = NULL;
+    const gssize n =
+      g_socket_send (peer, (const gchar *) array->data + offset,
+                     array->len - offset, NULL, &error);
+    g_assert_no_error (error);
+    offset += n;
+  }
+
+  g_byte_array_unref (array);
+}
+
+static void
+peer_send_response (GSocket *peer,
+                    gint32   serial,
+                    gint32   ril_error,
+                    gint32   value)
+{
+  GByteArray *array = g_byte_array_new ();
+  append_response (array, serial, ril_error, value);
+  send_from_peer (peer, array);
+}
+
+typedef struct {
+  guint n_done;
+  gint32 ril_error;
+  gint32 value;
+  GError *error;
+} Response;
+
+static void
+on_response (GObject      *source_object,
+             GAsyncResult *res,
+             gpointer      user_data)
+{
+  Response *response = user_data;
+
+  GarilParcel *parcel =
+    garil_connection_send_request_finish (GARIL_CONNECTION (source_object),
+                                          res, &response->ril_error,
+                                          &response->error);
+  if (parcel != NULL) {
+    response->value = garil_parcel_read_int32 (parcel);
+    g_assert_false (garil_parcel_is_malformed (parcel));
+    garil_parcel_unref (parcel);
+  }
+
+  response->n_done++;
+}
+
+static void
+send_request_full (GarilConnection      *connection,
+                   gint32                request,
+                   GarilRequestPriority  priority,
+                   GCancellable         *cancellable,
+                   Response             *response)
+{
+  GarilParcel *payload = garil_parcel_new (NULL);
+  garil_parcel_write_int32 (payload, request * 10);
+  garil_connection_send_request (connection, request, payload, priority,
+                                 cancellable, on_response, response);
+  garil_parcel_unref (payload);
+}
+
+static void
+send_request (GarilConnection *connection,
+              gint32           request,
+              GCancellable    *cancellable,
+              Response        *response)
+{
+  send_request_full (connection, request, GARIL_REQUEST_PRIORITY_NORMAL,
+                     cancellable, response);
+}
+
+static void
+wait_for_responses (Response *responses,
+                    guint     n)
+{
+  const gint64 deadline = g_get_monotonic_time () + 5 * G_USEC_PER_SEC;
+
+  for (guint i = 0; i < n; i++) {
+    while (responses[i].n_done == 0) {
+      g_assert_cmpint (g_get_monotonic_time (), <, deadline);
+      g_main_context_iteration (NULL, TRUE);
+    }
+    g_assert_cmpuint (responses[i].n_done, ==, 1);
+  }
+}
+
+/* Responses are matched by serial, in any order */
+static void
+test_send_request_1 (void)
+{
+  GSocket *peer;
+  GarilConnection *connection = new_socket_pair_connection (&peer, NULL);
+  Response responses[3] = { { 0, }, };
+
+  for (gint32 i = 0; i < 3; i++)
+    send_request (connection, i + 1, NULL, &responses[i]);
+
+  gint32 serials[3];
+  for (gint32 i = 0; i < 3; i++)
+    g_assert_cmpint (peer_receive_request (peer, &serials[i]), ==, i + 1);
+  g_assert_cmpint (serials[0], !=, serials[1]);
+  g_assert_cmpint (serials[1], !=, serials[2]);
+
+  /* Unknown serials are dropped. */
+  peer_send_response (peer, serials[2] + 100, 0, 0);
+  peer_send_response (peer, serials[2], 0, 300);
+  peer_send_response (peer, serials[0], 0, 100);
+  peer_send_response (peer, serials[1], 2, 200);
+
+  wait_for_responses (responses, 3);
+  for (gint32 i = 0; i < 3; i++) {
+    g_assert_no_error (responses[i].error);
+    g_assert_cmpint (responses[i].value, ==, (i + 1) * 100);
+  }
+  g_assert_cmpint (responses[0].ril_error, ==, 0);
+  g_assert_cmpint (responses[1].ril_error, ==, 2);
+
+  g_object_unref (connection);
+  g_object_unref (peer);
+}
+
+/* Thousands in flight */
+static void
+test_send_request_2 (void)
+{
+  GSocket *peer;
+  GarilConnection *connection = new_socket_pair_connection (&peer, NULL);
+  const guint n = 2000;
+  Response *responses = g_new0 (Response, n);
+
+  for (guint i = 0; i < n; i++)
+    send_request (connection, i, NULL, &responses[i]);
+
+  gint32 *serials = g_new (gint32, n);
+  for (guint i = 0; i < n; i++)
+    g_assert_cmpint (peer_receive_request (peer, &serials[i]), ==, i);
+  /* One write, as small writes would fill the socket buffer long before the
+   * connection gets to read them. */
+  GByteArray *array = g_byte_array_new ();
+  for (guint i = n; i > 0; i--)
+    append_response (array, serials[i - 1], 0, i - 1);
+  send_from_peer (peer, array);
+
+  wait_for_responses (responses, n);
+  for (guint i = 0; i < n; i++) {
+    g_assert_no_error (responses[i].error);
+    g_assert_cmpint (responses[i].value, ==, i);
+  }
+
+  g_free (serials);
+  g_free (responses);
+  g_object_unref (connection);
+  g_object_unref (peer);
+}
+
+/* Cancellation */
+static void
+test_send_request_3 (void)
+{
+  GSocket *peer;
+  GarilConnection *connection = new_socket_pair_connection (&peer, NULL);
+  GCancellable *cancellable = g_cancellable_new ();
+  Response responses[2] = { { 0, }, };
+
+  send_request (connection, 1, cancellable, &responses[0]);
+  send_request (connection, 2, NULL, &responses[1]);
+
+  gint32 serials[2];
+  peer_receive_request (peer, &serials[0]);
+  peer_receive_request (peer, &serials[1]);
+
+  g_cancellable_cancel (cancellable);
+  wait_for_responses (responses, 1);
+  g_assert_error (responses[0].error, G_IO_ERROR, G_IO_ERROR_CANCELLED);
+
+  /* The late response is ignored. */
+  peer_send_response (peer, serials[0], 0, 100);
+  peer_send_response (peer, serials[1], 0, 200);
+  wait_for_responses (responses, 2);
+  g_assert_no_error (responses[1].error);
+  g_assert_cmpint (responses[1].value, ==, 200);
+
+  g_clear_error (&responses[0].error);
+  g_object_unref (cancellable);
+  g_object_unref (connection);
+  g_object_unref (peer);
+}
+
+/* Pending requests fail when the connection closes */
+static void
+test_send_request_4 (void)
+{
+  GSocket *peer;
+  GarilConnection *connection = new_socket_pair_connection (&peer, NULL);
+  Response responses[3] = { { 0, }, };
+
+  send_request (connection, 1, NULL, &responses[0]);
+  send_request (connection, 2, NULL, &responses[1]);
+
+  gint32 serial;
+  peer_receive_request (peer, &serial);
+  peer_receive_request (peer, &serial);
+  g_socket_close (peer, NULL);
+
+  wait_for_responses (responses, 2);
+  g_assert_error (responses[0].error, G_IO_ERROR,
+                  G_IO_ERROR_CONNECTION_CLOSED);
+  g_assert_error (responses[1].error, G_IO_ERROR,
+                  G_IO_ERROR_CONNECTION_CLOSED);
+
+  /* And new ones right away. */
+  send_request (connection, 3, NULL, &responses[2]);
+  wait_for_responses (responses, 3);
+  g_assert_error (responses[2].error, G_IO_ERROR, G_IO_ERROR_CLOSED);
+
+  for (guint i = 0; i < 3; i++)
+    g_clear_error (&responses[i].error);
+  g_object_unref (connection);
+  g_object_unref (peer);
+}
+
+/* The last reference to the connection may be held by pending requests,
+ * whether they get a response, are cancelled or fail on close. */
+static void
+test_send_request_5 (void)
+{
+  for (guint i = 0; i < 3; i++) {
+    GSocket *peer;
+    GarilConnection *connection = new_socket_pair_connection (&peer, NULL);
+    GCancellable *cancellable = g_cancellable_new ();
+    Response response = { 0, };
+
+    send_request (connection, 1, cancellable, &response);
+
+    gint32 serial;
+    peer_receive_request (peer, &serial);
+
+    g_object_add_weak_pointer (G_OBJECT (connection), (gpointer *) &connection);
+    g_object_unref (connection);
+    g_assert_nonnull (connection);
+
+    if (i == 0)
+      peer_send_response (peer, serial, 0, 100);
+    else if (i == 1)
+      g_cancellable_cancel (cancellable);
+    else
+      g_socket_close (peer, NULL);
+
+    wait_for_responses (&response, 1);
+    if (i == 0)
+      g_assert_no_error (response.error);
+    else if (i == 1)
+      g_assert_error (response.error, G_IO_ERROR, G_IO_ERROR_CANCELLED);
+    else
+      g_assert_error (response.error, G_IO_ERROR,
+                      G_IO_ERROR_CONNECTION_CLOSED);
+    g_assert_null (connection);
+
+    g_clear_error (&response.error);
+    g_object_unref (cancellable);
+    g_object_unref (peer);
+  }
+}
+
+/* Nothing more to read after the main context ran dry */
+static void
+assert_peer_idle (GSocket *peer)
+{
+  const gint64 deadline = g_get_monotonic_time () + G_USEC_PER_SEC / 20;
+  while (g_get_monotonic_time () < deadline)
+    g_main_context_iteration (NULL, FALSE);
+
+  g_assert_false (g_socket_condition_check (peer, G_IO_IN) & G_IO_IN);
+}
+
+/* Requests beyond the window wait, in order */
+static void
+test_max_in_flight_1 (void)
+{
+  GSocket *peer;
+  GarilConnection *connection = new_socket_pair_connection (&peer, NULL);
+  Response responses[5] = { { 0, }, };
+  gint32 serials[5];
+
+  g_assert_cmpuint (garil_connection_get_max_in_flight (connection), ==, 0);
+  g_object_set (connection, GARIL_CONNECTION_PROP_MAX_IN_FLIGHT, 2, NULL);
+  g_assert_cmpuint (garil_connection_get_max_in_flight (connection), ==, 2);
+
+  for (gint32 i = 0; i < 5; i++)
+    send_request (connection, i, NULL, &responses[i]);
+
+  g_assert_cmpint (peer_receive_request (peer, &serials[0]), ==, 0);
+  g_assert_cmpint (peer_receive_request (peer, &serials[1]), ==, 1);
+  assert_peer_idle (peer);
+
+  peer_send_response (peer, serials[1], 0, 1);
+  g_assert_cmpint (peer_receive_request (peer, &serials[2]), ==, 2);
+  assert_peer_idle (peer);
+
+  /* Raising the window sends the rest right away. */
+  garil_connection_set_max_in_flight (connection, 4);
+  g_assert_cmpint (peer_receive_request (peer, &serials[3]), ==, 3);
+  g_assert_cmpint (peer_receive_request (peer, &serials[4]), ==, 4);
+
+  GByteArray *array = g_byte_array_new ();
+  for (gint32 i = 0; i < 5; i++) {
+    if (i != 1)
+      append_response (array, serials[i], 0, i);
+  }
+  send_from_peer (peer, array);
+
+  wait_for_responses (responses, 5);
+  for (gint32 i = 0; i < 5; i++) {
+    g_assert_no_error (responses[i].error);
+    g_assert_cmpint (responses[i].value, ==, i);
+  }
+
+  g_object_unref (connection);
+  g_object_unref (peer);
+}
+
+/* Waiting requests can be cancelled, and fail on close */
+static void
+test_max_in_flight_2 (void)
+{
+  GSocket *peer;
+  GarilConnection *connection = new_socket_pair_connection (&peer, NULL);
+  GCancellable *cancellable = g_cancellable_new ();
+  Response responses[3] = { { 0, }, };
+  gint32 serial;
+
+  garil_connection_set_max_in_flight (connection, 1);
+  send_request (connection, 0, NULL, &responses[0]);
+  send_request (connection, 1, cancellable, &responses[1]);
+  send_request (connection, 2, NULL, &responses[2]);
+  g_assert_cmpint (peer_receive_request (peer, &serial), ==, 0);
+
+  g_cancellable_cancel (cancellable);
+  wait_for_responses (&responses[1], 1);
+  g_assert_error (responses[1].error, G_IO_ERROR, G_IO_ERROR_CANCELLED);
+  assert_peer_idle (peer);
+
+  g_socket_close (peer, NULL);
+  wait_for_responses (responses, 3);
+  g_assert_error (responses[0].error, G_IO_ERROR,
+                  G_IO_ERROR_CONNECTION_CLOSED);
+  g_assert_error (responses[2].error, G_IO_ERROR,
+                  G_IO_ERROR_CONNECTION_CLOSED);
+
+  for (guint i = 0; i < 3; i++)
+    g_clear_error (&responses[i].error);
+  g_object_unref (cancellable);
+  g_object_unref (connection);
+  g_object_unref (peer);
+}
+
+/* Requests and responses through the I/O thread */
+static void
+test_io_thread_1 (void)
+{
+  GSocket *peer;
+  GarilConnection *connection =
+    new_socket_pair_connection_full (&peer, NULL,
+                                     GARIL_CONNECTION_FLAGS_IO_THREAD);
+  const guint n = 2000;
+  Response *responses = g_new0 (Response, n);
+
+  for (guint i = 0; i < n; i++)
+    send_request (connection, i, NULL, &responses[i]);
+
+  gint32 *serials = g_new (gint32, n);
+  for (guint i = 0; i < n; i++)
+    g_assert_cmpint (peer_receive_request (peer, &serials[i]), ==, i);
+
+  GByteArray *array = g_byte_array_new ();
+  for (guint i = n; i > 0; i--)
+    append_response (array, serials[i - 1], 0, i - 1);
+  send_from_peer (peer, array);
+
+  wait_for_responses (responses, n);
+  for (guint i = 0; i < n; i++) {
+    g_assert_no_error (responses[i].error);
+    g_assert_cmpint (responses[i].value, ==, i);
+  }
+
+  g_free (serials);
+  g_free (responses);
+  g_object_unref (connection);
+  g_object_unref (peer);
+}
+
+/* The socket is drained while the main context doesn't run */
+static void
+test_io_thread_2 (void)
+{
+  GSocket *peer;
+  GarilConnection *connection =
+    new_socket_pair_connection_full (&peer, NULL,
+                                     GARIL_CONNECTION_FLAGS_IO_THREAD);
+  Response response = { 0, };
+
+  send_request (connection, 1, NULL, &response);
+  gint32 serial;
+  g_assert_cmpint (peer_receive_request (peer, &serial), ==, 1);
+
+  /* Way more unsolicited responses than the socket buffers hold. */
+  const guint32 unsolicited[] = {
+    GUINT32_TO_BE (8), GINT32_TO_LE (1), GINT32_TO_LE (1000),
+  };
+  GByteArray *array = g_byte_array_new ();
+  for (guint i = 0; i < 256 * 1024; i++)
+    g_byte_array_append (array, (const guint8 *) unsolicited,
+                         sizeof (unsolicited));
+  append_response (array, serial, 0, 100);
+  send_from_peer (peer, array);
+
+  wait_for_responses (&response, 1);
+  g_assert_no_error (response.error);
+  g_assert_cmpint (response.value, ==, 100);
+
+  g_object_unref (connection);
+  g_object_unref (peer);
+}
+
+/* Pending requests fail when the connection closes */
+static void
+test_io_thread_3 (void)
+{
+  GSocket *peer;
+  GarilConnection *connection =
+    new_socket_pair_connection_full (&peer, NULL,
+                                     GARIL_CONNECTION_FLAGS_IO_THREAD);
+  Response responses[3] = { { 0, }, };
+  gint32 serial;
+
+  send_request (connection, 1, NULL, &responses[0]);
+  send_request (connection, 2, NULL, &responses[1]);
+  g_assert_cmpint (peer_receive_request (peer, &serial), ==, 1);
+  g_assert_cmpint (peer_receive_request (peer, &serial), ==, 2);
+
+  /* The response before closing is still delivered. */
+  peer_send_response (peer, serial, 0, 200);
+  g_socket_close (peer, NULL);
+
+  wait_for_responses (responses, 2);
+  g_assert_error (responses[0].error, G_IO_ERROR,
+                  G_IO_ERROR_CONNECTION_CLOSED);
+  g_assert_no_error (responses[1].error);
+  g_assert_cmpint (responses[1].value, ==, 200);
+
+  send_request (connection, 3, NULL, &responses[2]);
+  wait_for_responses (responses, 3);
+  g_assert_error (responses[2].error, G_IO_ERROR, G_IO_ERROR_CLOSED);
+
+  for (guint i = 0; i < 3; i++)
+    g_clear_error (&responses[i].error);
+  g_object_unref (connection);
+  g_object_unref (peer);
+}
+
+/* Connections are disposed while the I/O thread is busy with traffic */
+static void
+test_io_thread_4 (void)
+{
+  for (guint i = 0; i < 200; i++) {
+    GSocket *peer;
+    GarilConnection *connection =
+      new_socket_pair_connection_full (&peer, NULL,
+                                       GARIL_CONNECTION_FLAGS_IO_THREAD);
+
+    const guint32 unsolicited[] = {
+      GUINT32_TO_BE (8), GINT32_TO_LE (1), GINT32_TO_LE (1000),
+    };
+    GByteArray *array = g_byte_array_new ();
+    for (guint j = 0; j < 256; j++)
+      g_byte_array_append (array, (const guint8 *) unsolicited,
+                           sizeof (unsolicited));
+    send_from_peer (peer, array);
+    send_parcels (connection);
+
+    g_object_unref (connection);
+    g_object_unref (peer);
+  }
+}
+
+/* Waiting requests are sent most urgent first */
+static void
+test_priority_1 (void)
+{
+  GSocket *peer;
+  GarilConnection *connection = new_socket_pair_connection (&peer, NULL);
+  Response responses[6] = { { 0, }, };
+  gint32 serial;
+
+  garil_connection_set_max_in_flight (connection, 1);
+  send_request (connection, 0, NULL, &responses[0]);
+  send_request_full (connection, 1, GARIL_REQUEST_PRIORITY_LOW, NULL,
+                     &responses[1]);
+  send_request_full (connection, 2, GARIL_REQUEST_PRIORITY_NORMAL, NULL,
+                     &responses[2]);
+  send_request_full (connection, 3, GARIL_REQUEST_PRIORITY_URGENT, NULL,
+                     &responses[3]);
+  send_request_full (connection, 4, GARIL_REQUEST_PRIORITY_HIGH, NULL,
+                     &responses[4]);
+  send_request_full (connection, 5, GARIL_REQUEST_PRIORITY_URGENT, NULL,
+                     &responses[5]);
+
+  static const gint32 order[] = { 0, 3, 5, 4, 2, 1 };
+  for (guint i = 0; i < G_N_ELEMENTS (order); i++) {
+    g_assert_cmpint (peer_receive_request (peer, &serial), ==, order[i]);
+    assert_peer_idle (peer);
+    peer_send_response (peer, serial, 0, order[i]);
+  }
+
+  wait_for_responses (responses, G_N_ELEMENTS (responses));
+  for (gint32 i = 0; i < (gint32) G_N_ELEMENTS (responses); i++) {
+    g_assert_no_error (responses[i].error);
+    g_assert_cmpint (responses[i].value, ==, i);
+  }
+
+  g_object_unref (connection);
+  g_object_unref (peer);
+}
+
+/* Requests that waited long enough overtake more urgent ones */
+static void
+test_priority_2 (void)
+{
+  GSocket *peer;
+  GarilConnection *connection = new_socket_pair_connection (&peer, NULL);
+  Response responses[3] = { { 0, }, };
+  gint32 serial;
+
+  garil_connection_set_max_in_flight (connection, 1);
+  send_request (connection, 0, NULL, &responses[0]);
+  send_request_full (connection, 1, GARIL_REQUEST_PRIORITY_LOW, NULL,
+                     &responses[1]);
+  g_assert_cmpint (peer_receive_request (peer, &serial), ==, 0);
+
+  /* Four aging intervals make up for the three levels. */
+  const gint64 deadline = g_get_monotonic_time () + G_USEC_PER_SEC + 10000;
+  while (g_get_monotonic_time () < deadline)
+    g_main_context_iteration (NULL, FALSE);
+
+  send_request_full (connection, 2, GARIL_REQUEST_PRIORITY_URGENT, NULL,
+                     &responses[2]);
+  peer_send_response (peer, serial, 0, 0);
+
+  g_assert_cmpint (peer_receive_request (peer, &serial), ==, 1);
+  peer_send_response (peer, serial, 0, 1);
+  g_assert_cmpint (peer_receive_request (peer, &serial), ==, 2);
+  peer_send_response (peer, serial, 0, 2);
+
+  wait_for_responses (responses, G_N_ELEMENTS (responses));
+
+  g_object_unref (connection);
+  g_object_unref (peer);
+}
+
+/* Requests without a response in time fail, and late responses are
+ * dropped */
+static void
+test_request_timeout_1 (void)
+{
+  GSocket *peer;
+  GarilConnection *connection = new_socket_pair_connection (&peer, NULL);
+  Response responses[2] = { { 0, }, };
+  gint32 serial;
+
+  g_assert_cmpuint (garil_connection_get_request_timeout (connection), ==, 0);
+  g_object_set (connection, GARIL_CONNECTION_PROP_REQUEST_TIMEOUT, 50, NULL);
+  g_assert_cmpuint (garil_connection_get_request_timeout (connection), ==, 50);
+
+  const gint64 start = g_get_monotonic_time ();
+  send_request (connection, 0, NULL, &responses[0]);
+  g_assert_cmpint (peer_receive_request (peer, &serial), ==, 0);
+  wait_for_responses (&responses[0], 1);
+  g_assert_error (responses[0].error, G_IO_ERROR, G_IO_ERROR_TIMED_OUT);
+  g_assert_cmpint (g_get_monotonic_time () - start, >=, 50000);
+
+  garil_connection_set_request_timeout (connection, 0);
+  peer_send_response (peer, serial, 0, 0);
+  send_request (connection, 1, NULL, &responses[1]);
+  g_assert_cmpint (peer_receive_request (peer, &serial), ==, 1);
+  peer_send_response (peer, serial, 0, 1);
+  wait_for_responses (responses, 2);
+  g_assert_no_error (responses[1].error);
+  g_assert_cmpint (responses[1].value, ==, 1);
+
+  g_clear_error (&responses[0].error);
+  g_object_unref (connection);
+  g_object_unref (peer);
+}
+
+/* Waiting to be sent counts towards the timeout */
+static void
+test_request_timeout_2 (void)
+{
+  GSocket *peer;
+  GarilConnection *connection = new_socket_pair_connection (&peer, NULL);
+  Response responses[2] = { { 0, }, };
+  gint32 serial;
+
+  garil_connection_set_max_in_flight (connection, 1);
+  garil_connection_set_request_timeout (connection, 5000);
+  send_request (connection, 0, NULL, &responses[0]);
+  garil_connection_set_request_timeout (connection, 50);
+  send_request (connection, 1, NULL, &responses[1]);
+  g_assert_cmpint (peer_receive_request (peer, &serial), ==, 0);
+
+  wait_for_responses (&responses[1], 1);
+  g_assert_error (responses[1].error, G_IO_ERROR, G_IO_ERROR_TIMED_OUT);
+  g_assert_cmpuint (responses[0].n_done, ==, 0);
+
+  peer_send_response (peer, serial, 0, 0);
+  wait_for_responses (responses, 1);
+  g_assert_no_error (responses[0].error);
+  assert_peer_idle (peer);
+
+  g_clear_error (&responses[1].error);
+  g_object_unref (connection);
+  g_object_unref (peer);
+}
+
+static void
+append_unsolicited (GByteArray *array,
+                    gint32      code,
+                    gint32      value)
+{
+  const guint32 words[] = {
+    GUINT32_TO_BE (12),
+    GINT32_TO_LE (1),
+    GINT32_TO_LE (code),
+    GINT32_TO_LE (value),
+  };
+
+  g_byte_array_append (array, (const guint8 *) words, sizeof (words));
+}
+
+typedef struct {
+  guint id;
+  guint n_calls;
+  gint32 value;
+  guint count;
+  gboolean freed;
+  /* Subscription to remove when called, if any. */
+  guint unsubscribe;
+  /* Subscriber to subscribe when called, if any. */
+  gpointer subscribe;
+} Subscriber;
+
+static void
+on_unsolicited (GarilConnection *connection,
+                gint32           code,
+                GarilParcel     *payload,
+                gpointer         user_data)
+{
+  Subscriber *subscriber = user_data;
+
+  g_assert_false (subscriber->freed);
+  subscriber->n_calls++;
+  subscriber->count = garil_connection_get_unsolicited_count (connection);
+  subscriber->value = code * 100;
+  if (payload != NULL) {
+    subscriber->value += garil_parcel_read_int32 (payload);
+    g_assert_false (garil_parcel_is_malformed (payload));
+  }
+
+  if (subscriber->unsubscribe) {
+    const guint id = subscriber->unsubscribe;
+    subscriber->unsubscribe = 0;
+    garil_connection_unsolicited_unsubscribe (connection, id);
+    /* Freed once the dispatch is over, even when unsubscribing itself. */
+    g_assert_false (subscriber->freed);
+  }
+
+  if (subscriber->subscribe != NULL) {
+    Subscriber *other = subscriber->subscribe;
+    other->id = garil_connection_unsolicited_subscribe (connection, code,
+                                                        on_unsolicited,
+                                                        other, NULL);
+    subscriber->subscribe = NULL;
+  }
+}
+
+static void
+free_subscriber (gpointer data)
+{
+  Subscriber *subscriber = data;
+
+  g_assert_false (subscriber->freed);
+  subscriber->freed = TRUE;
+}
+
+static void
+subscribe (GarilConnection *connection,
+           gint32           code,
+           Subscriber      *subscriber)
+{
+  subscriber->id =
+    garil_connection_unsolicited_subscribe (connection, code, on_unsolicited,
+                                            subscriber, free_subscriber);
+  g_assert_cmpuint (subscriber->id, !=, 0);
+}
+
+/* Wait until the response to a request sent last, so that everything the
+ * peer sent before was dispatched. */
+static void
+sync_with_peer (GarilConnection *connection,
+                GSocket         *peer,
+                GByteArray      *array)
+{
+  Response response = { 0, };
+  gint32 serial;
+
+  send_request (connection, 0, NULL, &response);
+  g_assert_cmpint (peer_receive_request (peer, &serial), ==, 0);
+  append_response (array, serial, 0, 0);
+  send_from_peer (peer, array);
+  wait_for_responses (&response, 1);
+  g_assert_no_error (response.error);
+}
+
+/* Unsolicited responses reach the subscribers of their code only */
+static void
+test_unsolicited_1 (void)
+{
+  GSocket *peer;
+  GarilConnection *connection = new_socket_pair_connection (&peer, NULL);
+  Subscriber subscribers[3] = { { 0, }, };
+
+  subscribe (connection, 1009, &subscribers[0]);
+  subscribe (connection, 1009, &subscribers[1]);
+  subscribe (connection, 1500, &subscribers[2]);
+  g_assert_cmpuint (subscribers[0].id, !=, subscribers[1].id);
+
+  GByteArray *array = g_byte_array_new ();
+  append_unsolicited (array, 1009, 1);
+  append_unsolicited (array, 1010, 2);
+  append_unsolicited (array, 999, 3);
+  append_unsolicited (array, -1, 4);
+  append_unsolicited (array, 1500, 5);
+  append_unsolicited (array, 1009, 6);
+  sync_with_peer (connection, peer, array);
+
+  /* Each subscriber reads the payload from its start. */
+  g_assert_cmpuint (subscribers[0].n_calls, ==, 2);
+  g_assert_cmpint (subscribers[0].value, ==, 100906);
+  g_assert_cmpuint (subscribers[0].count, ==, 1);
+  g_assert_cmpuint (subscribers[1].n_calls, ==, 2);
+  g_assert_cmpint (subscribers[1].value, ==, 100906);
+  g_assert_cmpuint (subscribers[2].n_calls, ==, 1);
+  g_assert_cmpint (subscribers[2].value, ==, 150005);
+
+  garil_connection_unsolicited_unsubscribe (connection, subscribers[0].id);
+  g_assert_true (subscribers[0].freed);
+
+  array = g_byte_array_new ();
+  append_unsolicited (array, 1009, 7);
+  sync_with_peer (connection, peer, array);
+  g_assert_cmpuint (subscribers[0].n_calls, ==, 2);
+  g_assert_cmpuint (subscribers[1].n_calls, ==, 3);
+  g_assert_cmpint (subscribers[1].value, ==, 100907);
+
+  g_object_unref (connection);
+  g_assert_true (subscribers[1].freed);
+  g_assert_true (subscribers[2].freed);
+  g_object_unref (peer);
+}
+
+/* Subscribers may subscribe and unsubscribe while being called */
+static void
+test_unsolicited_2 (void)
+{
+  GSocket *peer;
+  GarilConnection *connection = new_socket_pair_connection (&peer, NULL);
+  Subscriber subscribers[4] = { { 0, }, };
+
+  subscribe (connection, 1009, &subscribers[0]);
+  subscribe (connection, 1009, &subscribers[1]);
+  subscribe (connection, 1009, &subscribers[2]);
+  subscribers[0].unsubscribe = subscribers[1].id;
+  subscribers[0].subscribe = &subscribers[3];
+  subscribers[2].unsubscribe = subscribers[2].id;
+
+  GByteArray *array = g_byte_array_new ();
+  append_unsolicited (array, 1009, 1);
+  append_unsolicited (array, 1009, 2);
+  sync_with_peer (connection, peer, array);
+
+  g_assert_cmpuint (subscribers[0].n_calls, ==, 2);
+  g_assert_cmpuint (subscribers[1].n_calls, ==, 0);
+  g_assert_true (subscribers[1].freed);
+  g_assert_cmpuint (subscribers[2].n_calls, ==, 1);
+  g_assert_true (subscribers[2].freed);
+  g_assert_cmpuint (subscribers[3].n_calls, ==, 1);
+  g_assert_cmpint (subscribers[3].value, ==, 100902);
+
+  g_object_unref (connection);
+  g_object_unref (peer);
+}
+
+static void
+wait_for_calls (Subscriber *subscriber,
+                guint       n_calls)
+{
+  const gint64 deadline = g_get_monotonic_time () + 5 * G_USEC_PER_SEC;
+
+  while (subscriber->n_calls < n_calls) {
+    g_assert_cmpint (g_get_monotonic_time (), <, deadline);
+    g_main_context_iteration (NULL, TRUE);
+  }
+  g_assert_cmpuint (subscriber->n_calls, ==, n_calls);
+}
+
+/* Only the latest response of a window is delivered */
+static void
+test_unsolicited_policy_1 (void)
+{
+  GSocket *peer;
+  GarilConnection *connection = new_socket_pair_connection (&peer, NULL);
+  Subscriber subscriber = { 0, };
+
+  subscribe (connection, 1009, &subscriber);
+  garil_connection_set_unsolicited_policy (connection, 1009,
+                                           GARIL_UNSOLICITED_POLICY_LATEST,
+                                           200);
+
+  const gint64 start = g_get_monotonic_time ();
+  GByteArray *array = g_byte_array_new ();
+  for (gint32 i = 1; i <= 5; i++)
+    append_unsolicited (array, 1009, i);
+  sync_with_peer (connection, peer, array);
+  g_assert_cmpuint (subscriber.n_calls, ==, 0);
+
+  array = g_byte_array_new ();
+  append_unsolicited (array, 1009, 6);
+  send_from_peer (peer, array);
+  wait_for_calls (&subscriber, 1);
+  g_assert_cmpint (g_get_monotonic_time () - start, >=, 200000);
+  g_assert_cmpint (subscriber.value, ==, 100906);
+  g_assert_cmpuint (subscriber.count, ==, 6);
+  g_assert_cmpuint (garil_connection_get_unsolicited_count (connection), ==,
+                    0);
+
+  /* A new window starts with the next response. */
+  array = g_byte_array_new ();
+  append_unsolicited (array, 1009, 7);
+  send_from_peer (peer, array);
+  wait_for_calls (&subscriber, 2);
+  g_assert_cmpint (subscriber.value, ==, 100907);
+  g_assert_cmpuint (subscriber.count, ==, 1);
+
+  /* Back to delivering every response. */
+  garil_connection_set_unsolicited_policy (connection, 1009,
+                                           GARIL_UNSOLICITED_POLICY_DELIVER_ALL,
+                                           0);
+  array = g_byte_array_new ();
+  append_unsolicited (array, 1009, 8);
+  append_unsolicited (array, 1009, 9);
+  sync_with_peer (connection, peer, array);
+  g_assert_cmpuint (subscriber.n_calls, ==, 4);
+  g_assert_cmpuint (subscriber.count, ==, 1);
+
+  g_object_unref (connection);
+  g_object_unref (peer);
+}
+
+/* Counted responses are delivered without payload */
+static void
+test_unsolicited_policy_2 (void)
+{
+  GSocket *peer;
+  GarilConnection *connection = new_socket_pair_connection (&peer, NULL);
+  Subscriber subscribers[2] = { { 0, }, };
+
+  subscribe (connection, 1009, &subscribers[0]);
+  subscribe (connection, 1010, &subscribers[1]);
+  garil_connection_set_unsolicited_policy (connection, 1009,
+                                           GARIL_UNSOLICITED_POLICY_COUNT, 0);
+
+  GByteArray *array = g_byte_array_new ();
+  append_unsolicited (array, 1009, 1);
+  append_unsolicited (array, 1010, 2);
+  append_unsolicited (array, 1009, 3);
+  append_unsolicited (array, 1009, 4);
+  send_from_peer (peer, array);
+
+  wait_for_calls (&subscribers[0], 1);
+  g_assert_cmpint (subscribers[0].value, ==, 100900);
+  g_assert_cmpuint (subscribers[0].count, ==, 3);
+  g_assert_cmpuint (subscribers[1].n_calls, ==, 1);
+  g_assert_cmpint (subscribers[1].value, ==, 101002);
+
+  g_object_unref (connection);
+  g_object_unref (peer);
+}
+
+static void
+run_for (gint64 usec)
+{
+  const gint64 deadline = g_get_monotonic_time () + usec;
+  while (g_get_monotonic_time () < deadline)
+    g_main_context_iteration (NULL, FALSE);
+}
+
+static void
+check_delay_message_processing (GarilConnectionFlags flags)
+{
+  GSocket *peer;
+  flags |= GARIL_CONNECTION_FLAGS_DELAY_MESSAGE_PROCESSING;
+  GarilConnection *connection =
+    new_socket_pair_connection_full (&peer, NULL, flags);
+  Subscriber subscriber = { 0, };
+  Response response = { 0, };
+  gint32 serial;
+
+  send_request (connection, 1, NULL, &response);
+  g_assert_cmpint (peer_receive_request (peer, &serial), ==, 1);
+
+  GByteArray *array = g_byte_array_new ();
+  append_unsolicited (array, 1009, 1);
+  append_response (array, serial, 0, 1);
+  append_unsolicited (array, 1009, 2);
+  send_from_peer (peer, array);
+  run_for (G_USEC_PER_SEC / 20);
+  g_assert_cmpuint (response.n_done, ==, 0);
+
+  /* Subscribed before starting, so nothing is lost. */
+  subscribe (connection, 1009, &subscriber);
+  garil_connection_start_message_processing (connection);
+  garil_connection_start_message_processing (connection);
+  wait_for_calls (&subscriber, 2);
+  g_assert_cmpint (subscriber.value, ==, 100902);
+  wait_for_responses (&response, 1);
+  g_assert_no_error (response.error);
+  g_assert_cmpint (response.value, ==, 1);
+
+  array = g_byte_array_new ();
+  append_unsolicited (array, 1009, 3);
+  send_from_peer (peer, array);
+  wait_for_calls (&subscriber, 3);
+
+  g_object_unref (connection);
+  g_object_unref (peer);
+}
+
+/* Frames received before processing starts are handled in order once it
+ * does */
+static void
+test_delay_message_processing_1 (void)
+{
+  check_delay_message_processing (GARIL_CONNECTION_FLAGS_NONE);
+}
+
+/* Same in I/O thread mode */
+static void
+test_delay_message_processing_2 (void)
+{
+  check_delay_message_processing (GARIL_CONNECTION_FLAGS_IO_THREAD);
+}
+
+/* Reading pauses once the frames kept reach their bound */
+static void
+test_delay_message_processing_3 (void)
+{
+  int fds[2];
+  g_assert_cmpint (socketpair (AF_UNIX, SOCK_STREAM, 0, fds), ==, 0);
+
+  GError *error = NULL;
+  GSocket *socket = g_socket_new_from_fd (fds[0], &error);
+  g_assert_no_error (error);
+  GSocket *peer = g_socket_new_from_fd (fds[1], &error);
+  g_assert_no_error (error);
+  GIOStream *stream =
+    G_IO_STREAM (g_socket_connection_factory_create_connection (socket));
+
+  GarilConnection *connection =
+    g_initable_new (GARIL_TYPE_CONNECTION, NULL, &error,
+                    GARIL_CONNECTION_PROP_STREAM, stream,
+                    GARIL_CONNECTION_PROP_FLAGS,
+                      GARIL_CONNECTION_FLAGS_DELAY_MESSAGE_PROCESSING,
+                    GARIL_CONNECTION_PROP_MAX_DELAYED_FRAMES, 4,
+                    NULL);
+  g_assert_no_error (error);
+  g_object_unref (stream);
+  g_assert_cmpuint (garil_connection_get_max_delayed_frames (connection), ==,
+                    4);
+  g_assert_cmpuint (garil_connection_get_max_delayed_bytes (connection), ==,
+                    1024 * 1024);
+
+  Subscriber subscriber = { 0, };
+  subscribe (connection, 1009, &subscriber);
+
+  GByteArray *array = g_byte_array_new ();
+  for (gint32 i = 1; i <= 4; i++)
+    append_unsolicited (array, 1009, i);
+  send_from_peer (peer, array);
+
+  const gint64 deadline = g_get_monotonic_time () + 5 * G_USEC_PER_SEC;
+  while (g_socket_get_available_bytes (socket) > 0) {
+    g_assert_cmpint (g_get_monotonic_time (), <, deadline);
+    g_main_context_iteration (NULL, FALSE);
+  }
+
+  array = g_byte_array_new ();
+  for (gint32 i = 5; i <= 8; i++)
+    append_unsolicited (array, 1009, i);
+  send_from_peer (peer, array);
+  run_for (G_USEC_PER_SEC / 20);
+  g_assert_cmpint (g_socket_get_available_bytes (socket), ==, 4 * 16);
+  g_assert_cmpuint (subscriber.n_calls, ==, 0);
+
+  garil_connection_start_message_processing (connection);
+  wait_for_calls (&subscriber, 8);
+  g_assert_cmpint (subscriber.value, ==, 100908);
+
+  g_object_unref (connection);
+  g_object_unref (socket);
+  g_object_unref (peer);
+}
+#endif /* G_OS_UNIX */
+
 int
 main (int   argc,
       char *argv[])
@@ -433,6 +1921,20 @@ main (int   argc,
                         test_new_for_address_2);
   g_test_add_func ("/GarilConnection/garil_connection_new_for_address/unix/3",
                    test_new_for_address_3);
+  g_test_add_data_func ("/GarilConnection/garil_connection_new_for_address/unix/4",
+                        unix_sock_address,
+                        test_new_for_address_4);
+#endif /* G_OS_UNIX */
+
+  /* garil_connection_new_for_addresses */
+
+#if defined (G_OS_UNIX)
+  g_test_add_data_func ("/GarilConnection/garil_connection_new_for_addresses/unix/1",
+                        unix_sock_address,
+                        test_new_for_addresses_1);
+  g_test_add_data_func ("/GarilConnection/garil_connection_new_for_addresses/unix/2",
+                        unix_sock_address,
+                        test_new_for_addresses_2);
 #endif /* G_OS_UNIX */
 
   /* garil_connection_new_for_address_sync */
@@ -446,6 +1948,102 @@ main (int   argc,
                         test_new_for_address_sync_2);
 #endif /* G_OS_UNIX */
 
+  /* garil_connection_send_parcel */
+
+#if defined (G_OS_UNIX)
+  g_test_add_func ("/GarilConnection/garil_connection_send_parcel/1",
+                   test_send_parcel_1);
+  g_test_add_func ("/GarilConnection/garil_connection_send_parcel/2",
+                   test_send_parcel_2);
+  g_test_add_func ("/GarilConnection/garil_connection_send_parcel/3",
+                   test_send_parcel_3);
+#endif /* G_OS_UNIX */
+
+  /* GarilConnection:coalescing-window */
+
+#if defined (G_OS_UNIX)
+  g_test_add_func ("/GarilConnection/coalescing-window/1",
+                   test_coalescing_window_1);
+  g_test_add_func ("/GarilConnection/coalescing-window/2",
+                   test_coalescing_window_2);
+#endif /* G_OS_UNIX */
+
+  /* garil_connection_send_request */
+
+#if defined (G_OS_UNIX)
+  g_test_add_func ("/GarilConnection/garil_connection_send_request/1",
+                   test_send_request_1);
+  g_test_add_func ("/GarilConnection/garil_connection_send_request/2",
+                   test_send_request_2);
+  g_test_add_func ("/GarilConnection/garil_connection_send_request/3",
+                   test_send_request_3);
+  g_test_add_func ("/GarilConnection/garil_connection_send_request/4",
+                   test_send_request_4);
+  g_test_add_func ("/GarilConnection/garil_connection_send_request/5",
+                   test_send_request_5);
+#endif /* G_OS_UNIX */
+
+  /* GarilConnection:max-in-flight */
+
+#if defined (G_OS_UNIX)
+  g_test_add_func ("/GarilConnection/max-in-flight/1",
+                   test_max_in_flight_1);
+  g_test_add_func ("/GarilConnection/max-in-flight/2",
+                   test_max_in_flight_2);
+#endif /* G_OS_UNIX */
+
+  /* GarilRequestPriority */
+
+#if defined (G_OS_UNIX)
+  g_test_add_func ("/GarilConnection/priority/1", test_priority_1);
+  g_test_add_func ("/GarilConnection/priority/2", test_priority_2);
+#endif /* G_OS_UNIX */
+
+  /* GarilConnection:request-timeout */
+
+#if defined (G_OS_UNIX)
+  g_test_add_func ("/GarilConnection/request-timeout/1",
+                   test_request_timeout_1);
+  g_test_add_func ("/GarilConnection/request-timeout/2",
+                   test_request_timeout_2);
+#endif /* G_OS_UNIX */
+
+  /* garil_connection_unsolicited_subscribe */
+
+#if defined (G_OS_UNIX)
+  g_test_add_func ("/GarilConnection/unsolicited/1", test_unsolicited_1);
+  g_test_add_func ("/GarilConnection/unsolicited/2", test_unsolicited_2);
+#endif /* G_OS_UNIX */
+
+  /* garil_connection_set_unsolicited_policy */
+
+#if defined (G_OS_UNIX)
+  g_test_add_func ("/GarilConnection/unsolicited-policy/1",
+                   test_unsolicited_policy_1);
+  g_test_add_func ("/GarilConnection/unsolicited-policy/2",
+                   test_unsolicited_policy_2);
+#endif /* G_OS_UNIX */
+
+  /* garil_connection_start_message_processing */
+
+#if defined (G_OS_UNIX)
+  g_test_add_func ("/GarilConnection/delay-message-processing/1",
+                   test_delay_message_processing_1);
+  g_test_add_func ("/GarilConnection/delay-message-processing/2",
+                   test_delay_message_processing_2);
+  g_test_add_func ("/GarilConnection/delay-message-processing/3",
+                   test_delay_message_processing_3);
+#endif /* G_OS_UNIX */
+
+  /* GARIL_CONNECTION_FLAGS_IO_THREAD */
+
+#if defined (G_OS_UNIX)
+  g_test_add_func ("/GarilConnection/io-thread/1", test_io_thread_1);
+  g_test_add_func ("/GarilConnection/io-thread/2", test_io_thread_2);
+  g_test_add_func ("/GarilConnection/io-thread/3", test_io_thread_3);
+  g_test_add_func ("/GarilConnection/io-thread/4", test_io_thread_4);
+#endif /* G_OS_UNIX */
+
   int ret = g_test_run ();
 
 #if defined (G_OS_UNIX)
@@ -0,0 +1,314 @@
+/* GARIL - Android RIL client library
+ * Copyright (C) 2016 You-Sheng Yang
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#if defined (HAVE_CONFIG_H)
+#include "config.h"
+#endif
+
+#include <locale.h>
+#include <string.h>
+
+#include <glib.h>
+
+#include "garil/garil.h"
+#include "garil/garilframe-private.h"
+
+/* Three frames of 8, 0 and 12 bytes. */
+static const guint8 stream_data[] = {
+  0x00, 0x00, 0x00, 0x08,
+  0x01, 0x00, 0x00, 0x00, 0x02, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x0c,
+  0x03, 0x00, 0x00, 0x00, 0x04, 0x00, 0x00, 0x00, 0x05, 0x00, 0x00, 0x00,
+};
+
+typedef struct {
+  GPtrArray *frames;
+  guint n_read_only;
+} Collector;
+
+static void
+collect_frame (GarilParcel *frame,
+               gpointer     user_data)
+{
+  Collector *collector = user_data;
+
+  g_assert_cmpint (garil_parcel_get_position (frame), ==, 0);
+  if (garil_parcel_is_read_only (frame))
+    collector->n_read_only++;
+
+  const gsize size = garil_parcel_get_size (frame);
+  gconstpointer data = garil_parcel_read_inplace (frame, size);
+  g_ptr_array_add (collector->frames, g_bytes_new (data, size));
+}
+
+static void
+check_frames (Collector *collector)
+{
+  g_assert_cmpuint (collector->frames->len, ==, 3);
+
+  gsize size;
+  gconstpointer data;
+
+  data = g_bytes_get_data (g_ptr_array_index (collector->frames, 0), &size);
+  g_assert_cmpmem (data, size, stream_data + 4, 8);
+  g_bytes_get_data (g_ptr_array_index (collector->frames, 1), &size);
+  g_assert_cmpuint (size, ==, 0);
+  data = g_bytes_get_data (g_ptr_array_index (collector->frames, 2), &size);
+  g_assert_cmpmem (data, size, stream_data + 20, 12);
+}
+
+static gboolean
+feed_full (GarilFrameDecoder *decoder,
+           const guint8      *data,
+           gsize              len,
+           GarilFrameFunc     func,
+           gpointer           user_data,
+           GError           **error)
+{
+  do {
+    gsize size;
+    guint8 *buffer = _garil_frame_decoder_get_buffer (decoder, &size);
+    g_assert_nonnull (buffer);
+    g_assert_cmpuint (size, >, 0);
+
+    size = MIN (size, len);
+    memcpy (buffer, data, size);
+    if (!_garil_frame_decoder_commit (decoder, size, func, user_data, error))
+      return FALSE;
+
+    data += size;
+    len -= size;
+  } while (len);
+
+  return TRUE;
+}
+
+static gboolean
+feed (GarilFrameDecoder *decoder,
+      const guint8      *data,
+      gsize              len,
+      Collector         *collector,
+      GError           **error)
+{
+  return feed_full (decoder, data, len, collect_frame, collector, error);
+}
+
+static void
+test_decoder__contiguous (void)
+{
+  GarilFrameDecoder *decoder = _garil_frame_decoder_new (0, 0);
+  Collector collector = {
+    .frames = g_ptr_array_new_with_free_func ((GDestroyNotify) g_bytes_unref),
+  };
+
+  g_assert_true (feed (decoder, stream_data, sizeof (stream_data),
+                       &collector, NULL));
+  check_frames (&collector);
+  /* All drained in one go, sharing the receive buffer. */
+  g_assert_cmpuint (collector.n_read_only, ==, 3);
+  g_assert_cmpuint (_garil_frame_decoder_get_pending (decoder), ==, 0);
+
+  g_ptr_array_unref (collector.frames);
+  _garil_frame_decoder_free (decoder);
+}
+
+static void
+test_decoder__bytewise (void)
+{
+  GarilFrameDecoder *decoder = _garil_frame_decoder_new (0, 0);
+  Collector collector = {
+    .frames = g_ptr_array_new_with_free_func ((GDestroyNotify) g_bytes_unref),
+  };
+
+  for (gsize i = 0; i < sizeof (stream_data); i++) {
+    g_assert_true (feed (decoder, stream_data + i, 1, &collector, NULL));
+    if (i == 5)
+      g_assert_cmpuint (_garil_frame_decoder_get_pending (decoder), ==, 6);
+  }
+  check_frames (&collector);
+  g_assert_cmpuint (_garil_frame_decoder_get_pending (decoder), ==, 0);
+
+  g_ptr_array_unref (collector.frames);
+  _garil_frame_decoder_free (decoder);
+}
+
+static void
+test_decoder__split (void)
+{
+  for (gsize i = 0; i <= sizeof (stream_data); i++) {
+    for (gsize j = i; j <= sizeof (stream_data); j++) {
+      GarilFrameDecoder *decoder = _garil_frame_decoder_new (0, 0);
+      Collector collector = {
+        .frames =
+          g_ptr_array_new_with_free_func ((GDestroyNotify) g_bytes_unref),
+      };
+
+      g_assert_true (feed (decoder, stream_data, i, &collector, NULL));
+      g_assert_true (feed (decoder, stream_data + i, j - i, &collector, NULL));
+      g_assert_true (feed (decoder, stream_data + j, sizeof (stream_data) - j,
+                           &collector, NULL));
+      check_frames (&collector);
+      g_assert_cmpuint (_garil_frame_decoder_get_pending (decoder), ==, 0);
+
+      g_ptr_array_unref (collector.frames);
+      _garil_frame_decoder_free (decoder);
+    }
+  }
+}
+
+static void
+test_decoder__too_large (void)
+{
+  static const guint8 data[] = {
+    0x00, 0x00, 0x00, 0x04, 0x01, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x10,
+  };
+
+  for (gsize i = 0; i <= sizeof (data); i++) {
+    GarilFrameDecoder *decoder = _garil_frame_decoder_new (0, 8);
+    Collector collector = {
+      .frames = g_ptr_array_new_with_free_func ((GDestroyNotify) g_bytes_unref),
+    };
+    GError *error = NULL;
+
+    /* The oversized length prefix is rejected however it's split. */
+    gboolean ret = feed (decoder, data, i, &collector, &error);
+    if (ret)
+      ret = feed (decoder, data + i, sizeof (data) - i, &collector, &error);
+    g_assert_false (ret);
+    g_assert_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA);
+    g_assert_cmpuint (collector.frames->len, ==, 1);
+
+    g_error_free (error);
+    g_ptr_array_unref (collector.frames);
+    _garil_frame_decoder_free (decoder);
+  }
+}
+
+#define N_SEQUENCE_FRAMES 3000
+
+/* A stream of frames each holding its own index. */
+static GByteArray*
+build_sequence (void)
+{
+  GByteArray *array = g_byte_array_new ();
+
+  for (guint32 i = 0; i < N_SEQUENCE_FRAMES; i++) {
+    const guint32 size = GUINT32_TO_BE (sizeof (guint32));
+    const guint32 value = GUINT32_TO_LE (i);
+    g_byte_array_append (array, (const guint8 *) &size, sizeof (size));
+    g_byte_array_append (array, (const guint8 *) &value, sizeof (value));
+  }
+
+  return array;
+}
+
+typedef struct {
+  guint32 next;
+  GPtrArray *held;
+} Sequence;
+
+static void
+check_sequence_frame (GarilParcel *frame,
+                      gpointer     user_data)
+{
+  Sequence *sequence = user_data;
+
+  g_assert_cmpint (garil_parcel_get_size (frame), ==, sizeof (guint32));
+  g_assert_cmpint (garil_parcel_read_int32 (frame), ==, sequence->next);
+  sequence->next++;
+
+  if (sequence->held != NULL)
+    g_ptr_array_add (sequence->held, garil_parcel_ref (frame));
+}
+
+static void
+test_decoder__recycle (void)
+{
+  GByteArray *data = build_sequence ();
+
+  /* The smallest blocks possible, so that frames straddle block ends. */
+  GarilFrameDecoder *decoder = _garil_frame_decoder_new (1, 8);
+  Sequence sequence = { 0, NULL };
+
+  for (gsize offset = 0; offset < data->len; offset += 1000) {
+    g_assert_true (feed_full (decoder, data->data + offset,
+                              MIN (1000, data->len - offset),
+                              check_sequence_frame, &sequence, NULL));
+  }
+  g_assert_cmpuint (sequence.next, ==, N_SEQUENCE_FRAMES);
+  /* Frames were released right away, so the first block is reused. */
+  g_assert_cmpuint (_garil_frame_decoder_get_n_blocks (decoder), ==, 1);
+
+  _garil_frame_decoder_free (decoder);
+  g_byte_array_unref (data);
+}
+
+static void
+test_decoder__held (void)
+{
+  GByteArray *data = build_sequence ();
+
+  GarilFrameDecoder *decoder = _garil_frame_decoder_new (1, 8);
+  Sequence sequence = {
+    .next = 0,
+    .held = g_ptr_array_new_with_free_func ((GDestroyNotify) garil_parcel_unref),
+  };
+
+  for (gsize offset = 0; offset < data->len; offset += 1000) {
+    g_assert_true (feed_full (decoder, data->data + offset,
+                              MIN (1000, data->len - offset),
+                              check_sequence_frame, &sequence, NULL));
+  }
+  g_assert_cmpuint (sequence.next, ==, N_SEQUENCE_FRAMES);
+  /* Blocks with live views are never written to again. */
+  g_assert_cmpuint (_garil_frame_decoder_get_n_blocks (decoder), >, 1);
+
+  /* Views outlive the decoder. */
+  _garil_frame_decoder_free (decoder);
+  for (guint i = 0; i < sequence.held->len; i++) {
+    GarilParcel *frame = g_ptr_array_index (sequence.held, i);
+    garil_parcel_reset (frame);
+    g_assert_cmpint (garil_parcel_read_int32 (frame), ==, i);
+  }
+
+  g_ptr_array_unref (sequence.held);
+  g_byte_array_unref (data);
+}
+
+int
+main (int   argc,
+      char *argv[])
+{
+  setlocale (LC_ALL, "");
+
+  g_test_init (&argc, &argv, NULL);
+  g_test_bug_base (PACKAGE_BUGREPORT);
+
+#define ADD_FUNC(name, n, sub) \
+  g_test_add_func ("/GarilFrame/" #name "/" #n, test_ ## name ## __ ## sub);
+
+  ADD_FUNC (decoder, 1, contiguous)
+  ADD_FUNC (decoder, 2, bytewise)
+  ADD_FUNC (decoder, 3, split)
+  ADD_FUNC (decoder, 4, too_large)
+  ADD_FUNC (decoder, 5, recycle)
+  ADD_FUNC (decoder, 6, held)
+
+  return g_test_run ();
+}
@@ -0,0 +1,311 @@
+/* GARIL - Android RIL client library
+ * Copyright (C) 2016 You-Sheng Yang
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#if defined (HAVE_CONFIG_H)
+#include "config.h"
+#endif
+
+#include <locale.h>
+
+#include <glib.h>
+
+#include "garil/garil.h"
+
+/* Writes @msg with @write_func, checks a measure-mode parcel agrees on the
+ * size and returns a fresh parcel positioned at the start of the encoding. */
+static GarilParcel *
+encode (void (*write_func) (GarilParcel *, gconstpointer),
+        gconstpointer msg)
+{
+  GByteArray *array = g_byte_array_new ();
+  GarilParcel *parcel = garil_parcel_new (array);
+  write_func (parcel, msg);
+  g_assert_false (garil_parcel_is_malformed (parcel));
+  g_assert_cmpint (garil_parcel_get_size (parcel) % 4, ==, 0);
+
+  GarilParcel *measure = garil_parcel_new_measure ();
+  write_func (measure, msg);
+  g_assert_cmpint (garil_parcel_get_size (measure), ==,
+                   garil_parcel_get_size (parcel));
+  garil_parcel_unref (measure);
+
+  garil_parcel_unref (parcel);
+  parcel = garil_parcel_new (array);
+  g_byte_array_unref (array);
+
+  return parcel;
+}
+
+/* Returns a parcel holding the first @size bytes of @parcel. */
+static GarilParcel *
+truncate_parcel (GarilParcel *parcel,
+                 gsize        size)
+{
+  gsize total = garil_parcel_get_size (parcel);
+  gconstpointer data = garil_parcel_read_inplace (parcel, total);
+  g_assert_nonnull (data);
+
+  GByteArray *array = g_byte_array_new ();
+  g_byte_array_append (array, data, size);
+  GarilParcel *truncated = garil_parcel_new (array);
+  g_byte_array_unref (array);
+
+  return truncated;
+}
+
+/*************************** garil_signal_strength ****************************/
+
+static const GarilSignalStrength signal_strength_sample = {
+  .gw_signal_strength = 17,
+  .gw_bit_error_rate = 99,
+  .cdma_dbm = -1,
+  .cdma_ecio = -1,
+  .evdo_dbm = -1,
+  .evdo_ecio = -1,
+  .evdo_signal_noise_ratio = -1,
+  .lte_signal_strength = 23,
+  .lte_rsrp = 95,
+  .lte_rsrq = 8,
+  .lte_rssnr = 120,
+  .lte_cqi = G_MAXINT32,
+  .lte_timing_advance = G_MININT32,
+  .tdscdma_rscp = 0x7fffffff,
+};
+
+static void
+test_signal_strength__round_trip (void)
+{
+  GarilParcel *parcel =
+    encode ((gpointer) garil_signal_strength_write, &signal_strength_sample);
+  g_assert_cmpint (garil_parcel_get_size (parcel), ==,
+                   sizeof (GarilSignalStrength));
+
+  GarilSignalStrength msg;
+  g_assert_true (garil_signal_strength_read (parcel, &msg));
+  g_assert_cmpmem (&msg, sizeof (msg),
+                   &signal_strength_sample, sizeof (signal_strength_sample));
+  g_assert_cmpint (garil_parcel_get_available (parcel), ==, 0);
+  garil_parcel_unref (parcel);
+
+  /* Fields are encoded in declaration order. */
+  parcel =
+    encode ((gpointer) garil_signal_strength_write, &signal_strength_sample);
+  g_assert_cmpint (garil_parcel_read_int32 (parcel), ==, 17);
+  g_assert_cmpint (garil_parcel_read_int32 (parcel), ==, 99);
+  garil_parcel_unref (parcel);
+}
+
+static void
+test_signal_strength__truncated (void)
+{
+  GarilParcel *parcel =
+    encode ((gpointer) garil_signal_strength_write, &signal_strength_sample);
+  GarilParcel *truncated =
+    truncate_parcel (parcel, sizeof (GarilSignalStrength) - sizeof (gint32));
+  garil_parcel_unref (parcel);
+
+  GarilSignalStrength msg;
+  g_assert_false (garil_signal_strength_read (truncated, &msg));
+  g_assert_true (garil_parcel_is_malformed (truncated));
+
+  /* A malformed parcel is never read again. */
+  g_assert_false (garil_signal_strength_read (truncated, &msg));
+
+  garil_parcel_unref (truncated);
+}
+
+/********************************* garil_dial *********************************/
+
+static void
+test_dial__round_trip (void)
+{
+  static const GarilDial sample = {
+    .address = "+886912345678",
+    .clir = 2,
+    .uus_present = 0,
+  };
+
+  GarilParcel *parcel = encode ((gpointer) garil_dial_write, &sample);
+
+  GarilDial msg;
+  g_assert_true (garil_dial_read (parcel, &msg));
+  g_assert_cmpstr (msg.address, ==, sample.address);
+  g_assert_cmpint (msg.clir, ==, sample.clir);
+  g_assert_cmpint (msg.uus_present, ==, sample.uus_present);
+  g_assert_cmpint (garil_parcel_get_available (parcel), ==, 0);
+
+  garil_dial_clear (&msg);
+  g_assert_null (msg.address);
+
+  garil_parcel_unref (parcel);
+}
+
+static void
+test_dial__null (void)
+{
+  static const GarilDial sample = {
+    .address = NULL,
+    .clir = 0,
+    .uus_present = 0,
+  };
+
+  GarilParcel *parcel = encode ((gpointer) garil_dial_write, &sample);
+
+  GarilDial msg;
+  g_assert_true (garil_dial_read (parcel, &msg));
+  g_assert_null (msg.address);
+
+  garil_dial_clear (&msg);
+  garil_parcel_unref (parcel);
+}
+
+static void
+test_dial__truncated (void)
+{
+  static const GarilDial sample = {
+    .address = "112",
+    .clir = 1,
+    .uus_present = 0,
+  };
+
+  GarilParcel *parcel = encode ((gpointer) garil_dial_write, &sample);
+  gsize size = garil_parcel_get_size (parcel);
+
+  /* Cut inside the trailing int32 block, after the string was decoded. */
+  GarilParcel *truncated = truncate_parcel (parcel, size - sizeof (gint32));
+  garil_parcel_unref (parcel);
+
+  GarilDial msg;
+  g_assert_false (garil_dial_read (truncated, &msg));
+  g_assert_true (garil_parcel_is_malformed (truncated));
+  /* Already cleared on failure. */
+  g_assert_null (msg.address);
+
+  garil_parcel_unref (truncated);
+}
+
+/***************************** garil_sms_response *****************************/
+
+static void
+test_sms_response__round_trip (void)
+{
+  static const GarilSmsResponse sample = {
+    .message_ref = 42,
+    .ack_pdu = "0011000b9188",
+    .error_code = -1,
+  };
+
+  GarilParcel *parcel = encode ((gpointer) garil_sms_response_write, &sample);
+
+  GarilSmsResponse msg;
+  g_assert_true (garil_sms_response_read (parcel, &msg));
+  g_assert_cmpint (msg.message_ref, ==, sample.message_ref);
+  g_assert_cmpstr (msg.ack_pdu, ==, sample.ack_pdu);
+  g_assert_cmpint (msg.error_code, ==, sample.error_code);
+
+  garil_sms_response_clear (&msg);
+  garil_parcel_unref (parcel);
+}
+
+/************************** garil_call_forward_info ***************************/
+
+static void
+test_call_forward_info__round_trip (void)
+{
+  static const GarilCallForwardInfo sample = {
+    .status = 1,
+    .reason = 2,
+    .service_class = 1,
+    .toa = 145,
+    .number = "+44\xc3\xa9",
+    .time_seconds = 20,
+  };
+
+  GarilParcel *parcel =
+    encode ((gpointer) garil_call_forward_info_write, &sample);
+
+  GarilCallForwardInfo msg;
+  g_assert_true (garil_call_forward_info_read (parcel, &msg));
+  g_assert_cmpint (msg.status, ==, sample.status);
+  g_assert_cmpint (msg.reason, ==, sample.reason);
+  g_assert_cmpint (msg.service_class, ==, sample.service_class);
+  g_assert_cmpint (msg.toa, ==, sample.toa);
+  g_assert_cmpstr (msg.number, ==, sample.number);
+  g_assert_cmpint (msg.time_seconds, ==, sample.time_seconds);
+
+  garil_call_forward_info_clear (&msg);
+  garil_parcel_unref (parcel);
+}
+
+static void
+test_call_forward_info__sequence (void)
+{
+  static const GarilCallForwardInfo samples[] = {
+    { 1, 0, 1, 129, "123", 0 },
+    { 0, 2, 4, 145, NULL, 30 },
+  };
+
+  GByteArray *array = g_byte_array_new ();
+  GarilParcel *parcel = garil_parcel_new (array);
+  garil_parcel_write_int32 (parcel, G_N_ELEMENTS (samples));
+  for (guint i = 0; i < G_N_ELEMENTS (samples); i++)
+    garil_call_forward_info_write (parcel, &samples[i]);
+  garil_parcel_unref (parcel);
+
+  parcel = garil_parcel_new (array);
+  g_byte_array_unref (array);
+
+  g_assert_cmpint (garil_parcel_read_int32 (parcel), ==,
+                   G_N_ELEMENTS (samples));
+  for (guint i = 0; i < G_N_ELEMENTS (samples); i++) {
+    GarilCallForwardInfo msg;
+    g_assert_true (garil_call_forward_info_read (parcel, &msg));
+    g_assert_cmpint (msg.reason, ==, samples[i].reason);
+    g_assert_cmpint (msg.toa, ==, samples[i].toa);
+    g_assert_cmpstr (msg.number, ==, samples[i].number);
+    g_assert_cmpint (msg.time_seconds, ==, samples[i].time_seconds);
+    garil_call_forward_info_clear (&msg);
+  }
+  g_assert_cmpint (garil_parcel_get_available (parcel), ==, 0);
+
+  garil_parcel_unref (parcel);
+}
+
+int
+main (int   argc,
+      char *argv[])
+{
+  setlocale (LC_ALL, "");
+
+  g_test_init (&argc, &argv, NULL);
+  g_test_bug_base (PACKAGE_BUGREPORT);
+
+#define ADD_FUNC(name, n, sub) \
+  g_test_add_func ("/GarilMessages/garil_" #name "/" #n, \
+                   test_ ## name ## __ ## sub);
+
+  ADD_FUNC (signal_strength, 1, round_trip)
+  ADD_FUNC (signal_strength, 2, truncated)
+  ADD_FUNC (dial, 1, round_trip)
+  ADD_FUNC (dial, 2, null)
+  ADD_FUNC (dial, 3, truncated)
+  ADD_FUNC (sms_response, 1, round_trip)
+  ADD_FUNC (call_forward_info, 1, round_trip)
+  ADD_FUNC (call_forward_info, 2, sequence)
+
+  return g_test_run ();
+}
@@ -0,0 +1,213 @@
+/* GARIL - Android RIL client library
+ * Copyright (C) 2016 You-Sheng Yang
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#if defined (HAVE_CONFIG_H)
+#include "config.h"
+#endif
+
+#include <locale.h>
+
+#include <glib.h>
+
+#include "garil/garil.h"
+
+static void
+test_acquire__basic (void)
+{
+  GarilParcelPool *pool = garil_parcel_pool_new (0);
+  g_assert_cmpuint (garil_parcel_pool_get_n_idle (pool), ==, 0);
+
+  GarilParcel *parcel = garil_parcel_pool_acquire (pool, 0);
+  g_assert_nonnull (parcel);
+  g_assert_cmpint (garil_parcel_get_size (parcel), ==, 0);
+  g_assert_false (garil_parcel_is_read_only (parcel));
+
+  garil_parcel_write_int32 (parcel, 1);
+  garil_parcel_unref (parcel);
+  g_assert_cmpuint (garil_parcel_pool_get_n_idle (pool), ==, 1);
+
+  /* The same parcel is handed out again, reset. */
+  GarilParcel *again = garil_parcel_pool_acquire (pool, 16);
+  g_assert_true (again == parcel);
+  g_assert_cmpuint (garil_parcel_pool_get_n_idle (pool), ==, 0);
+  g_assert_cmpint (garil_parcel_get_size (again), ==, 0);
+  g_assert_cmpint (garil_parcel_get_position (again), ==, 0);
+  g_assert_false (garil_parcel_is_malformed (again));
+
+  garil_parcel_unref (again);
+  garil_parcel_pool_unref (pool);
+}
+
+static void
+test_acquire__size_class (void)
+{
+  GarilParcelPool *pool = garil_parcel_pool_new (0);
+
+  GarilParcel *small = garil_parcel_pool_acquire (pool, 16);
+  garil_parcel_unref (small);
+
+  /* A larger request doesn't get the small parcel. */
+  GarilParcel *large = garil_parcel_pool_acquire (pool, 4000);
+  g_assert_true (large != small);
+  g_assert_cmpuint (garil_parcel_pool_get_n_idle (pool), ==, 1);
+
+  /* Grown past its size class, the small parcel moves up to the largest
+   * one it can hold. */
+  small = garil_parcel_pool_acquire (pool, 16);
+  garil_parcel_write_inplace (small, 3000);
+  garil_parcel_unref (small);
+
+  GarilParcel *again = garil_parcel_pool_acquire (pool, 1000);
+  g_assert_true (again == small);
+
+  garil_parcel_unref (again);
+  garil_parcel_unref (large);
+  garil_parcel_pool_unref (pool);
+}
+
+/* Writing up to the acquired size never moves the data */
+static void
+assert_capacity (GarilParcel *parcel,
+                 gsize        size)
+{
+  guint8 *data = garil_parcel_write_inplace (parcel, 4);
+  g_assert_nonnull (data);
+  guint8 *rest = garil_parcel_write_inplace (parcel, size - 4);
+  g_assert_true (rest == data + 4);
+}
+
+static void
+test_acquire__capacity (void)
+{
+  GarilParcelPool *pool = garil_parcel_pool_new (0);
+
+  /* Grown past its size class, but not up to the next one. */
+  GarilParcel *grown = garil_parcel_pool_acquire (pool, 256);
+  garil_parcel_write_inplace (grown, 300);
+  garil_parcel_unref (grown);
+
+  GarilParcel *parcel = garil_parcel_pool_acquire (pool, 1024);
+  g_assert_true (parcel != grown);
+  assert_capacity (parcel, 1024);
+  garil_parcel_unref (parcel);
+
+  parcel = garil_parcel_pool_acquire (pool, 256);
+  g_assert_true (parcel == grown);
+  assert_capacity (parcel, 256);
+  garil_parcel_unref (parcel);
+
+  garil_parcel_pool_unref (pool);
+}
+
+static void
+test_acquire__oversized (void)
+{
+  GarilParcelPool *pool = garil_parcel_pool_new (0);
+
+  GarilParcel *parcel = garil_parcel_pool_acquire (pool, 1024 * 1024);
+  g_assert_nonnull (parcel);
+  garil_parcel_unref (parcel);
+  g_assert_cmpuint (garil_parcel_pool_get_n_idle (pool), ==, 0);
+
+  garil_parcel_pool_unref (pool);
+}
+
+static void
+test_acquire__max_idle (void)
+{
+  GarilParcelPool *pool = garil_parcel_pool_new (2);
+
+  GarilParcel *parcels[4];
+  for (guint i = 0; i < G_N_ELEMENTS (parcels); i++)
+    parcels[i] = garil_parcel_pool_acquire (pool, 0);
+  for (guint i = 0; i < G_N_ELEMENTS (parcels); i++)
+    garil_parcel_unref (parcels[i]);
+
+  g_assert_cmpuint (garil_parcel_pool_get_n_idle (pool), ==, 2);
+
+  garil_parcel_pool_trim (pool);
+  g_assert_cmpuint (garil_parcel_pool_get_n_idle (pool), ==, 0);
+
+  garil_parcel_pool_unref (pool);
+}
+
+static void
+test_acquire__outlive (void)
+{
+  GarilParcelPool *pool = garil_parcel_pool_new (0);
+
+  GarilParcel *parcel = garil_parcel_pool_acquire (pool, 0);
+  garil_parcel_pool_unref (pool);
+
+  /* The parcel keeps the pool alive until it is recycled. */
+  garil_parcel_write_int32 (parcel, 1);
+  garil_parcel_unref (parcel);
+}
+
+static gpointer
+thread_func (gpointer user_data)
+{
+  GarilParcelPool *pool = user_data;
+
+  for (guint i = 0; i < 10000; i++) {
+    GarilParcel *parcel = garil_parcel_pool_acquire (pool, i % 2000);
+    garil_parcel_write_int32 (parcel, i);
+    garil_parcel_unref (parcel);
+  }
+
+  return NULL;
+}
+
+static void
+test_acquire__threads (void)
+{
+  GarilParcelPool *pool = garil_parcel_pool_new (4);
+
+  GThread *threads[4];
+  for (guint i = 0; i < G_N_ELEMENTS (threads); i++)
+    threads[i] = g_thread_new (NULL, thread_func, pool);
+  for (guint i = 0; i < G_N_ELEMENTS (threads); i++)
+    g_thread_join (threads[i]);
+
+  g_assert_cmpuint (garil_parcel_pool_get_n_idle (pool), <=, 4 * 5);
+
+  garil_parcel_pool_unref (pool);
+}
+
+int
+main (int   argc,
+      char *argv[])
+{
+  setlocale (LC_ALL, "");
+
+  g_test_init (&argc, &argv, NULL);
+  g_test_bug_base (PACKAGE_BUGREPORT);
+
+#define ADD_FUNC(name, n, sub) \
+  g_test_add_func ("/GarilParcelPool/garil_parcel_pool_" #name "/" #n, \
+                   test_ ## name ## __ ## sub);
+
+  ADD_FUNC (acquire, 1, basic)
+  ADD_FUNC (acquire, 2, size_class)
+  ADD_FUNC (acquire, 3, oversized)
+  ADD_FUNC (acquire, 4, max_idle)
+  ADD_FUNC (acquire, 5, outlive)
+  ADD_FUNC (acquire, 6, threads)
+  ADD_FUNC (acquire, 7, capacity)
+
+  return g_test_run ();
+}
@@ -23,6 +23,7 @@
 #include <string.h>
 
 #include <glib.h>
+#include <glib/gstdio.h>
 
 #include "garil/garil.h"
 
@@ -80,6 +81,343 @@ test_new_valid__basic (gconstpointer user_data)
   garil_parcel_unref (parcel);
 }
 
+/************************ garil_parcel_new_from_bytes *************************/
+
+static void
+test_new_from_bytes__basic (gconstpointer user_data)
+{
+  GBytes *bytes = (GBytes *) user_data;
+
+  GarilParcel *parcel = garil_parcel_new_from_bytes (bytes);
+  g_assert_nonnull (parcel);
+  g_assert_cmpint (garil_parcel_get_size (parcel), ==, g_bytes_get_size (bytes));
+  g_assert_cmpint (garil_parcel_get_available (parcel), ==,
+                   g_bytes_get_size (bytes));
+  g_assert_cmpint (garil_parcel_get_position (parcel), ==, 0);
+  g_assert_true (garil_parcel_is_read_only (parcel));
+  g_assert_false (garil_parcel_is_malformed (parcel));
+
+  garil_parcel_unref (parcel);
+}
+
+static void
+test_new_from_bytes__slice (void)
+{
+  static const guint8 data[] = {
+    0xff, 0xff, 0xff, 0xff, 0x01, 0x00, 0x00, 0x00, 0x02, 0x00, 0x00, 0x00,
+    0xff, 0xff, 0xff, 0xff,
+  };
+
+  GBytes *bytes = g_bytes_new_static (data, sizeof (data));
+  GBytes *slice = g_bytes_new_from_bytes (bytes, 4, 8);
+  g_bytes_unref (bytes);
+
+  GarilParcel *parcel = garil_parcel_new_from_bytes (slice);
+  g_bytes_unref (slice);
+
+  g_assert_cmpint (garil_parcel_get_size (parcel), ==, 8);
+  g_assert (garil_parcel_read_inplace (parcel, 4) == &data[4]);
+  g_assert_cmpint (garil_parcel_read_int32 (parcel), ==, 2);
+  g_assert_cmpint (garil_parcel_get_available (parcel), ==, 0);
+  g_assert_false (garil_parcel_is_malformed (parcel));
+
+  g_assert_null (garil_parcel_read_inplace (parcel, 1));
+  g_assert_true (garil_parcel_is_malformed (parcel));
+
+  garil_parcel_unref (parcel);
+}
+
+static void
+test_new_from_bytes__mapped (void)
+{
+  static const guint8 data[] = {
+    0x02, 0x00, 0x00, 0x00, 0x61, 0x00, 0x62, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x03, 0x00, 0x00, 0x00,
+  };
+
+  gchar *path = NULL;
+  GError *error = NULL;
+  gint fd = g_file_open_tmp ("test-parcel-XXXXXX", &path, &error);
+  g_assert_no_error (error);
+  g_assert_cmpint (fd, >=, 0);
+  g_close (fd, NULL);
+
+  g_file_set_contents (path, (const gchar *) data, sizeof (data), &error);
+  g_assert_no_error (error);
+
+  GMappedFile *file = g_mapped_file_new (path, FALSE, &error);
+  g_assert_no_error (error);
+  GBytes *bytes = g_mapped_file_get_bytes (file);
+  g_mapped_file_unref (file);
+
+  GarilParcel *parcel = garil_parcel_new_from_bytes (bytes);
+  g_bytes_unref (bytes);
+
+  gchar *str = garil_parcel_read_string16 (parcel);
+  g_assert_cmpstr (str, ==, "ab");
+  g_free (str);
+  g_assert_cmpint (garil_parcel_read_int32 (parcel), ==, 3);
+  g_assert_cmpint (garil_parcel_get_available (parcel), ==, 0);
+  g_assert_false (garil_parcel_is_malformed (parcel));
+
+  garil_parcel_unref (parcel);
+
+  g_unlink (path);
+  g_free (path);
+}
+
+static void
+test_new_from_bytes__write (void)
+{
+  static const guint8 data[] = { 0x01, 0x00, 0x00, 0x00 };
+
+  GBytes *bytes = g_bytes_new_static (data, sizeof (data));
+  GarilParcel *parcel = garil_parcel_new_from_bytes (bytes);
+  g_bytes_unref (bytes);
+
+  g_test_expect_message (G_LOG_DOMAIN, G_LOG_LEVEL_CRITICAL,
+                         "*assertion*failed*");
+  g_assert_null (garil_parcel_write_inplace (parcel, sizeof (gint32)));
+  g_test_assert_expected_messages ();
+
+  g_assert_cmpint (garil_parcel_get_size (parcel), ==, sizeof (data));
+  g_assert_cmpint (garil_parcel_get_position (parcel), ==, 0);
+  g_assert_false (garil_parcel_is_malformed (parcel));
+
+  garil_parcel_unref (parcel);
+}
+
+/************************ garil_parcel_new_segmented **************************/
+
+static void
+test_new_segmented__basic (void)
+{
+  GarilParcel *parcel = garil_parcel_new_segmented (8);
+  g_assert_nonnull (parcel);
+  g_assert_cmpint (garil_parcel_get_size (parcel), ==, 0);
+  g_assert_cmpuint (garil_parcel_get_vectors (parcel, NULL, 0), ==, 0);
+  g_assert_false (garil_parcel_is_read_only (parcel));
+
+  GByteArray *expected = g_byte_array_new ();
+  for (gint32 i = 0; i < 5; i++) {
+    garil_parcel_write_int32 (parcel, i);
+    g_byte_array_append (expected, (const guint8*) &i, sizeof (i));
+  }
+  g_assert_cmpint (garil_parcel_get_size (parcel), ==, expected->len);
+  g_assert_cmpint (garil_parcel_get_position (parcel), ==, expected->len);
+
+  GOutputVector vectors[4];
+  const guint n = garil_parcel_get_vectors (parcel, vectors,
+                                            G_N_ELEMENTS (vectors));
+  g_assert_cmpuint (n, ==, 3);
+
+  GByteArray *actual = g_byte_array_new ();
+  for (guint i = 0; i < n; i++)
+    g_byte_array_append (actual, vectors[i].buffer, vectors[i].size);
+  g_assert_cmpmem (actual->data, actual->len, expected->data, expected->len);
+
+  /* Only the first vector is filled. */
+  g_assert_cmpuint (garil_parcel_get_vectors (parcel, vectors, 1), ==, 3);
+  g_assert_cmpint (vectors[0].size, ==, 8);
+
+  g_byte_array_unref (actual);
+  g_byte_array_unref (expected);
+  garil_parcel_unref (parcel);
+}
+
+static void
+test_new_segmented__stable (void)
+{
+  GarilParcel *parcel = garil_parcel_new_segmented (0);
+
+  gint32 *first = garil_parcel_write_inplace (parcel, sizeof (gint32));
+  *first = 0x12345678;
+
+  for (guint i = 0; i < 4096; i++)
+    garil_parcel_write_int32 (parcel, i);
+
+  g_assert_cmpint (*first, ==, 0x12345678);
+  g_assert_cmpint (garil_parcel_get_size (parcel), ==, 4097 * sizeof (gint32));
+  g_assert_cmpuint (garil_parcel_get_vectors (parcel, NULL, 0), ==, 5);
+
+  garil_parcel_unref (parcel);
+}
+
+static void
+test_new_segmented__oversized (void)
+{
+  GarilParcel *parcel = garil_parcel_new_segmented (8);
+
+  garil_parcel_write_int32 (parcel, 1);
+  guint8 *buf = garil_parcel_write_inplace (parcel, 21);
+  memset (buf, 0xff, 21);
+  garil_parcel_write_int32 (parcel, 2);
+
+  GOutputVector vectors[3];
+  g_assert_cmpuint (garil_parcel_get_vectors (parcel, vectors, 3), ==, 3);
+  g_assert_cmpint (vectors[0].size, ==, 4);
+  g_assert_true (vectors[1].buffer == buf);
+  g_assert_cmpint (vectors[1].size, ==, 24);
+  g_assert_cmpint (vectors[2].size, ==, 4);
+  g_assert_cmpint (garil_parcel_get_size (parcel), ==, 32);
+
+  garil_parcel_unref (parcel);
+}
+
+static void
+test_new_segmented__read (void)
+{
+  GarilParcel *parcel = garil_parcel_new_segmented (0);
+  garil_parcel_write_int32 (parcel, 1);
+
+  g_test_expect_message (G_LOG_DOMAIN, G_LOG_LEVEL_CRITICAL,
+                         "*assertion*failed*");
+  g_assert_null (garil_parcel_read_inplace (parcel, sizeof (gint32)));
+  g_test_assert_expected_messages ();
+
+  garil_parcel_unref (parcel);
+}
+
+/************************* garil_parcel_new_measure ***************************/
+
+static void
+write_sample (GarilParcel *parcel)
+{
+  static const guint8 bytes[] = { 0x01, 0x02, 0x03 };
+  static const gint32 ints[] = { 1, 2, 3, 4 };
+  static const gchar * const strings[] = { "abc", NULL, "\xf0\x9f\x98\x80", "" };
+
+  garil_parcel_write_byte (parcel, 0xff);
+  garil_parcel_write_int32 (parcel, 42);
+  garil_parcel_write_byte_array_buf (parcel, bytes, G_N_ELEMENTS (bytes));
+  garil_parcel_write_int32_array_buf (parcel, ints, G_N_ELEMENTS (ints));
+  garil_parcel_write_string16 (parcel, "\xe4\xb8\xad\xe6\x96\x87 text");
+  garil_parcel_write_string16 (parcel, NULL);
+  garil_parcel_write_string16_array (parcel, strings, G_N_ELEMENTS (strings));
+  garil_parcel_write (parcel, bytes, 2);
+}
+
+static void
+test_new_measure__basic (void)
+{
+  GarilParcel *measure = garil_parcel_new_measure ();
+  g_assert_true (garil_parcel_is_measure (measure));
+  g_assert_cmpint (garil_parcel_get_size (measure), ==, 0);
+
+  write_sample (measure);
+  g_assert_false (garil_parcel_is_malformed (measure));
+  g_assert_cmpuint (garil_parcel_get_vectors (measure, NULL, 0), ==, 0);
+
+  GarilParcel *parcel = garil_parcel_new (NULL);
+  g_assert_false (garil_parcel_is_measure (parcel));
+  write_sample (parcel);
+
+  g_assert_cmpint (garil_parcel_get_size (measure), ==,
+                   garil_parcel_get_size (parcel));
+  g_assert_cmpint (garil_parcel_get_position (measure), ==,
+                   garil_parcel_get_position (parcel));
+
+  garil_parcel_unref (parcel);
+  garil_parcel_unref (measure);
+}
+
+static void
+test_new_measure__invalid_utf8 (void)
+{
+  GarilParcel *measure = garil_parcel_new_measure ();
+  GarilParcel *parcel = garil_parcel_new (NULL);
+
+  garil_parcel_write_string16 (measure, "abc\xff");
+  garil_parcel_write_string16 (parcel, "abc\xff");
+
+  g_assert_cmpint (garil_parcel_get_size (measure), ==,
+                   garil_parcel_get_size (parcel));
+  g_assert_cmpint (garil_parcel_is_malformed (measure), ==,
+                   garil_parcel_is_malformed (parcel));
+
+  garil_parcel_unref (parcel);
+  garil_parcel_unref (measure);
+}
+
+static void
+test_new_measure__read (void)
+{
+  GarilParcel *measure = garil_parcel_new_measure ();
+  garil_parcel_write_int32 (measure, 1);
+
+  g_test_expect_message (G_LOG_DOMAIN, G_LOG_LEVEL_CRITICAL,
+                         "*assertion*failed*");
+  g_assert_null (garil_parcel_read_inplace (measure, sizeof (gint32)));
+  g_test_assert_expected_messages ();
+
+  garil_parcel_unref (measure);
+}
+
+/**************************** garil_parcel_reset ******************************/
+
+static void
+test_reset__basic (void)
+{
+  GByteArray *array = g_byte_array_sized_new (64);
+  GarilParcel *parcel = garil_parcel_new (array);
+
+  garil_parcel_write_int32 (parcel, 1);
+  g_assert_null (garil_parcel_write_inplace (parcel, G_MAXSIZE));
+  g_assert_true (garil_parcel_is_malformed (parcel));
+
+  garil_parcel_reset (parcel);
+  g_assert_false (garil_parcel_is_malformed (parcel));
+  g_assert_cmpint (garil_parcel_get_size (parcel), ==, 0);
+  g_assert_cmpint (garil_parcel_get_position (parcel), ==, 0);
+  g_assert_cmpuint (array->len, ==, 0);
+
+  garil_parcel_write_int32 (parcel, 2);
+  g_assert_cmpint (garil_parcel_get_size (parcel), ==, sizeof (gint32));
+
+  garil_parcel_unref (parcel);
+  g_byte_array_unref (array);
+}
+
+static void
+test_reset__read_only (void)
+{
+  static const guint8 data[] = { 0x01, 0x00, 0x00, 0x00 };
+
+  GBytes *bytes = g_bytes_new_static (data, sizeof (data));
+  GarilParcel *parcel = garil_parcel_new_from_bytes (bytes);
+  g_bytes_unref (bytes);
+
+  g_assert_cmpint (garil_parcel_read_int32 (parcel), ==, 1);
+  garil_parcel_read_int32 (parcel);
+  g_assert_true (garil_parcel_is_malformed (parcel));
+
+  garil_parcel_reset (parcel);
+  g_assert_false (garil_parcel_is_malformed (parcel));
+  g_assert_cmpint (garil_parcel_get_size (parcel), ==, sizeof (data));
+  g_assert_cmpint (garil_parcel_read_int32 (parcel), ==, 1);
+
+  garil_parcel_unref (parcel);
+}
+
+static void
+test_reset__segmented (void)
+{
+  GarilParcel *parcel = garil_parcel_new_segmented (8);
+
+  for (gint32 i = 0; i < 8; i++)
+    garil_parcel_write_int32 (parcel, i);
+  g_assert_cmpuint (garil_parcel_get_vectors (parcel, NULL, 0), ==, 4);
+
+  garil_parcel_reset (parcel);
+  g_assert_cmpint (garil_parcel_get_size (parcel), ==, 0);
+  g_assert_cmpuint (garil_parcel_get_vectors (parcel, NULL, 0), ==, 0);
+
+  garil_parcel_write_int32 (parcel, 1);
+  g_assert_cmpuint (garil_parcel_get_vectors (parcel, NULL, 0), ==, 1);
+
+  garil_parcel_unref (parcel);
+}
+
 /***************************** garil_parcel_read ******************************/
 
 static void
@@ -1050,6 +1388,124 @@ test_read_int32_array__malformed (FixtureMalformed *fixture,
   check_malformed_fixture (fixture);
 }
 
+/******************** garil_parcel_read_int32_array_into **********************/
+
+static void
+test_read_int32_array_into__basic (gconstpointer user_data)
+{
+  const TestDataReadInt32Array *data = user_data;
+
+  GBytes *bytes = g_bytes_new (data->input.data, data->input.len);
+  GarilParcel *parcel = garil_parcel_new_from_bytes (bytes);
+  g_bytes_unref (bytes);
+
+  gint32 dst[16];
+  gsize len = 0xfe;
+  const gboolean ret =
+    garil_parcel_read_int32_array_into (parcel, dst, G_N_ELEMENTS (dst), &len);
+  g_assert_cmpint (garil_parcel_get_position (parcel), ==, data->position);
+  if (data->expected.data != NULL) {
+    g_assert_true (ret);
+    g_assert_cmpmem (dst, len * sizeof (gint32),
+                     data->expected.data, data->expected.len * sizeof (gint32));
+    g_assert_false (garil_parcel_is_malformed (parcel));
+  } else {
+    g_assert_false (ret);
+    g_assert_cmpint (len, ==, 0xfe);
+    g_assert_true (garil_parcel_is_malformed (parcel));
+  }
+
+  garil_parcel_unref (parcel);
+}
+
+static void
+test_read_int32_array_into__capacity (void)
+{
+  static const guint8 data[] = {
+    0x02, 0x00, 0x00, 0x00,
+    0x01, 0x00, 0x00, 0x00,
+    0x02, 0x00, 0x00, 0x00,
+  };
+
+  GBytes *bytes = g_bytes_new_static (data, sizeof (data));
+  GarilParcel *parcel = garil_parcel_new_from_bytes (bytes);
+  g_bytes_unref (bytes);
+
+  gint32 dst[2] = { 0, 0 };
+  gsize len = 0;
+  g_assert_false (garil_parcel_read_int32_array_into (parcel, dst, 1, &len));
+  g_assert_true (garil_parcel_is_malformed (parcel));
+  g_assert_cmpint (dst[0], ==, 0);
+
+  garil_parcel_reset (parcel);
+  g_assert_true (garil_parcel_read_int32_array_into (parcel, dst, 2, &len));
+  g_assert_cmpuint (len, ==, 2);
+  g_assert_cmpint (dst[0], ==, 1);
+  g_assert_cmpint (dst[1], ==, 2);
+
+  garil_parcel_unref (parcel);
+}
+
+#define bytes_read_int32_array_into__malformed bytes_read__malformed
+
+static void
+test_read_int32_array_into__malformed (FixtureMalformed *fixture,
+                                       gconstpointer     user_data G_GNUC_UNUSED)
+{
+  gint32 dst[4];
+  gsize len;
+  g_assert_false (garil_parcel_read_int32_array_into (fixture->parcel, dst,
+                                                      G_N_ELEMENTS (dst), &len));
+
+  check_malformed_fixture (fixture);
+}
+
+#if (G_BYTE_ORDER == G_LITTLE_ENDIAN)
+
+/******************* garil_parcel_read_int32_array_inplace ********************/
+
+static void
+test_read_int32_array_inplace__basic (gconstpointer user_data)
+{
+  const TestDataReadInt32Array *data = user_data;
+
+  GBytes *bytes = g_bytes_new (data->input.data, data->input.len);
+  GarilParcel *parcel = garil_parcel_new_from_bytes (bytes);
+
+  gsize len = 0xfe;
+  const gint32 *p = garil_parcel_read_int32_array_inplace (parcel, &len);
+  g_assert_cmpint (garil_parcel_get_position (parcel), ==, data->position);
+  if (data->expected.data != NULL) {
+    g_assert_nonnull (p);
+    g_assert_true ((const guint8 *) p ==
+                   (const guint8 *) g_bytes_get_data (bytes, NULL) + 4);
+    g_assert_cmpmem (p, len * sizeof (gint32),
+                     data->expected.data, data->expected.len * sizeof (gint32));
+    g_assert_false (garil_parcel_is_malformed (parcel));
+  } else {
+    g_assert_null (p);
+    g_assert_cmpint (len, ==, 0xfe);
+    g_assert_true (garil_parcel_is_malformed (parcel));
+  }
+
+  garil_parcel_unref (parcel);
+  g_bytes_unref (bytes);
+}
+
+#define bytes_read_int32_array_inplace__malformed bytes_read__malformed
+
+static void
+test_read_int32_array_inplace__malformed (FixtureMalformed *fixture,
+                                          gconstpointer     user_data G_GNUC_UNUSED)
+{
+  gsize len;
+  g_assert_null (garil_parcel_read_int32_array_inplace (fixture->parcel, &len));
+
+  check_malformed_fixture (fixture);
+}
+
+#endif
+
 /************************** garil_parcel_write_int32 **************************/
 
 typedef struct {
@@ -1259,6 +1715,120 @@ test_write_int32_array_buf__malformed (FixtureMalformed *fixture,
   check_malformed_fixture (fixture);
 }
 
+/*********************** garil_parcel_read_int32_struct ***********************/
+
+typedef struct {
+  gint32 a;
+  gint32 b;
+  gint32 c;
+} Int32Struct;
+
+static void
+test_read_int32_struct__basic (void)
+{
+  static const guint8 data[] = {
+    0x01, 0x00, 0x00, 0x00,
+    0xfe, 0xff, 0xff, 0xff,
+    0x78, 0x56, 0x34, 0x12,
+    0xff, 0xff, 0xff, 0x7f,
+  };
+
+  GBytes *bytes = g_bytes_new_static (data, sizeof (data));
+  GarilParcel *parcel = garil_parcel_new_from_bytes (bytes);
+  g_bytes_unref (bytes);
+
+  Int32Struct s = { 0, 0, 0 };
+  g_assert_true (garil_parcel_read_int32_struct (parcel, &s, 3));
+  g_assert_cmpint (s.a, ==, 1);
+  g_assert_cmpint (s.b, ==, -2);
+  g_assert_cmpint (s.c, ==, 0x12345678);
+  g_assert_cmpint (garil_parcel_get_position (parcel), ==, 12);
+
+  /* Nothing is read. */
+  g_assert_true (garil_parcel_read_int32_struct (parcel, NULL, 0));
+  g_assert_cmpint (garil_parcel_get_position (parcel), ==, 12);
+
+  /* Not enough data left for a whole struct. */
+  g_assert_false (garil_parcel_read_int32_struct (parcel, &s, 3));
+  g_assert_true (garil_parcel_is_malformed (parcel));
+  g_assert_cmpint (garil_parcel_get_position (parcel), ==, 12);
+  g_assert_cmpint (s.a, ==, 1);
+
+  garil_parcel_unref (parcel);
+}
+
+static void
+test_read_int32_struct__overflow (void)
+{
+  static const guint8 data[] = { 0x00, 0x00, 0x00, 0x00 };
+
+  GBytes *bytes = g_bytes_new_static (data, sizeof (data));
+  GarilParcel *parcel = garil_parcel_new_from_bytes (bytes);
+  g_bytes_unref (bytes);
+
+  gint32 dst;
+  g_assert_false (garil_parcel_read_int32_struct (parcel, &dst,
+                                                  G_MAXSIZE / 2));
+  g_assert_true (garil_parcel_is_malformed (parcel));
+
+  garil_parcel_unref (parcel);
+}
+
+#define bytes_read_int32_struct__malformed bytes_read__malformed
+
+static void
+test_read_int32_struct__malformed (FixtureMalformed *fixture,
+                                   gconstpointer     user_data G_GNUC_UNUSED)
+{
+  Int32Struct s;
+  g_assert_false (garil_parcel_read_int32_struct (fixture->parcel, &s, 3));
+
+  check_malformed_fixture (fixture);
+}
+
+/********************** garil_parcel_write_int32_struct ***********************/
+
+static void
+test_write_int32_struct__basic (void)
+{
+  static const guint8 expected[] = {
+    0x01, 0x00, 0x00, 0x00,
+    0xfe, 0xff, 0xff, 0xff,
+    0x78, 0x56, 0x34, 0x12,
+  };
+  static const Int32Struct s = { 1, -2, 0x12345678 };
+
+  GByteArray *byte_array = g_byte_array_new ();
+  GarilParcel *parcel = garil_parcel_new (byte_array);
+
+  garil_parcel_write_int32_struct (parcel, &s, 3);
+  garil_parcel_write_int32_struct (parcel, NULL, 0);
+  g_assert_false (garil_parcel_is_malformed (parcel));
+  g_assert_cmpmem (byte_array->data, byte_array->len,
+                   expected, sizeof (expected));
+
+  GarilParcel *measure = garil_parcel_new_measure ();
+  garil_parcel_write_int32_struct (measure, &s, 3);
+  g_assert_cmpint (garil_parcel_get_size (measure), ==, sizeof (expected));
+  garil_parcel_unref (measure);
+
+  garil_parcel_unref (parcel);
+  g_byte_array_unref (byte_array);
+}
+
+#define bytes_write_int32_struct__malformed bytes_read__malformed
+
+static void
+test_write_int32_struct__malformed (FixtureMalformed *fixture,
+                                    gconstpointer     user_data G_GNUC_UNUSED)
+{
+  static const Int32Struct s = { 1, 2, 3 };
+
+  garil_parcel_write_int32_struct (fixture->parcel, &s, 3);
+
+  check_malformed_fixture (fixture);
+}
+
 /************************* garil_parcel_read_string16 *************************/
 
 typedef struct {
@@ -1351,6 +1921,79 @@ test_read_string16__basic (gconstpointer user_data)
   g_byte_array_unref (byte_array);
 }
 
+static void
+check_read_string16 (const gunichar2 *utf16_str,
+                     gint32           len,
+                     gsize            offset)
+{
+  gchar *expected = g_utf16_to_utf8 (utf16_str, len, NULL, NULL, NULL);
+
+  /* Prepend @offset bytes to exercise unaligned access. */
+  GByteArray *byte_array = g_byte_array_new ();
+  g_byte_array_set_size (byte_array, offset);
+  g_byte_array_append (byte_array, (const guint8 *) &len, sizeof (len));
+  g_byte_array_append (byte_array, (const guint8 *) utf16_str,
+                       (len + 1) * sizeof (gunichar2));
+  g_byte_array_set_size (byte_array,
+                         offset + ((byte_array->len - offset + 3) & ~3));
+
+  GBytes *bytes = g_byte_array_free_to_bytes (byte_array);
+  GBytes *slice = g_bytes_new_from_bytes (bytes, offset,
+                                          g_bytes_get_size (bytes) - offset);
+  GarilParcel *parcel = garil_parcel_new_from_bytes (slice);
+
+  gchar *result = garil_parcel_read_string16 (parcel);
+  g_assert_cmpstr (result, ==, expected);
+  g_assert (garil_parcel_is_malformed (parcel) == (expected == NULL));
+
+  g_free (result);
+  garil_parcel_unref (parcel);
+  g_bytes_unref (slice);
+  g_bytes_unref (bytes);
+  g_free (expected);
+}
+
+static void
+test_read_string16__transcode (void)
+{
+  static const gunichar2 specials[][2] = {
+    { 0x0000, 0x0061 },
+    { 0x007f, 0x0061 },
+    { 0x0080, 0x0061 },
+    { 0x07ff, 0x0061 },
+    { 0x0800, 0x0061 },
+    { 0xffff, 0x0061 },
+    { 0xd83d, 0xde00 }, /* surrogate pair */
+    { 0xd83d, 0x0061 }, /* unpaired high surrogate */
+    { 0xde00, 0x0061 }, /* unpaired low surrogate */
+  };
+  gunichar2 utf16_str[81];
+
+  for (gint32 len = 0; len < 80; len++) {
+    for (gint32 i = 0; i < len; i++)
+      utf16_str[i] = 'a' + (i % 26);
+    utf16_str[len] = 0;
+
+    check_read_string16 (utf16_str, len, 0);
+    check_read_string16 (utf16_str, len, 2);
+
+    for (gint32 pos = 0; pos < len; pos++) {
+      for (guint k = 0; k < G_N_ELEMENTS (specials); k++) {
+        utf16_str[pos] = specials[k][0];
+        if (pos + 1 < len)
+          utf16_str[pos + 1] = specials[k][1];
+
+        check_read_string16 (utf16_str, len, 0);
+        check_read_string16 (utf16_str, len, 2);
+
+        utf16_str[pos] = 'a' + (pos % 26);
+        if (pos + 1 < len)
+          utf16_str[pos + 1] = 'a' + ((pos + 1) % 26);
+      }
+    }
+  }
+}
+
 #define bytes_read_string16__malformed bytes_read__malformed
 
 static void
@@ -1363,6 +2006,116 @@ test_read_string16__malformed (FixtureMalformed *fixture,
   check_malformed_fixture (fixture);
 }
 
+/********************** garil_parcel_read_string16_view ***********************/
+
+static GarilParcel*
+new_string16_parcel (const gchar * const *strings,
+                     gsize                len)
+{
+  GarilParcel *writer = garil_parcel_new (NULL);
+  for (gsize i = 0; i < len; i++)
+    garil_parcel_write_string16 (writer, strings[i]);
+
+  GOutputVector vector = { NULL, 0 };
+  garil_parcel_get_vectors (writer, &vector, 1);
+  GBytes *bytes = g_bytes_new (vector.buffer, vector.size);
+  GarilParcel *parcel = garil_parcel_new_from_bytes (bytes);
+  g_bytes_unref (bytes);
+  garil_parcel_unref (writer);
+
+  return parcel;
+}
+
+static void
+test_read_string16_view__basic (void)
+{
+  static const gchar * const strings[] = {
+    "46692", NULL, "", "\xe4\xb8\xad\xe8\x8f\xaf\xe9\x9b\xbb\xe4\xbf\xa1",
+  };
+
+  GarilParcel *parcel = new_string16_parcel (strings, G_N_ELEMENTS (strings));
+  GarilParcelString16 views[G_N_ELEMENTS (strings)];
+
+  for (guint i = 0; i < G_N_ELEMENTS (views); i++)
+    g_assert_true (garil_parcel_read_string16_view (parcel, &views[i]));
+  g_assert_cmpint (garil_parcel_get_available (parcel), ==, 0);
+  g_assert_false (garil_parcel_is_malformed (parcel));
+
+  g_assert_false (garil_parcel_string16_is_null (&views[0]));
+  g_assert_cmpint (views[0].len, ==, 5);
+  g_assert_true (garil_parcel_string16_equal_ascii (&views[0], "46692"));
+  g_assert_false (garil_parcel_string16_equal_ascii (&views[0], "4669"));
+  g_assert_false (garil_parcel_string16_equal_ascii (&views[0], "466920"));
+  g_assert_false (garil_parcel_string16_equal_ascii (&views[0], NULL));
+
+  g_assert_true (garil_parcel_string16_is_null (&views[1]));
+  g_assert_null (views[1].data);
+  g_assert_true (garil_parcel_string16_equal_ascii (&views[1], NULL));
+  g_assert_false (garil_parcel_string16_equal_ascii (&views[1], ""));
+  g_assert_null (garil_parcel_string16_to_utf8 (&views[1]));
+  g_assert_cmpint (garil_parcel_string16_copy_utf8 (&views[1], NULL, 0), ==, -1);
+
+  g_assert_true (garil_parcel_string16_equal_ascii (&views[2], ""));
+
+  for (guint i = 0; i < G_N_ELEMENTS (views); i++) {
+    if (strings[i] == NULL)
+      continue;
+
+    gchar *str = garil_parcel_string16_to_utf8 (&views[i]);
+    g_assert_cmpstr (str, ==, strings[i]);
+    g_free (str);
+
+    const gssize len = strlen (strings[i]);
+    gchar buf[32];
+    memset (buf, 'x', sizeof (buf));
+
+    /* Too small, untouched. */
+    g_assert_cmpint (garil_parcel_string16_copy_utf8 (&views[i], buf, len),
+                     ==, len);
+    g_assert_cmpint (buf[0], ==, 'x');
+
+    g_assert_cmpint (garil_parcel_string16_copy_utf8 (&views[i], buf, len + 1),
+                     ==, len);
+    g_assert_cmpstr (buf, ==, strings[i]);
+  }
+
+  garil_parcel_unref (parcel);
+}
+
+static void
+test_read_string16_view__invalid (void)
+{
+  /* Unpaired surrogate: the view is fine, conversion is not. */
+  static const guint8 data[] = {
+    0x01, 0x00, 0x00, 0x00,
+    0x3d, 0xd8, 0x00, 0x00,
+  };
+
+  GBytes *bytes = g_bytes_new_static (data, sizeof (data));
+  GarilParcel *parcel = garil_parcel_new_from_bytes (bytes);
+  g_bytes_unref (bytes);
+
+  GarilParcelString16 view;
+  g_assert_true (garil_parcel_read_string16_view (parcel, &view));
+  g_assert_false (garil_parcel_is_malformed (parcel));
+  g_assert_null (garil_parcel_string16_to_utf8 (&view));
+  g_assert_cmpint (garil_parcel_string16_copy_utf8 (&view, NULL, 0), ==, -1);
+
+  garil_parcel_unref (parcel);
+}
+
+#define bytes_read_string16_view__malformed bytes_read__malformed
+
+static void
+test_read_string16_view__malformed (FixtureMalformed *fixture,
+                                    gconstpointer     user_data G_GNUC_UNUSED)
+{
+  GarilParcelString16 view;
+  g_assert_false (garil_parcel_read_string16_view (fixture->parcel, &view));
+
+  check_malformed_fixture (fixture);
+}
+
 /********************** garil_parcel_read_string16_array **********************/
 
 typedef struct {
@@ -1554,10 +2307,9 @@ DEFINE_INVALID (41, 16, 0x02, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00,
 #undef DEFINE_INVALID
 
 static void
-test_read_string16_array__basic (gconstpointer user_data)
+check_read_string16_array (const TestDataReadString16Array *data,
+                           gboolean                         packed)
 {
-  const TestDataReadString16Array *data = user_data;
-
   GByteArray *byte_array = g_byte_array_new ();
   if (data->input.data != NULL)
     g_byte_array_append (byte_array, data->input.data, data->input.len);
@@ -1566,7 +2318,9 @@ test_read_string16_array__basic (gconstpointer user_data)
 
   const gsize mark = 0xfe;
   gsize len = mark;
-  gchar **p = garil_parcel_read_string16_array (parcel, &len);
+  gchar **p = packed ?
+      garil_parcel_read_string16_array_packed (parcel, &len) :
+      garil_parcel_read_string16_array (parcel, &len);
   g_assert_cmpint (garil_parcel_get_size (parcel), ==, data->input.len);
   g_assert_cmpint (garil_parcel_get_position (parcel), ==, data->position);
   g_assert_cmpint (garil_parcel_get_available (parcel), ==,
@@ -1588,7 +2342,8 @@ test_read_string16_array__basic (gconstpointer user_data)
           g_assert_nonnull (p[i]);
           g_assert_cmpstr (p[i], ==, data->expected.data[i]);
 
-          g_free (p[i]);
+          if (!packed)
+            g_free (p[i]);
         }
       }
 
@@ -1600,6 +2355,12 @@ test_read_string16_array__basic (gconstpointer user_data)
   g_byte_array_unref (byte_array);
 }
 
+static void
+test_read_string16_array__basic (gconstpointer user_data)
+{
+  check_read_string16_array (user_data, FALSE);
+}
+
 static const guint8 bytes_read_string16_array__malformed_data[] = {
   0x00, 0x00, 0x00, 0x00
 };
@@ -1622,6 +2383,67 @@ test_read_string16_array__malformed (FixtureMalformed *fixture,
   check_malformed_fixture (fixture);
 }
 
+/****************** garil_parcel_read_string16_array_packed *******************/
+
+static void
+test_read_string16_array_packed__basic (gconstpointer user_data)
+{
+  check_read_string16_array (user_data, TRUE);
+}
+
+static void
+test_read_string16_array_packed__layout (void)
+{
+  static const gchar * const strings[] = { "abc", NULL, "", "\xc3\xa9t\xc3\xa9" };
+
+  GarilParcel *parcel = garil_parcel_new (NULL);
+  garil_parcel_write_string16_array (parcel, strings, G_N_ELEMENTS (strings));
+
+  GOutputVector vector = { NULL, 0 };
+  garil_parcel_get_vectors (parcel, &vector, 1);
+  GBytes *bytes = g_bytes_new (vector.buffer, vector.size);
+  garil_parcel_unref (parcel);
+  parcel = garil_parcel_new_from_bytes (bytes);
+  g_bytes_unref (bytes);
+
+  gsize len = 0;
+  gchar **array = garil_parcel_read_string16_array_packed (parcel, &len);
+  g_assert_cmpuint (len, ==, G_N_ELEMENTS (strings));
+  g_assert_cmpint (garil_parcel_get_available (parcel), ==, 0);
+
+  /* All strings follow the pointer table back to back. */
+  gchar *p = (gchar *) (array + len);
+  for (gsize i = 0; i < len; i++) {
+    if (strings[i] == NULL) {
+      g_assert_null (array[i]);
+      continue;
+    }
+
+    g_assert_true (array[i] == p);
+    g_assert_cmpstr (array[i], ==, strings[i]);
+    p += strlen (strings[i]) + 1;
+  }
+
+  g_free (array);
+  garil_parcel_unref (parcel);
+}
+
+#define bytes_read_string16_array_packed__malformed \
+  bytes_read_string16_array__malformed
+
+static void
+test_read_string16_array_packed__malformed (FixtureMalformed *fixture,
+                                            gconstpointer     user_data G_GNUC_UNUSED)
+{
+  const gsize mark = 0xfe;
+  gsize len = mark;
+  gchar **p = garil_parcel_read_string16_array_packed (fixture->parcel, &len);
+  g_assert_null (p);
+  g_assert_cmpint (len, ==, mark);
+
+  check_malformed_fixture (fixture);
+}
+
 /************************ garil_parcel_write_string16 *************************/
 
 typedef struct {
@@ -1670,6 +2492,84 @@ test_write_string16__basic (gconstpointer user_data)
   g_byte_array_unref (byte_array);
 }
 
+static void
+check_write_string16 (const gchar *utf8_str)
+{
+  glong len = 0;
+  gunichar2 *utf16_str = g_utf8_to_utf16 (utf8_str, -1, NULL, &len, NULL);
+
+  GarilParcel *parcel = garil_parcel_new (NULL);
+  garil_parcel_write_string16 (parcel, utf8_str);
+  g_assert_false (garil_parcel_is_malformed (parcel));
+
+  if (utf16_str == NULL)
+    g_assert_cmpint (garil_parcel_get_size (parcel), ==, 0);
+  else {
+    GarilParcel *measure = garil_parcel_new_measure ();
+    garil_parcel_write_string16 (measure, utf8_str);
+    g_assert_cmpint (garil_parcel_get_size (measure), ==,
+                     garil_parcel_get_size (parcel));
+    garil_parcel_unref (measure);
+
+    GOutputVector vector;
+    g_assert_cmpuint (garil_parcel_get_vectors (parcel, &vector, 1), ==, 1);
+
+    GByteArray *expected = g_byte_array_new ();
+    const gint32 len32 = GINT32_TO_LE (len);
+    g_byte_array_append (expected, (const guint8 *) &len32, sizeof (len32));
+    g_byte_array_append (expected, (const guint8 *) utf16_str,
+                         (len + 1) * sizeof (gunichar2));
+    if (expected->len & 3) {
+      static const guint8 padding[] = { 0, 0 };
+      g_byte_array_append (expected, padding, sizeof (padding));
+    }
+    g_assert_cmpmem (vector.buffer, vector.size,
+                     expected->data, expected->len);
+    g_byte_array_unref (expected);
+  }
+
+  garil_parcel_unref (parcel);
+  g_free (utf16_str);
+}
+
+static void
+test_write_string16__transcode (void)
+{
+  static const gchar * const specials[] = {
+    "\x7f",
+    "\xc2\x80",         /* U+0080 */
+    "\xdf\xbf",         /* U+07FF */
+    "\xe0\xa0\x80",     /* U+0800 */
+    "\xef\xbf\xbf",     /* U+FFFF */
+    "\xf0\x9f\x98\x80", /* U+1F600 */
+    "\xed\xa0\x80",     /* surrogate */
+    "\xc0\x80",         /* overlong */
+    "\xe0\xa0",         /* truncated */
+    "\xff",
+  };
+  gchar utf8_str[128];
+
+  for (guint len = 0; len < 80; len++) {
+    for (guint i = 0; i < len; i++)
+      utf8_str[i] = 'a' + (i % 26);
+    utf8_str[len] = '\0';
+
+    check_write_string16 (utf8_str);
+
+    for (guint pos = 0; pos <= len; pos++) {
+      for (guint k = 0; k < G_N_ELEMENTS (specials); k++) {
+        GString *str = g_string_new_len (utf8_str, pos);
+        g_string_append (str, specials[k]);
+        g_string_append (str, utf8_str + pos);
+
+        check_write_string16 (str->str);
+
+        g_string_free (str, TRUE);
+      }
+    }
+  }
+}
+
 #define bytes_write_string16__malformed bytes_read__malformed
 
 static void
@@ -1852,6 +2752,120 @@ fixture_teardown_malformed (FixtureMalformed *fixture,
   garil_parcel_unref (fixture->parcel);
 }
 
+/********************************* benchmarks *********************************/
+
+/* Throughput of the bulk conversion paths. Only registered with `-m perf`.
+ * The byte-swapping paths are only taken on big-endian hosts; without such
+ * hardware at hand, build for one and run the benchmarks under qemu-user:
+ *
+ *   ./configure --host=powerpc64-linux-gnu --disable-shared && make
+ *   qemu-ppc64 -L /usr/powerpc64-linux-gnu tests/test-parcel \
+ *     -m perf -p /GarilParcel/perf
+ */
+
+#define PERF_ITERATIONS 20000
+#define PERF_INT32_ARRAY_LEN 1024
+
+static void
+report_throughput (gsize bytes)
+{
+  const gdouble elapsed = g_test_timer_elapsed ();
+  g_test_maximized_result (bytes / elapsed / (1024 * 1024),
+                           "%.1f MiB/s", bytes / elapsed / (1024 * 1024));
+}
+
+static void
+test_perf__read_int32_array (void)
+{
+  gint32 *buf = g_new (gint32, PERF_INT32_ARRAY_LEN);
+  for (gint32 i = 0; i < PERF_INT32_ARRAY_LEN; i++)
+    buf[i] = i;
+
+  GarilParcel *writer = garil_parcel_new (NULL);
+  garil_parcel_write_int32_array_buf (writer, buf, PERF_INT32_ARRAY_LEN);
+  GOutputVector vector = { NULL, 0 };
+  garil_parcel_get_vectors (writer, &vector, 1);
+  GBytes *bytes = g_bytes_new (vector.buffer, vector.size);
+  garil_parcel_unref (writer);
+  GarilParcel *parcel = garil_parcel_new_from_bytes (bytes);
+  g_bytes_unref (bytes);
+
+  g_test_timer_start ();
+  for (guint i = 0; i < PERF_ITERATIONS; i++) {
+    gsize len = 0;
+    garil_parcel_reset (parcel);
+    garil_parcel_read_int32_array_into (parcel, buf, PERF_INT32_ARRAY_LEN,
+                                        &len);
+  }
+  report_throughput ((gsize) PERF_ITERATIONS * vector.size);
+
+  g_assert_false (garil_parcel_is_malformed (parcel));
+  g_assert_cmpint (buf[PERF_INT32_ARRAY_LEN - 1], ==, PERF_INT32_ARRAY_LEN - 1);
+
+  garil_parcel_unref (parcel);
+  g_free (buf);
+}
+
+static void
+test_perf__write_int32_array (void)
+{
+  gint32 *buf = g_new (gint32, PERF_INT32_ARRAY_LEN);
+  for (gint32 i = 0; i < PERF_INT32_ARRAY_LEN; i++)
+    buf[i] = i;
+
+  GarilParcel *parcel = garil_parcel_new (NULL);
+
+  g_test_timer_start ();
+  for (guint i = 0; i < PERF_ITERATIONS; i++) {
+    garil_parcel_reset (parcel);
+    garil_parcel_write_int32_array_buf (parcel, buf, PERF_INT32_ARRAY_LEN);
+  }
+  report_throughput ((gsize) PERF_ITERATIONS * garil_parcel_get_size (parcel));
+
+  garil_parcel_unref (parcel);
+  g_free (buf);
+}
+
+static void
+test_perf__read_string16 (void)
+{
+  GarilParcel *writer = garil_parcel_new (NULL);
+  garil_parcel_write_string16 (writer,
+      "0891683108200505f0040d91683188902848f400000000000000000000000000");
+  GOutputVector vector = { NULL, 0 };
+  garil_parcel_get_vectors (writer, &vector, 1);
+  GBytes *bytes = g_bytes_new (vector.buffer, vector.size);
+  garil_parcel_unref (writer);
+  GarilParcel *parcel = garil_parcel_new_from_bytes (bytes);
+  g_bytes_unref (bytes);
+
+  g_test_timer_start ();
+  for (guint i = 0; i < PERF_ITERATIONS * 10; i++) {
+    garil_parcel_reset (parcel);
+    g_free (garil_parcel_read_string16 (parcel));
+  }
+  report_throughput ((gsize) PERF_ITERATIONS * 10 * vector.size);
+
+  garil_parcel_unref (parcel);
+}
+
+static void
+test_perf__write_string16 (void)
+{
+  GarilParcel *parcel = garil_parcel_new (NULL);
+
+  g_test_timer_start ();
+  for (guint i = 0; i < PERF_ITERATIONS * 10; i++) {
+    garil_parcel_reset (parcel);
+    garil_parcel_write_string16 (parcel,
+        "0891683108200505f0040d91683188902848f400000000000000000000000000");
+  }
+  report_throughput ((gsize) PERF_ITERATIONS * 10 *
+                     garil_parcel_get_size (parcel));
+
+  garil_parcel_unref (parcel);
+}
+
 int
 main (int   argc,
       char *argv[])
@@ -1872,6 +2886,15 @@ main (int   argc,
                              test_new_valid__basic,
                              (GDestroyNotify) g_byte_array_unref);
 
+  g_test_add_data_func_full ("/GarilParcel/garil_parcel_new_from_bytes/1",
+                             g_bytes_new (NULL, 0),
+                             test_new_from_bytes__basic,
+                             (GDestroyNotify) g_bytes_unref);
+  g_test_add_data_func_full ("/GarilParcel/garil_parcel_new_from_bytes/2",
+                             g_bytes_new_take (g_malloc0 (128), 128),
+                             test_new_from_bytes__basic,
+                             (GDestroyNotify) g_bytes_unref);
+
 #define ADD_FUNC(name, n, sub) \
   g_test_add_func ("/GarilParcel/garil_parcel_" #name "/" #n, \
                    test_ ## name ## __ ## sub);
@@ -1889,6 +2912,23 @@ main (int   argc,
               test_ ## name ## __malformed, \
               fixture_teardown_malformed);
 
+  ADD_FUNC (new_from_bytes, 3, slice)
+  ADD_FUNC (new_from_bytes, 4, mapped)
+  ADD_FUNC (new_from_bytes, 5, write)
+
+  ADD_FUNC (new_segmented, 1, basic)
+  ADD_FUNC (new_segmented, 2, stable)
+  ADD_FUNC (new_segmented, 3, oversized)
+  ADD_FUNC (new_segmented, 4, read)
+
+  ADD_FUNC (new_measure, 1, basic)
+  ADD_FUNC (new_measure, 2, invalid_utf8)
+  ADD_FUNC (new_measure, 3, read)
+
+  ADD_FUNC (reset, 1, basic)
+  ADD_FUNC (reset, 2, read_only)
+  ADD_FUNC (reset, 3, segmented)
+
   ADD_FUNC (read, 1, basic)
   ADD_MALFORMED (read, 2)
 
@@ -2000,6 +3040,46 @@ main (int   argc,
   ADD_DATA_FUNC (read_int32_array, 14, basic)
   ADD_MALFORMED (read_int32_array, 15)
 
+#define ADD_INT32_ARRAY(variant, n) \
+  g_test_add_data_func ("/GarilParcel/garil_parcel_read_int32_array_" #variant "/" #n, \
+                        &testdata_read_int32_array_ ## n, \
+                        test_read_int32_array_ ## variant ## __basic);
+
+  ADD_INT32_ARRAY (into, 1)
+  ADD_INT32_ARRAY (into, 2)
+  ADD_INT32_ARRAY (into, 3)
+  ADD_INT32_ARRAY (into, 4)
+  ADD_INT32_ARRAY (into, 5)
+  ADD_INT32_ARRAY (into, 6)
+  ADD_INT32_ARRAY (into, 7)
+  ADD_INT32_ARRAY (into, 8)
+  ADD_INT32_ARRAY (into, 9)
+  ADD_INT32_ARRAY (into, 10)
+  ADD_INT32_ARRAY (into, 11)
+  ADD_INT32_ARRAY (into, 12)
+  ADD_INT32_ARRAY (into, 13)
+  ADD_INT32_ARRAY (into, 14)
+  ADD_FUNC (read_int32_array_into, 15, capacity)
+  ADD_MALFORMED (read_int32_array_into, 16)
+
+#if (G_BYTE_ORDER == G_LITTLE_ENDIAN)
+  ADD_INT32_ARRAY (inplace, 1)
+  ADD_INT32_ARRAY (inplace, 2)
+  ADD_INT32_ARRAY (inplace, 3)
+  ADD_INT32_ARRAY (inplace, 4)
+  ADD_INT32_ARRAY (inplace, 5)
+  ADD_INT32_ARRAY (inplace, 6)
+  ADD_INT32_ARRAY (inplace, 7)
+  ADD_INT32_ARRAY (inplace, 8)
+  ADD_INT32_ARRAY (inplace, 9)
+  ADD_INT32_ARRAY (inplace, 10)
+  ADD_INT32_ARRAY (inplace, 11)
+  ADD_INT32_ARRAY (inplace, 12)
+  ADD_INT32_ARRAY (inplace, 13)
+  ADD_INT32_ARRAY (inplace, 14)
+  ADD_MALFORMED (read_int32_array_inplace, 15)
+#endif
+
   ADD_DATA_FUNC (write_int32, 1, basic)
   ADD_DATA_FUNC (write_int32, 2, basic)
   ADD_DATA_FUNC (write_int32, 3, basic)
@@ -2017,6 +3097,13 @@ main (int   argc,
   ADD_DATA_FUNC (write_int32_array_buf, 3, basic)
   ADD_MALFORMED (write_int32_array_buf, 4)
 
+  ADD_FUNC (read_int32_struct, 1, basic)
+  ADD_FUNC (read_int32_struct, 2, overflow)
+  ADD_MALFORMED (read_int32_struct, 3)
+
+  ADD_FUNC (write_int32_struct, 1, basic)
+  ADD_MALFORMED (write_int32_struct, 2)
+
   ADD_DATA_FUNC (read_string16, 1, basic)
   ADD_DATA_FUNC (read_string16, 2, basic)
   ADD_DATA_FUNC (read_string16, 3, basic)
@@ -2034,6 +3121,11 @@ main (int   argc,
   ADD_DATA_FUNC (read_string16, 15, basic)
   ADD_DATA_FUNC (read_string16, 16, basic)
   ADD_MALFORMED (read_string16, 17)
+  ADD_FUNC (read_string16, 18, transcode)
+
+  ADD_FUNC (read_string16_view, 1, basic)
+  ADD_FUNC (read_string16_view, 2, invalid)
+  ADD_MALFORMED (read_string16_view, 3)
 
   ADD_DATA_FUNC (read_string16_array, 1, basic)
   ADD_DATA_FUNC (read_string16_array, 2, basic)
@@ -2078,6 +3170,55 @@ main (int   argc,
   ADD_DATA_FUNC (read_string16_array, 41, basic)
   ADD_MALFORMED (read_string16_array, 42)
 
+#define ADD_PACKED(n) \
+  g_test_add_data_func ("/GarilParcel/garil_parcel_read_string16_array_packed/" #n, \
+                        &testdata_read_string16_array_ ## n, \
+                        test_read_string16_array_packed__basic);
+
+  ADD_PACKED (1)
+  ADD_PACKED (2)
+  ADD_PACKED (3)
+  ADD_PACKED (4)
+  ADD_PACKED (5)
+  ADD_PACKED (6)
+  ADD_PACKED (7)
+  ADD_PACKED (8)
+  ADD_PACKED (9)
+  ADD_PACKED (10)
+  ADD_PACKED (11)
+  ADD_PACKED (12)
+  ADD_PACKED (13)
+  ADD_PACKED (14)
+  ADD_PACKED (15)
+  ADD_PACKED (16)
+  ADD_PACKED (17)
+  ADD_PACKED (18)
+  ADD_PACKED (19)
+  ADD_PACKED (20)
+  ADD_PACKED (21)
+  ADD_PACKED (22)
+  ADD_PACKED (23)
+  ADD_PACKED (24)
+  ADD_PACKED (25)
+  ADD_PACKED (26)
+  ADD_PACKED (27)
+  ADD_PACKED (28)
+  ADD_PACKED (29)
+  ADD_PACKED (30)
+  ADD_PACKED (31)
+  ADD_PACKED (32)
+  ADD_PACKED (33)
+  ADD_PACKED (34)
+  ADD_PACKED (35)
+  ADD_PACKED (36)
+  ADD_PACKED (37)
+  ADD_PACKED (38)
+  ADD_PACKED (39)
+  ADD_PACKED (40)
+  ADD_PACKED (41)
+  ADD_FUNC (read_string16_array_packed, 42, layout)
+  ADD_MALFORMED (read_string16_array_packed, 43)
+
   ADD_DATA_FUNC (write_string16, 1, basic)
   ADD_DATA_FUNC (write_string16, 2, basic)
   ADD_DATA_FUNC (write_string16, 3, basic)
@@ -2085,6 +3226,7 @@ main (int   argc,
   ADD_DATA_FUNC (write_string16, 5, basic)
   ADD_DATA_FUNC (write_string16, 6, basic)
   ADD_MALFORMED (write_string16, 7)
+  ADD_FUNC (write_string16, 8, transcode)
 
   ADD_DATA_FUNC (write_string16_array, 1, basic)
   ADD_DATA_FUNC (write_string16_array, 2, basic)
@@ -2109,5 +3251,16 @@ main (int   argc,
   ADD_DATA_FUNC (write_string16_array, 21, basic)
   ADD_MALFORMED (write_string16_array, 22)
 
+  if (g_test_perf ()) {
+    g_test_add_func ("/GarilParcel/perf/read_int32_array",
+                     test_perf__read_int32_array);
+    g_test_add_func ("/GarilParcel/perf/write_int32_array",
+                     test_perf__write_int32_array);
+    g_test_add_func ("/GarilParcel/perf/read_string16",
+                     test_perf__read_string16);
+    g_test_add_func ("/GarilParcel/perf/write_string16",
+                     test_perf__write_string16);
+  }
+
   return g_test_run ();
 }
@@ -0,0 +1,159 @@
+/* GARIL - Android RIL client library
+ * Copyright (C) 2016 You-Sheng Yang
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#if defined (HAVE_CONFIG_H)
+#include "config.h"
+#endif
+
+#include <locale.h>
+
+#include <glib.h>
+
+#include "garil/garil.h"
+#include "garil/garilpending-private.h"
+
+#define DATA(n) GINT_TO_POINTER ((n) + 1)
+
+/* Serials are handed out in sequence and looked up again */
+static void
+test_table__insert (void)
+{
+  GarilPendingTable *table = _garil_pending_table_new (0);
+
+  for (gint i = 0; i < 8; i++)
+    g_assert_cmpint (_garil_pending_table_insert (table, DATA (i)), ==, i + 1);
+  g_assert_cmpuint (_garil_pending_table_get_size (table), ==, 8);
+
+  for (gint i = 0; i < 8; i++)
+    g_assert_true (_garil_pending_table_lookup (table, i + 1) == DATA (i));
+  g_assert_null (_garil_pending_table_lookup (table, 0));
+  g_assert_null (_garil_pending_table_lookup (table, -1));
+  g_assert_null (_garil_pending_table_lookup (table, 9));
+  /* Same slot as serial 1. */
+  g_assert_null (_garil_pending_table_lookup (table, 1 + 16));
+
+  _garil_pending_table_free (table);
+}
+
+/* Removal, in any order */
+static void
+test_table__remove (void)
+{
+  GarilPendingTable *table = _garil_pending_table_new (0);
+
+  for (gint i = 0; i < 8; i++)
+    _garil_pending_table_insert (table, DATA (i));
+
+  g_assert_true (_garil_pending_table_remove (table, 5) == DATA (4));
+  g_assert_null (_garil_pending_table_remove (table, 5));
+  g_assert_null (_garil_pending_table_lookup (table, 5));
+  g_assert_true (_garil_pending_table_remove (table, 1) == DATA (0));
+  g_assert_null (_garil_pending_table_remove (table, 100));
+  g_assert_cmpuint (_garil_pending_table_get_size (table), ==, 6);
+
+  /* Freed serials are not reused right away. */
+  g_assert_cmpint (_garil_pending_table_insert (table, DATA (8)), ==, 9);
+
+  _garil_pending_table_free (table);
+}
+
+/* Growing keeps every entry reachable */
+static void
+test_table__grow (void)
+{
+  GarilPendingTable *table = _garil_pending_table_new (0);
+  const guint n = 5000;
+
+  for (guint i = 0; i < n; i++)
+    _garil_pending_table_insert (table, DATA (i));
+  g_assert_cmpuint (_garil_pending_table_get_size (table), ==, n);
+  g_assert_cmpuint (_garil_pending_table_get_capacity (table), >=, 2 * n);
+
+  for (guint i = 0; i < n; i++)
+    g_assert_true (_garil_pending_table_lookup (table, i + 1) == DATA (i));
+
+  _garil_pending_table_free (table);
+}
+
+/* A long outstanding entry is skipped over, not overwritten, and the
+ * table doesn't grow for churn around it. */
+static void
+test_table__skip (void)
+{
+  GarilPendingTable *table = _garil_pending_table_new (0);
+  const guint capacity = _garil_pending_table_get_capacity (table);
+
+  g_assert_cmpint (_garil_pending_table_insert (table, DATA (0)), ==, 1);
+  for (guint i = 1; i < 10 * capacity; i++) {
+    const gint32 serial = _garil_pending_table_insert (table, DATA (i));
+    g_assert_cmpint (serial & (capacity - 1), !=, 1);
+    g_assert_true (_garil_pending_table_remove (table, serial) == DATA (i));
+  }
+
+  g_assert_cmpuint (_garil_pending_table_get_capacity (table), ==, capacity);
+  g_assert_true (_garil_pending_table_lookup (table, 1) == DATA (0));
+
+  _garil_pending_table_free (table);
+}
+
+static void
+collect (gpointer data,
+         gpointer user_data)
+{
+  GarilPendingTable *table = user_data;
+
+  /* Callbacks may insert again. */
+  _garil_pending_table_insert (table, data);
+}
+
+/* Stealing all entries */
+static void
+test_table__steal_all (void)
+{
+  GarilPendingTable *table = _garil_pending_table_new (0);
+
+  for (gint i = 0; i < 20; i++)
+    _garil_pending_table_insert (table, DATA (i));
+
+  _garil_pending_table_steal_all (table, collect, table);
+  g_assert_cmpuint (_garil_pending_table_get_size (table), ==, 20);
+  g_assert_null (_garil_pending_table_lookup (table, 1));
+  g_assert_nonnull (_garil_pending_table_lookup (table, 21));
+
+  _garil_pending_table_free (table);
+}
+
+int
+main (int   argc,
+      char *argv[])
+{
+  setlocale (LC_ALL, "");
+
+  g_test_init (&argc, &argv, NULL);
+  g_test_bug_base (PACKAGE_BUGREPORT);
+
+#define ADD_FUNC(name, n, sub) \
+  g_test_add_func ("/GarilPending/" #name "/" #n, test_ ## name ## __ ## sub);
+
+  ADD_FUNC (table, 1, insert)
+  ADD_FUNC (table, 2, remove)
+  ADD_FUNC (table, 3, grow)
+  ADD_FUNC (table, 4, skip)
+  ADD_FUNC (table, 5, steal_all)
+
+  return g_test_run ();
+}
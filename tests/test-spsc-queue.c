@@ -0,0 +1,127 @@
+/* GARIL - Android RIL client library
+ * Copyright (C) 2016 You-Sheng Yang
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#if defined (HAVE_CONFIG_H)
+#include "config.h"
+#endif
+
+#include <locale.h>
+
+#include <glib.h>
+
+#include "garil/garil.h"
+#include "garil/garilspscqueue-private.h"
+
+#define DATA(n) GUINT_TO_POINTER ((n) + 1)
+
+/* Items come out in order, across segment boundaries */
+static void
+test_queue__order (void)
+{
+  GarilSpscQueue *queue = _garil_spsc_queue_new ();
+
+  g_assert_null (_garil_spsc_queue_pop (queue));
+
+  guint next = 0;
+  for (guint round = 0; round < 10; round++) {
+    for (guint i = 0; i < 100 * round; i++)
+      _garil_spsc_queue_push (queue, DATA (next + i));
+
+    for (guint i = 0; i < 100 * round; i++, next++)
+      g_assert_true (_garil_spsc_queue_pop (queue) == DATA (next));
+    g_assert_null (_garil_spsc_queue_pop (queue));
+  }
+
+  _garil_spsc_queue_free (queue, NULL);
+}
+
+static guint n_freed = 0;
+
+static void
+count_item (gpointer data G_GNUC_UNUSED)
+{
+  n_freed++;
+}
+
+/* Items left over are freed */
+static void
+test_queue__free (void)
+{
+  GarilSpscQueue *queue = _garil_spsc_queue_new ();
+
+  for (guint i = 0; i < 1000; i++)
+    _garil_spsc_queue_push (queue, DATA (i));
+  g_assert_true (_garil_spsc_queue_pop (queue) == DATA (0));
+
+  _garil_spsc_queue_free (queue, count_item);
+  g_assert_cmpuint (n_freed, ==, 999);
+}
+
+#define N_THREADED_ITEMS 1000000
+
+static gpointer
+produce (gpointer user_data)
+{
+  GarilSpscQueue *queue = user_data;
+
+  for (guint i = 0; i < N_THREADED_ITEMS; i++)
+    _garil_spsc_queue_push (queue, DATA (i));
+
+  return NULL;
+}
+
+/* One producer thread and one consumer thread */
+static void
+test_queue__threads (void)
+{
+  GarilSpscQueue *queue = _garil_spsc_queue_new ();
+  GThread *thread = g_thread_new ("producer", produce, queue);
+
+  for (guint i = 0; i < N_THREADED_ITEMS;) {
+    gpointer data = _garil_spsc_queue_pop (queue);
+    if (data == NULL) {
+      g_thread_yield ();
+      continue;
+    }
+
+    g_assert_true (data == DATA (i));
+    i++;
+  }
+
+  g_thread_join (thread);
+  g_assert_null (_garil_spsc_queue_pop (queue));
+  _garil_spsc_queue_free (queue, NULL);
+}
+
+int
+main (int   argc,
+      char *argv[])
+{
+  setlocale (LC_ALL, "");
+
+  g_test_init (&argc, &argv, NULL);
+  g_test_bug_base (PACKAGE_BUGREPORT);
+
+#define ADD_FUNC(name, n, sub) \
+  g_test_add_func ("/GarilSpscQueue/" #name "/" #n, test_ ## name ## __ ## sub);
+
+  ADD_FUNC (queue, 1, order)
+  ADD_FUNC (queue, 2, free)
+  ADD_FUNC (queue, 3, threads)
+
+  return g_test_run ();
+}
@@ -0,0 +1,217 @@
+/* GARIL - Android RIL client library
+ * Copyright (C) 2016 You-Sheng Yang
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#if defined (HAVE_CONFIG_H)
+#include "config.h"
+#endif
+
+#include <locale.h>
+
+#include <glib.h>
+
+#include "garil/garil.h"
+#include "garil/gariltimerwheel-private.h"
+#define MSEC(n) ((gint64) (n) * (G_USEC_PER_SEC / 1000))
+#define CEIL_MSEC(t) (((t) + MSEC (1) - 1) / MSEC (1))
+
+/* Start away from 0, so that wheel slots aren't aligned with it. */
+#define T0 (MSEC (123456789) + 321)
+
+/* Timers expire at their deadline, not before, and in order */
+static void
+test_wheel__expire (void)
+{
+  GarilTimerWheel *wheel = _garil_timer_wheel_new (T0);
+  GarilTimer timers[4] = { { NULL, }, };
+  static const gint64 deadlines[] = { MSEC (5), MSEC (1), MSEC (40), 10 };
+
+  for (guint i = 0; i < G_N_ELEMENTS (timers); i++) {
+    timers[i].data = GUINT_TO_POINTER (i);
+    _garil_timer_wheel_add (wheel, &timers[i], T0 + deadlines[i]);
+    g_assert_true (_garil_timer_is_active (&timers[i]));
+  }
+  g_assert_cmpuint (_garil_timer_wheel_get_size (wheel), ==, 4);
+
+  g_assert_null (_garil_timer_wheel_pop_expired (wheel, T0));
+  /* Deadlines are rounded up to the next millisecond. */
+  g_assert_true (_garil_timer_wheel_pop_expired (wheel, T0 + MSEC (1)) ==
+                 &timers[3]);
+  g_assert_null (_garil_timer_wheel_pop_expired (wheel, T0 + MSEC (1)));
+  g_assert_true (_garil_timer_wheel_pop_expired (wheel, T0 + MSEC (2)) ==
+                 &timers[1]);
+  g_assert_null (_garil_timer_wheel_pop_expired (wheel, T0 + MSEC (4)));
+  g_assert_true (_garil_timer_wheel_pop_expired (wheel, T0 + MSEC (39)) ==
+                 &timers[0]);
+  g_assert_false (_garil_timer_is_active (&timers[0]));
+  g_assert_null (_garil_timer_wheel_pop_expired (wheel, T0 + MSEC (39)));
+  g_assert_true (_garil_timer_wheel_pop_expired (wheel, T0 + MSEC (1000)) ==
+                 &timers[2]);
+  g_assert_cmpuint (_garil_timer_wheel_get_size (wheel), ==, 0);
+  g_assert_cmpint (_garil_timer_wheel_get_next_deadline (wheel), ==, -1);
+
+  /* Already expired. */
+  _garil_timer_wheel_add (wheel, &timers[0], T0);
+  g_assert_cmpint (_garil_timer_wheel_get_next_deadline (wheel), ==, 0);
+  g_assert_true (_garil_timer_wheel_pop_expired (wheel, T0 + MSEC (1000)) ==
+                 &timers[0]);
+
+  _garil_timer_wheel_free (wheel);
+}
+
+/* Removed timers never expire */
+static void
+test_wheel__remove (void)
+{
+  GarilTimerWheel *wheel = _garil_timer_wheel_new (T0);
+  GarilTimer timers[3] = { { NULL, }, };
+
+  for (guint i = 0; i < G_N_ELEMENTS (timers); i++)
+    _garil_timer_wheel_add (wheel, &timers[i], T0 + MSEC (100));
+  _garil_timer_wheel_remove (wheel, &timers[1]);
+  g_assert_false (_garil_timer_is_active (&timers[1]));
+  g_assert_cmpuint (_garil_timer_wheel_get_size (wheel), ==, 2);
+
+  GarilTimer *timer = _garil_timer_wheel_pop_expired (wheel, T0 + MSEC (101));
+  g_assert_true ((timer == &timers[0]) || (timer == &timers[2]));
+  /* Expired, but not popped yet. */
+  timer = (timer == &timers[0]) ? &timers[2] : &timers[0];
+  _garil_timer_wheel_remove (wheel, timer);
+  g_assert_null (_garil_timer_wheel_pop_expired (wheel, T0 + MSEC (101)));
+  g_assert_cmpuint (_garil_timer_wheel_get_size (wheel), ==, 0);
+
+  _garil_timer_wheel_free (wheel);
+}
+
+/* Deadlines across all levels and beyond, reached by following the next
+ * deadline */
+static void
+test_wheel__levels (void)
+{
+  GarilTimerWheel *wheel = _garil_timer_wheel_new (T0);
+  static const gint64 deadlines[] = {
+    MSEC (20), MSEC (700), MSEC (30000), MSEC (600000),
+    MSEC (20000000), MSEC (900000000), MSEC (5000000000),
+  };
+  GarilTimer timers[G_N_ELEMENTS (deadlines)] = { { NULL, }, };
+
+  for (guint i = 0; i < G_N_ELEMENTS (timers); i++)
+    _garil_timer_wheel_add (wheel, &timers[i], T0 + deadlines[i]);
+
+  guint n_expired = 0;
+  guint n_wakeups = 0;
+  gint64 now;
+  while ((now = _garil_timer_wheel_get_next_deadline (wheel)) >= 0) {
+    g_assert_cmpint (now, >, T0);
+    n_wakeups++;
+
+    GarilTimer *timer;
+    while ((timer = _garil_timer_wheel_pop_expired (wheel, now)) != NULL) {
+      g_assert_true (timer == &timers[n_expired]);
+      g_assert_cmpint (now, ==, T0 + deadlines[n_expired] + 679);
+      n_expired++;
+    }
+  }
+  g_assert_cmpuint (n_expired, ==, G_N_ELEMENTS (timers));
+  /* A wakeup per cascade at most. */
+  g_assert_cmpuint (n_wakeups, <, 100);
+
+  _garil_timer_wheel_free (wheel);
+}
+
+static gint
+compare_deadlines (gconstpointer a,
+                   gconstpointer b)
+{
+  const gint64 *deadline_a = a;
+  const gint64 *deadline_b = b;
+
+  return (*deadline_a > *deadline_b) - (*deadline_a < *deadline_b);
+}
+
+/* Random deadlines, some removed, expire in order of deadline */
+static void
+test_wheel__random (void)
+{
+  GarilTimerWheel *wheel = _garil_timer_wheel_new (T0);
+  const guint n = 10000;
+  GarilTimer *timers = g_new0 (GarilTimer, n);
+  gint64 *deadlines = g_new0 (gint64, n);
+  GArray *expected = g_array_new (FALSE, FALSE, sizeof (gint64));
+
+  for (guint i = 0; i < n; i++) {
+    deadlines[i] = T0 + g_test_rand_int_range (0, G_MAXINT32) *
+      (gint64) g_test_rand_int_range (1, 64);
+    timers[i].data = &deadlines[i];
+    _garil_timer_wheel_add (wheel, &timers[i], deadlines[i]);
+  }
+  for (guint i = 0; i < n; i++) {
+    if (g_test_rand_bit ())
+      _garil_timer_wheel_remove (wheel, &timers[i]);
+    else
+      g_array_append_val (expected, deadlines[i]);
+  }
+  g_array_sort (expected, compare_deadlines);
+
+  guint n_expired = 0;
+  gint64 now = T0;
+  while (n_expired < expected->len) {
+    now += g_test_rand_int_range (0, G_MAXINT32) * (gint64) 16;
+
+    /* Order within a millisecond is unspecified. */
+    GarilTimer *timer;
+    while ((timer = _garil_timer_wheel_pop_expired (wheel, now)) != NULL) {
+      const gint64 deadline = *(const gint64*) timer->data;
+      g_assert_cmpint (deadline, <=, now);
+      g_assert_cmpint (CEIL_MSEC (deadline), ==,
+                       CEIL_MSEC (g_array_index (expected, gint64,
+                                                 n_expired)));
+      n_expired++;
+    }
+
+    if (n_expired < expected->len) {
+      g_assert_cmpint (CEIL_MSEC (g_array_index (expected, gint64, n_expired)),
+                       >, now / MSEC (1));
+    }
+  }
+  g_assert_cmpuint (_garil_timer_wheel_get_size (wheel), ==, 0);
+
+  g_array_unref (expected);
+  g_free (deadlines);
+  g_free (timers);
+  _garil_timer_wheel_free (wheel);
+}
+
+int
+main (int   argc,
+      char *argv[])
+{
+  setlocale (LC_ALL, "");
+
+  g_test_init (&argc, &argv, NULL);
+  g_test_bug_base (PACKAGE_BUGREPORT);
+
+#define ADD_FUNC(name, n, sub) \
+  g_test_add_func ("/GarilTimerWheel/" #name "/" #n, \
+                   test_ ## name ## __ ## sub);
+
+  ADD_FUNC (wheel, 1, expire)
+  ADD_FUNC (wheel, 2, remove)
+  ADD_FUNC (wheel, 3, levels)
+  ADD_FUNC (wheel, 4, random)
+
+  return g_test_run ();
+}